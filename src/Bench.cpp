@@ -0,0 +1,554 @@
+#include "Bench.h"
+
+#ifdef BENCH_MODE
+
+#include "Logger.h"
+#include "GameManager.h"
+#include "TraceRecorder.h"
+#include "TraceReplay.h"
+#include <esp_timer.h>
+
+// Uscita del logger durante i benchmark: formatta tutto, non trasmette nulla
+class NullStream : public Stream {
+public:
+    size_t write(uint8_t) override { return 1; }
+    size_t write(const uint8_t*, size_t size) override { return size; }
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    void flush() override {}
+};
+
+static NullStream nullStream;
+
+// Roster e master in cache dei GameManager di prova: fuori dal namespace di gioco
+static NvsStore scratchStore("prenoto_bench");
+
+// MAC fittizi: master e slave dei flussi scriptati
+static const uint8_t BENCH_MASTER_MAC[6] = {0x02, 0xBE, 0x0C, 0x00, 0x00, 0xFE};
+static const uint8_t BENCH_SLAVE_MACS[MAX_SLAVES][6] = {
+    {0x02, 0xBE, 0x0C, 0x00, 0x00, 0x00},
+    {0x02, 0xBE, 0x0C, 0x00, 0x00, 0x01},
+    {0x02, 0xBE, 0x0C, 0x00, 0x00, 0x02},
+    {0x02, 0xBE, 0x0C, 0x00, 0x00, 0x03},
+};
+static const uint16_t BENCH_EPOCH = 7;
+
+static volatile uint32_t decodedFrames = 0;
+
+static void countFrame(const Message& msg, const uint8_t* macAddr) {
+    decodedFrames++;
+}
+
+// Frame come lo costruisce il mittente (campi di instradamento compresi)
+static Message scripted(uint8_t type, uint8_t slaveId, uint8_t data, uint16_t round, uint16_t version) {
+    Message msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type = type;
+    msg.slaveId = slaveId;
+    msg.data = data;
+    msg.epoch = BENCH_EPOCH;
+    msg.roster = 0x0F;
+    msg.timestamp = millis();
+    msg.round = round;
+    msg.version = version;
+    msg.origin = NODE_MASTER;
+    msg.dest = NODE_ALL;
+    msg.ttl = RELAY_MAX_HOPS;
+    msg.originNonce = 0x42454E43;
+    return msg;
+}
+
+Bench::Bench(LEDController& leds, ESPNowManager& espNow, NvsStore& nvs)
+    : leds(leds), espNow(espNow), nvs(nvs) {
+    resultCount = 0;
+    lineLen = 0;
+}
+
+template <typename Body>
+void Bench::measure(const char* name, uint32_t iterations, Body body) {
+    if (resultCount >= BENCH_MAX_RESULTS) return;
+
+    // Riscaldamento (cache, allocazioni pigre), poi la ripetizione più veloce
+    for (uint32_t i = 0; i < iterations / 10 + 1; i++) {
+        body(i);
+    }
+
+    int64_t best = INT64_MAX;
+    for (uint8_t r = 0; r < BENCH_REPEATS; r++) {
+        int64_t start = esp_timer_get_time();
+        for (uint32_t i = 0; i < iterations; i++) {
+            body(i);
+        }
+        int64_t elapsed = esp_timer_get_time() - start;
+        if (elapsed < best) best = elapsed;
+    }
+
+    BenchResult& result = results[resultCount++];
+    result.name = name;
+    result.iterations = iterations;
+    result.nsPerOp = (uint32_t)(best * 1000 / iterations);
+}
+
+void Bench::runAll() {
+    resultCount = 0;
+    Log.info("Running benchmarks (%d repeats)...", BENCH_REPEATS);
+
+    benchLeds();
+    benchLogger();
+    benchCodec();
+    benchSlaveGame();
+    benchMasterGame();
+    benchPatterns();
+
+    printCsv();
+}
+
+// Un frame per chiamata: show() compreso, led_show da solo dà il costo del kernel
+void Bench::benchLeds() {
+    measure("led_show", 200, [&](uint32_t) {
+        leds.update();
+    });
+    measure("led_pulse", 200, [&](uint32_t) {
+        leds.forceNextFrame();
+        leds.pulse(COLOR_BLUE, 1000);
+    });
+    measure("led_rainbow", 200, [&](uint32_t) {
+        leds.forceNextFrame();
+        leds.rainbow(1500);
+    });
+    measure("led_spinner", 200, [&](uint32_t) {
+        leds.forceNextFrame();
+        leds.spinner(COLOR_GREEN, 80);
+    });
+    leds.setColor(COLOR_OFF);
+}
+
+void Bench::benchLogger() {
+    Log.begin(nullStream, LOG_DEBUG);
+    measure("log_debug", 2000, [](uint32_t i) {
+        Log.debug("RX from %s | Type: 0x%02X | SlaveID: %d", "02:BE:0C:00:00:01", 0x06, (int)(i & 3));
+    });
+    measure("log_info", 2000, [](uint32_t i) {
+        Log.info("Winner: Slave %d", (int)(i & 3));
+    });
+    measure("log_warn", 2000, [](uint32_t i) {
+        Log.warn("Master epoch changed (%u -> %u), re-attaching", (unsigned)i, (unsigned)(i + 1));
+    });
+    measure("log_error", 2000, [](uint32_t i) {
+        Log.error("Received invalid message size: %d", (int)i);
+    });
+
+    // Chiamata scartata dal livello minimo (il caso più frequente in produzione)
+    Log.setLevel(LOG_INFO);
+    measure("log_filtered", 20000, [](uint32_t i) {
+        Log.debug("Heartbeat from Slave %d", (int)(i & 3));
+    });
+    Log.begin(Serial, LOG_INFO);
+}
+
+void Bench::benchCodec() {
+    uint8_t raw[sizeof(Message)];
+    measure("msg_encode", 20000, [&](uint32_t i) {
+        Message msg = scripted(MSG_HEARTBEAT, i & 3, 0, 1, (uint16_t)i);
+        msg.seq = (uint8_t)i;
+        msg.originSeq = (uint16_t)i;
+        memcpy(raw, &msg, sizeof(msg));
+    });
+
+    // Percorso completo di ricezione: controlli, statistiche link, cache duplicati, callback
+    espNow.setMessageCallback(countFrame);
+    espNow.setRelay(false);
+    espNow.setNodeId(0);
+    uint16_t originSeq = 0;
+    decodedFrames = 0;
+    measure("msg_decode", 5000, [&](uint32_t i) {
+        Message msg = scripted(MSG_MASTER_HEARTBEAT, 0, STATE_READY, 1, (uint16_t)i);
+        msg.seq = (uint8_t)i;
+        msg.originSeq = originSeq++;
+        memcpy(raw, &msg, sizeof(msg));
+        ESPNowManager::injectFrame(BENCH_MASTER_MAC, raw, sizeof(raw));
+    });
+    if (decodedFrames == 0) {
+        Log.warn("Bench: decode path delivered no frames");
+    }
+    espNow.setMessageCallback(nullptr);
+}
+
+// Slave agganciato: round completi (snapshot, start, vincitore) dal master fittizio
+void Bench::benchSlaveGame() {
+    Log.begin(nullStream, LOG_INFO);
+
+    // Istanza unica: i timer creati da begin() restano legati ad essa
+    static GameManager* slave = nullptr;
+    if (slave == nullptr) {
+        slave = new GameManager(leds, espNow, scratchStore, ROLE_SLAVE, 0);
+        slave->begin();
+    }
+    slave->handleMessage(scripted(MSG_CONNECT_ACK, 0, 0, 0, 0), BENCH_MASTER_MAC);
+
+    static const uint8_t STREAM_LEN = 6;
+    uint16_t version = 1;
+    measure("game_slave_msg", 300, [&](uint32_t i) {
+        uint16_t round = (uint16_t)(i / STREAM_LEN + 1);
+        Message msg;
+        switch (i % STREAM_LEN) {
+            case 0: msg = scripted(MSG_MASTER_HEARTBEAT, NODE_ALL, STATE_READY, round - 1, version++); break;
+            case 1: msg = scripted(MSG_START_GAME, 0, 0, round, version); break;
+            case 2: msg = scripted(MSG_MASTER_HEARTBEAT, NODE_ALL, STATE_GAME_RUNNING, round, version++); break;
+            case 3: msg = scripted(MSG_WINNER_ANNOUNCE, 1, 0, round, version); break;
+            case 4: msg = scripted(MSG_MASTER_HEARTBEAT, 1, STATE_WINNER_ANNOUNCED, round, version++); break;
+            default: msg = scripted(MSG_MASTER_HEARTBEAT, NODE_ALL, STATE_READY, round, version++); break;
+        }
+        slave->handleMessage(msg, BENCH_MASTER_MAC);
+    });
+    measure("game_slave_update", 2000, [&](uint32_t) {
+        slave->update();
+    });
+
+    Log.begin(Serial, LOG_INFO);
+}
+
+// Master con 4 slave: traffico di mantenimento (heartbeat, sync, richieste di stato)
+void Bench::benchMasterGame() {
+    Log.begin(nullStream, LOG_INFO);
+
+    static GameManager* master = nullptr;
+    if (master == nullptr) {
+        master = new GameManager(leds, espNow, scratchStore, ROLE_MASTER, 0);
+        master->begin();
+    }
+    for (uint8_t id = 0; id < MAX_SLAVES; id++) {
+        Message req = scripted(MSG_CONNECT_REQUEST, id, 0, 0, 0);
+        req.origin = id;
+        master->handleMessage(req, BENCH_SLAVE_MACS[id]);
+    }
+
+    measure("game_master_msg", 400, [&](uint32_t i) {
+        uint8_t id = i % MAX_SLAVES;
+        static const uint8_t TYPES[] = { MSG_HEARTBEAT, MSG_SYNC_REQUEST, MSG_HEARTBEAT, MSG_STATE_QUERY };
+        Message msg = scripted(TYPES[(i / MAX_SLAVES) % 4], id, (uint8_t)i, 0, 0);
+        msg.origin = id;
+        msg.dest = NODE_MASTER;
+        master->handleMessage(msg, BENCH_SLAVE_MACS[id]);
+    });
+    measure("game_master_update", 2000, [&](uint32_t) {
+        master->update();
+    });
+
+    Log.begin(Serial, LOG_INFO);
+}
+
+// ==================== PATTERN ====================
+
+// Programmi di riferimento: spinner, sfumatura che scorre e sfuma, caso peggiore senza WAIT
+static const uint8_t PATTERN_SPIN[] = {
+    PAT_FILL, 0, 0, 0, 0, 0,
+    PAT_FILL, 0, 1, 0xFF, 0x20, 0x00,
+    PAT_ROTATE, 1,                      // offset 12
+    PAT_WAIT, 3,
+    PAT_LOOP, 0, 12, 0
+};
+static const uint8_t PATTERN_GRADIENT[] = {
+    PAT_GRADIENT, 0xFF, 0x00, 0x80, 0x00, 0x00, 0xFF,
+    PAT_ROTATE, 1,                      // offset 7
+    PAT_FADE, 0xF0,
+    PAT_WAIT, 2,
+    PAT_LOOP, 0, 7, 0
+};
+static const uint8_t PATTERN_BUDGET_BOUND[] = {
+    PAT_GRADIENT, 0xFF, 0x00, 0x80, 0x00, 0x00, 0xFF,
+    PAT_ROTATE, 1,                      // offset 7
+    PAT_LOOP, 0, 7, 0
+};
+
+// Costo dell'interprete per frame (senza show): il terzo esaurisce PATTERN_BUDGET ogni frame
+void Bench::benchPatterns() {
+    static PatternEngine engine(leds.getNumLeds());
+    struct { const char* name; const uint8_t* code; uint8_t len; } programs[] = {
+        { "pattern_spin", PATTERN_SPIN, sizeof(PATTERN_SPIN) },
+        { "pattern_gradient", PATTERN_GRADIENT, sizeof(PATTERN_GRADIENT) },
+        { "pattern_budget", PATTERN_BUDGET_BOUND, sizeof(PATTERN_BUDGET_BOUND) },
+    };
+
+    for (auto& p : programs) {
+        if (!PatternEngine::validate(p.code, p.len)) {
+            Log.error("Bench: %s is not a valid program", p.name);
+            continue;
+        }
+        engine.load(p.code, p.len, COLOR_YELLOW);
+        measure(p.name, 1000, [&](uint32_t i) {
+            engine.renderFrame(i * PATTERN_FRAME_MS);
+        });
+    }
+}
+
+void Bench::renderPattern(const char* hex) {
+    uint8_t code[PATTERN_MAX_LEN];
+    uint8_t len = 0;
+    size_t hexLen = strlen(hex);
+    if (hexLen == 0 || hexLen % 2 != 0 || hexLen / 2 > PATTERN_MAX_LEN) {
+        Log.error("Pattern: bad hex length");
+        return;
+    }
+    for (size_t i = 0; i < hexLen; i += 2) {
+        char byteStr[3] = { hex[i], hex[i + 1], '\0' };
+        code[len++] = (uint8_t)strtoul(byteStr, nullptr, 16);
+    }
+    if (!PatternEngine::validate(code, len)) {
+        Log.error("Pattern: invalid program");
+        return;
+    }
+
+    // Tempo simulato: ogni frame parte quando il precedente lo chiede (WAIT o PATTERN_FRAME_MS)
+    PatternEngine engine(leds.getNumLeds());
+    engine.load(code, len, COLOR_YELLOW);
+    unsigned long t = engine.getResumeAt();
+    unsigned long t0 = t;
+
+    Serial.println("frame,t_ms,instructions,us,rgb");
+    for (uint8_t f = 0; f < BENCH_PATTERN_FRAMES; f++) {
+        uint32_t start = micros();
+        uint16_t executed = engine.renderFrame(t);
+        uint32_t elapsed = micros() - start;
+
+        Serial.printf("%d,%lu,%u,%lu,", f, (unsigned long)(t - t0), executed, (unsigned long)elapsed);
+        const uint8_t* rgb = engine.getFrame();
+        for (uint16_t i = 0; i < engine.getNumLeds() * 3; i++) {
+            Serial.printf("%02x", rgb[i]);
+        }
+        Serial.println();
+        leds.showFrame(rgb);
+        t = engine.getResumeAt();
+    }
+}
+
+// ==================== PRESSIONI RIDONDANTI ====================
+
+// Canale con carrier sense semplificato: i mittenti premono entro PRESS_MODEL_SPREAD_US,
+// ogni frame attende un backoff casuale di 0..PRESS_MODEL_CW slot, rimanda se il canale
+// è occupato (nuovo backoff dopo DIFS) e occupa RELAY_HOP_AIRTIME_US. I frame che partono
+// nello stesso slot collidono e si perdono; gli altri si perdono con probabilità
+// PRESS_MODEL_LOSS_PCT. Le copie partono come in GameManager (la prima subito, le altre
+// una per fetta della finestra). Una pressione è persa se lo sono tutte le copie; il
+// ritardo è quello della prima copia arrivata rispetto alla pressione, cioè l'iniquità
+// che la ridondanza introduce.
+void Bench::modelPresses(uint8_t senders) {
+    static const uint16_t JITTERS[] = { 500, 1000, 1500, 2000, 2550 };
+    static const uint8_t MAX_FRAMES = MAX_SLAVES * PRESS_MAX_COPIES;
+    uint32_t rng = 0x9E3779B9;  // Sempre la stessa sequenza: risultati confrontabili
+    auto next = [&rng]() {
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        return rng;
+    };
+    auto backoff = [&next]() {
+        return (next() % (PRESS_MODEL_CW + 1)) * PRESS_MODEL_SLOT_US;
+    };
+
+    Serial.printf("--- press model: %d senders, %d trials ---\n", senders, PRESS_MODEL_TRIALS);
+    Serial.println("copies,jitter_us,airtime_us,loss_ppm,first_delay_us");
+    for (uint8_t copies = 1; copies <= PRESS_MAX_COPIES; copies++) {
+        for (uint8_t j = 0; j < sizeof(JITTERS) / sizeof(JITTERS[0]); j++) {
+            uint16_t jitter = copies > 1 ? JITTERS[j] : 0;
+            uint32_t lost = 0;
+            uint64_t delaySum = 0;
+            uint32_t delivered = 0;
+
+            for (uint32_t t = 0; t < PRESS_MODEL_TRIALS; t++) {
+                uint32_t at[MAX_FRAMES];        // Prossimo tentativo di partenza
+                bool pending[MAX_FRAMES];
+                uint32_t pressAt[MAX_SLAVES];
+                uint32_t firstOk[MAX_SLAVES];
+                uint8_t n = 0;
+                for (uint8_t s = 0; s < senders; s++) {
+                    pressAt[s] = next() % PRESS_MODEL_SPREAD_US;
+                    firstOk[s] = UINT32_MAX;
+                    for (uint8_t c = 0; c < copies; c++) {
+                        uint32_t ready = pressAt[s];
+                        if (c > 0) {
+                            uint32_t slice = jitter / (copies - 1);
+                            ready += (c - 1) * slice + next() % slice;
+                        }
+                        at[n] = ready + backoff();
+                        pending[n++] = true;
+                    }
+                }
+
+                // Un giro per trasmissione: parte il frame più vicino, con lui chi cade nello
+                // stesso slot; chi era pronto durante la trasmissione rimanda
+                for (uint8_t left = n; left > 0;) {
+                    uint32_t first = UINT32_MAX;
+                    for (uint8_t f = 0; f < n; f++) {
+                        if (pending[f] && at[f] < first) first = at[f];
+                    }
+                    uint8_t together = 0;
+                    uint8_t sender = 0;
+                    for (uint8_t f = 0; f < n; f++) {
+                        if (pending[f] && at[f] < first + PRESS_MODEL_SLOT_US) {
+                            pending[f] = false;
+                            together++;
+                            sender = f;
+                            left--;
+                        }
+                    }
+                    if (together == 1 && next() % 100 >= PRESS_MODEL_LOSS_PCT) {
+                        uint8_t s = sender / copies;
+                        if (first < firstOk[s]) firstOk[s] = first;
+                    }
+                    uint32_t freeAt = first + RELAY_HOP_AIRTIME_US;
+                    for (uint8_t f = 0; f < n; f++) {
+                        if (pending[f] && at[f] < freeAt) {
+                            at[f] = freeAt + PRESS_MODEL_DIFS_US + backoff();
+                        }
+                    }
+                }
+
+                for (uint8_t s = 0; s < senders; s++) {
+                    if (firstOk[s] == UINT32_MAX) {
+                        lost++;
+                    } else {
+                        delaySum += firstOk[s] - pressAt[s];
+                        delivered++;
+                    }
+                }
+            }
+
+            uint32_t presses = (uint32_t)PRESS_MODEL_TRIALS * senders;
+            Serial.printf("%d,%u,%lu,%lu,%lu\n", copies, jitter,
+                          (unsigned long)copies * RELAY_HOP_AIRTIME_US,
+                          (unsigned long)((uint64_t)lost * 1000000 / presses),
+                          (unsigned long)(delivered > 0 ? delaySum / delivered : 0));
+            if (copies == 1) break;     // Senza copie la finestra non conta
+        }
+    }
+    Serial.println("--- end press model ---");
+}
+
+// ==================== REPLAY TRACCE ====================
+
+// Riesegue la traccia caricata ("trace begin ... trace end") su un GameManager con l'identità
+// della scheda che l'ha catturata (driver in TraceReplay, lo stesso dei test nativi)
+void Bench::replayTrace() {
+    TraceHeader header;
+    if (!TraceRecorder::getHeader(header)) {
+        Log.warn("Replay: no trace loaded");
+        return;
+    }
+
+    // Un'istanza per identità: quelle precedenti restano vive, i loro timer puntano ad esse
+    static GameManager* replayGame = nullptr;
+    static uint8_t replayRole = 0xFF;
+    static uint8_t replaySlaveId = 0xFF;
+    if (replayGame == nullptr || replayRole != header.start.role || replaySlaveId != header.start.slaveId) {
+        replayGame = new GameManager(leds, espNow, scratchStore, (DeviceRole)header.start.role,
+                                     header.start.slaveId);
+        replayGame->begin();
+        replayRole = header.start.role;
+        replaySlaveId = header.start.slaveId;
+    }
+
+    static TraceReplayResult result;
+    if (TraceReplay::run(*replayGame, espNow, TraceRecorder::getData(), TraceRecorder::getSize(), result)) {
+        TraceReplay::print(result);
+    }
+}
+
+// CSV tra marcatori, confrontabile con la baseline: nome,iterazioni,ns/op,baseline,delta%
+void Bench::printCsv() {
+    BenchBaseline baseline;
+    bool hasBaseline = nvs.loadBenchBaseline(baseline);
+    uint8_t regressions = 0;
+
+    Serial.println("--- bench csv ---");
+    Serial.println("name,iterations,ns_per_op,baseline_ns,delta_pct");
+    for (uint8_t i = 0; i < resultCount; i++) {
+        const BenchResult& r = results[i];
+        uint32_t hash = hashName(r.name);
+        uint32_t base = 0;
+        for (uint8_t b = 0; hasBaseline && b < baseline.count; b++) {
+            if (baseline.nameHash[b] == hash) {
+                base = baseline.nsPerOp[b];
+                break;
+            }
+        }
+
+        char row[96];
+        if (base > 0) {
+            int32_t deltaPct = (int32_t)(((int64_t)r.nsPerOp - base) * 100 / base);
+            if (deltaPct > BENCH_REGRESSION_PCT) regressions++;
+            snprintf(row, sizeof(row), "%s,%lu,%lu,%lu,%ld", r.name, (unsigned long)r.iterations,
+                     (unsigned long)r.nsPerOp, (unsigned long)base, (long)deltaPct);
+        } else {
+            snprintf(row, sizeof(row), "%s,%lu,%lu,,", r.name, (unsigned long)r.iterations,
+                     (unsigned long)r.nsPerOp);
+        }
+        Serial.println(row);
+    }
+    Serial.println("--- end bench csv ---");
+
+    if (!hasBaseline) {
+        Log.info("No baseline stored: 'bench save' to keep this run as reference");
+    } else if (regressions > 0) {
+        Log.warn("%d benchmarks slower than baseline by more than %d%%", regressions, BENCH_REGRESSION_PCT);
+    }
+}
+
+void Bench::saveBaseline() {
+    BenchBaseline baseline;
+    memset(&baseline, 0, sizeof(baseline));
+    baseline.count = resultCount;
+    for (uint8_t i = 0; i < resultCount; i++) {
+        baseline.nameHash[i] = hashName(results[i].name);
+        baseline.nsPerOp[i] = results[i].nsPerOp;
+    }
+    nvs.saveBenchBaseline(baseline);
+    Log.info("Baseline saved (%d benchmarks)", resultCount);
+}
+
+void Bench::poll(Stream& serial) {
+    while (serial.available() > 0) {
+        int c = serial.read();
+        if (c == '\r') continue;
+        if (c != '\n') {
+            if (lineLen < sizeof(line) - 1) line[lineLen++] = c;
+            continue;
+        }
+        line[lineLen] = '\0';
+        lineLen = 0;
+
+        if (strcmp(line, "bench") == 0) {
+            runAll();
+        } else if (strcmp(line, "bench save") == 0) {
+            saveBaseline();
+        } else if (strncmp(line, "pattern render ", 15) == 0) {
+            renderPattern(line + 15);
+        } else if (strncmp(line, "press model", 11) == 0) {
+            int senders = line[11] == ' ' ? atoi(line + 12) : MAX_SLAVES;
+            if (senders < 1 || senders > MAX_SLAVES) {
+                Log.warn("Usage: press model [1-%d]", MAX_SLAVES);
+            } else {
+                modelPresses(senders);
+            }
+        } else if (strcmp(line, "trace replay") == 0) {
+            replayTrace();
+        } else if (TraceRecorder::handleCommand(line)) {
+            // Caricamento della traccia da rieseguire
+        } else if (line[0] != '\0') {
+            Log.warn("Unknown command: %s", line);
+        }
+    }
+}
+
+// FNV-1a: identifica i benchmark nella baseline anche se cambia l'ordine
+uint32_t Bench::hashName(const char* name) {
+    uint32_t hash = 2166136261UL;
+    while (*name) {
+        hash ^= (uint8_t)*name++;
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+#endif // BENCH_MODE
@@ -0,0 +1,68 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "LEDController.h"
+#include "ESPNowManager.h"
+#include "NvsStore.h"
+#include "PatternEngine.h"
+
+// Microbenchmark sul dispositivo (env bench): kernel di animazione LED, formattazione
+// del logger, codifica/decodifica dei messaggi nel percorso di onDataRecv e GameManager
+// su flussi di eventi scriptati. Ogni benchmark gira BENCH_REPEATS volte e si tiene la
+// più veloce. Il risultato è CSV, confrontato con la baseline salvata in NVS.
+class Bench {
+public:
+    Bench(LEDController& leds, ESPNowManager& espNow, NvsStore& nvs);
+
+    void runAll();
+    void printCsv();
+    void saveBaseline();
+
+    // Esegue un programma di pattern e stampa i primi frame con tempi e costo
+    void renderPattern(const char* hex);
+
+    // Canale simulato: perdita e tempo di antenna delle pressioni ridondanti al variare
+    // di copie e finestra di jitter
+    void modelPresses(uint8_t senders);
+
+    // Riesegue la traccia caricata e confronta le transizioni con quelle registrate
+    void replayTrace();
+
+    // Comandi seriali: "bench" (riesegue), "bench save" (salva come baseline),
+    // "trace begin|<hex>|end" (carica una traccia), "trace replay", "pattern render <hex>",
+    // "press model [mittenti]"
+    void poll(Stream& serial);
+
+private:
+    struct BenchResult {
+        const char* name;
+        uint32_t iterations;
+        uint32_t nsPerOp;
+    };
+
+    LEDController& leds;
+    ESPNowManager& espNow;
+    NvsStore& nvs;
+
+    BenchResult results[BENCH_MAX_RESULTS];
+    uint8_t resultCount;
+
+    char line[16 + PATTERN_MAX_LEN * 2];
+    uint16_t lineLen;
+
+    template <typename Body>
+    void measure(const char* name, uint32_t iterations, Body body);
+
+    void benchLeds();
+    void benchLogger();
+    void benchCodec();
+    void benchSlaveGame();
+    void benchMasterGame();
+    void benchPatterns();
+
+    static uint32_t hashName(const char* name);
+};
+
+#endif // BENCH_H
@@ -0,0 +1,37 @@
+#include "BootReport.h"
+#include "config.h"
+#include "Logger.h"
+
+BootReport::BootReport() {
+    count = 0;
+    printed = false;
+}
+
+void BootReport::mark(const char* phase) {
+    if (count >= BOOT_REPORT_MAX_MARKS) return;
+    marks[count].phase = phase;
+    marks[count].at = micros();
+    count++;
+}
+
+void BootReport::print(bool ready) {
+    printed = true;
+    if (count == 0) return;
+
+    Log.info("=== Boot report ===");
+    uint32_t prev = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        Log.info("  %-12s %8lu us  (+%lu us)", marks[i].phase,
+                 (unsigned long)marks[i].at, (unsigned long)(marks[i].at - prev));
+        prev = marks[i].at;
+    }
+
+    uint32_t totalMs = marks[count - 1].at / 1000;
+    if (!ready) {
+        Log.warn("Not in game after %lu ms", (unsigned long)totalMs);
+    } else if (totalMs > BOOT_BUDGET_MS) {
+        Log.warn("Boot to ready: %lu ms (budget %d ms)", (unsigned long)totalMs, BOOT_BUDGET_MS);
+    } else {
+        Log.info("Boot to ready: %lu ms (budget %d ms)", (unsigned long)totalMs, BOOT_BUDGET_MS);
+    }
+}
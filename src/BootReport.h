@@ -0,0 +1,29 @@
+#ifndef BOOT_REPORT_H
+#define BOOT_REPORT_H
+
+#include <Arduino.h>
+
+#define BOOT_REPORT_MAX_MARKS 16
+
+// Tempi delle fasi di avvio in micros() (dall'avvio dell'applicazione).
+// Le fasi si marcano durante setup(); il report si stampa quando la scheda è in gioco.
+class BootReport {
+public:
+    BootReport();
+
+    void mark(const char* phase);
+    void print(bool ready);
+    bool isPrinted() const { return printed; }
+
+private:
+    struct BootMark {
+        const char* phase;
+        uint32_t at;
+    };
+
+    BootMark marks[BOOT_REPORT_MAX_MARKS];
+    uint8_t count;
+    bool printed;
+};
+
+#endif // BOOT_REPORT_H
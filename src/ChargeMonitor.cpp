@@ -0,0 +1,195 @@
+#include "ChargeMonitor.h"
+#include "Logger.h"
+#include "Profiler.h"
+
+portMUX_TYPE ChargeMonitor::mux = portMUX_INITIALIZER_UNLOCKED;
+
+ChargeMonitor::ChargeMonitor(uint8_t greenPin, uint8_t bluePin) {
+    initEdges(green, greenPin);
+    initEdges(blue, bluePin);
+    timer = nullptr;
+    state = CHARGE_NONE;
+    underLoad = false;
+}
+
+void ChargeMonitor::initEdges(PinEdges& edges, uint8_t pin) {
+    edges.pin = pin;
+    edges.lastEdgeUs = 0;
+    edges.prevEdgeUs = 0;
+    edges.lastRiseUs = 0;
+    edges.periodUs = 0;
+    edges.edgeCount = 0;
+    edges.edgeTotal = 0;
+    edges.seenTotal = 0;
+    edges.level = false;
+}
+
+void ChargeMonitor::begin() {
+    pinMode(green.pin, INPUT);
+    pinMode(blue.pin, INPUT);
+    attachInterruptArg(green.pin, onEdge, &green, CHANGE);
+    attachInterruptArg(blue.pin, onEdge, &blue, CHANGE);
+    green.level = digitalRead(green.pin) == HIGH;
+    blue.level = digitalRead(blue.pin) == HIGH;
+
+    esp_timer_create_args_t timerArgs = {};
+    timerArgs.callback = &ChargeMonitor::onTimer;
+    timerArgs.arg = this;
+    timerArgs.dispatch_method = ESP_TIMER_TASK;
+    timerArgs.name = "charge";
+    if (esp_timer_create(&timerArgs, &timer) != ESP_OK) {
+        Log.error("Charge timer creation failed");
+        timer = nullptr;
+        return;
+    }
+    esp_timer_start_periodic(timer, CHARGE_CHECK_MS * 1000ULL);
+
+    // Stato iniziale dai livelli: un lampeggio viene riconosciuto al primo periodo
+    evaluate();
+}
+
+// Fronte su uno dei due pin: solo timestamp, le decisioni le prende il timer
+void IRAM_ATTR ChargeMonitor::onEdge(void* arg) {
+    PROFILE_SCOPE(PROF_CHARGE_ISR);
+    PinEdges* edges = (PinEdges*)arg;
+    uint32_t now = micros();
+
+    bool high = digitalRead(edges->pin) == HIGH;
+
+    portENTER_CRITICAL_ISR(&mux);
+    // Rimbalzi e disturbi sul fronte
+    if (edges->edgeCount == 0 || now - edges->lastEdgeUs >= CHARGE_GLITCH_US) {
+        edges->prevEdgeUs = edges->lastEdgeUs;
+        edges->lastEdgeUs = now;
+        if (high) {
+            if (edges->lastRiseUs != 0) {
+                edges->periodUs = now - edges->lastRiseUs;
+            }
+            edges->lastRiseUs = now;
+        }
+        if (edges->edgeCount < 3) edges->edgeCount++;
+    }
+    edges->edgeTotal++;
+    portEXIT_CRITICAL_ISR(&mux);
+}
+
+void ChargeMonitor::onTimer(void* arg) {
+    ((ChargeMonitor*)arg)->evaluate();
+}
+
+// Un periodo misurato più il margine: lo stop del lampeggio si vede entro ~un periodo.
+// Prima della misura (o dopo un fronte perso) vale la costante. Mai sotto due valutazioni.
+uint32_t ChargeMonitor::blinkTimeoutUs(const PinEdges& edges) {
+    if (edges.periodUs == 0) return CHARGE_BLINK_TIMEOUT_MS * 1000UL;
+    uint32_t timeout = edges.periodUs + edges.periodUs / 100 * CHARGE_BLINK_MARGIN_PCT;
+    uint32_t floorUs = CHARGE_CHECK_MS * 2000UL;
+    return timeout > floorUs ? timeout : floorUs;
+}
+
+// Due fronti recenti = lampeggio
+bool ChargeMonitor::isBlinking(const PinEdges& edges, uint32_t now) {
+    return edges.edgeCount >= 2 && now - edges.prevEdgeUs < blinkTimeoutUs(edges);
+}
+
+// Nessun fronte per un timeout: LED fermo, si dimenticano i fronti. Con edgeCount a zero
+// un fronte vecchio non torna "recente" dopo il wrap di micros() (~71 minuti).
+bool ChargeMonitor::settle(PinEdges& edges, uint32_t now) {
+    if (edges.edgeCount > 0 && now - edges.lastEdgeUs < blinkTimeoutUs(edges)) {
+        return false;
+    }
+    edges.edgeCount = 0;
+    edges.periodUs = 0;
+    edges.lastRiseUs = 0;
+    return true;
+}
+
+// Livello cambiato senza fronti dalla ISR: il fronte è arrivato durante il light sleep.
+// Conta come fronte adesso (senza periodo), così lo stato aspetta di vedere il lampeggio.
+void ChargeMonitor::catchMissedEdge(PinEdges& edges, bool high, uint32_t now) {
+    if (high != edges.level && edges.edgeTotal == edges.seenTotal) {
+        edges.prevEdgeUs = edges.lastEdgeUs;
+        edges.lastEdgeUs = now;
+        if (edges.edgeCount < 3) edges.edgeCount++;
+    }
+    edges.level = high;
+    edges.seenTotal = edges.edgeTotal;
+}
+
+bool ChargeMonitor::isSettled() const {
+    bool greenHigh = digitalRead(green.pin) == HIGH;
+    bool blueHigh = digitalRead(blue.pin) == HIGH;
+
+    portENTER_CRITICAL(&mux);
+    bool settled = green.edgeCount == 0 && blue.edgeCount == 0 &&
+                   greenHigh == green.level && blueHigh == blue.level;
+    portEXIT_CRITICAL(&mux);
+    return settled && state != CHARGE_CHARGING;
+}
+
+void ChargeMonitor::evaluate() {
+    PROFILE_SCOPE(PROF_CHARGE_EVAL);
+    uint32_t now = micros();
+    bool greenHigh = digitalRead(green.pin) == HIGH;
+    bool blueHigh = digitalRead(blue.pin) == HIGH;
+
+    portENTER_CRITICAL(&mux);
+    catchMissedEdge(green, greenHigh, now);
+    catchMissedEdge(blue, blueHigh, now);
+    bool greenBlinking = isBlinking(green, now);
+    bool greenSteady = !greenBlinking && settle(green, now);
+    bool blueBlinking = isBlinking(blue, now);
+    bool blueSteady = !blueBlinking && settle(blue, now);
+    portEXIT_CRITICAL(&mux);
+
+    // Fronte isolato recente (primo di un lampeggio o cambio di livello): si aspetta di saperlo
+    ChargeState newState = state;
+    if (greenBlinking) {
+        newState = CHARGE_CHARGING;
+    } else if (greenSteady) {
+        newState = greenHigh ? CHARGE_COMPLETE : CHARGE_NONE;
+    }
+
+    bool newUnderLoad = underLoad;
+    if (blueBlinking) {
+        newUnderLoad = true;
+    } else if (blueSteady) {
+        newUnderLoad = blueHigh;
+    }
+
+    if (newState != state) {
+        state = newState;
+        switch (newState) {
+            case CHARGE_NONE:
+                Log.info("Charge: disconnected");
+                break;
+            case CHARGE_CHARGING:
+                Log.info("Charge: charging...");
+                break;
+            case CHARGE_COMPLETE:
+                Log.info("Charge: complete!");
+                break;
+        }
+    }
+
+    if (newUnderLoad != underLoad) {
+        underLoad = newUnderLoad;
+        Log.info("Charge: discharge under load %s", newUnderLoad ? "ON" : "OFF");
+    }
+}
+
+bool ChargeMonitor::handleCommand(const char* line) {
+    if (strcmp(line, "charge") != 0) return false;
+
+    static const char* STATE_NAMES[] = { "none", "charging", "complete" };
+    uint32_t mHz = getBlinkMilliHz();
+    Log.info("Charge: %s, blink %lu.%03lu Hz, discharge under load %s",
+             STATE_NAMES[state], (unsigned long)(mHz / 1000), (unsigned long)(mHz % 1000),
+             underLoad ? "ON" : "OFF");
+    return true;
+}
+
+uint32_t ChargeMonitor::getBlinkMilliHz() const {
+    uint32_t period = green.periodUs;
+    if (state != CHARGE_CHARGING || period == 0) return 0;
+    return 1000000000UL / period;
+}
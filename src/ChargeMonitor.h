@@ -0,0 +1,70 @@
+#ifndef CHARGE_MONITOR_H
+#define CHARGE_MONITOR_H
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include "config.h"
+
+enum ChargeState {
+    CHARGE_NONE,        // Non in ricarica (batteria)
+    CHARGE_CHARGING,    // In carica (verde lampeggia)
+    CHARGE_COMPLETE     // Carica completa (verde fisso)
+};
+
+// Stato del caricatore dai suoi LED, senza polling nel loop.
+// Le ISR sui fronti dei pin verde e blu registrano istante e periodo del lampeggio;
+// un timer esp_timer ogni CHARGE_CHECK_MS decide lo stato: due fronti entro il timeout =
+// lampeggio (in carica), nessun fronte per un timeout = LED fisso (livello del pin). Il timeout
+// è un periodo misurato più CHARGE_BLINK_MARGIN_PCT, CHARGE_BLINK_TIMEOUT_MS prima della misura.
+// Un fronte isolato recente lascia lo stato com'è.
+// In light sleep le ISR e il timer sono fermi: un cambio di livello senza fronte registrato
+// conta come fronte perso, e isSettled() tiene sveglio il nodo finché i LED non sono fermi.
+class ChargeMonitor {
+public:
+    ChargeMonitor(uint8_t greenPin, uint8_t bluePin);
+
+    void begin();
+
+    ChargeState getState() const { return state; }
+    bool isCharging() const { return state != CHARGE_NONE; }
+    uint32_t getBlinkMilliHz() const;               // Frequenza del lampeggio verde (0 = fisso)
+    bool isDischargingUnderLoad() const { return underLoad; }   // LED blu acceso o lampeggiante
+    bool isSettled() const;     // Nessun fronte recente né cambio di livello non valutato: si può dormire
+
+    // Comando seriale "charge": stato, frequenza di lampeggio, scarica con carico
+    bool handleCommand(const char* line);
+
+private:
+    struct PinEdges {
+        uint8_t pin;
+        volatile uint32_t lastEdgeUs;
+        volatile uint32_t prevEdgeUs;
+        volatile uint32_t lastRiseUs;
+        volatile uint32_t periodUs;     // Tra due fronti di salita
+        volatile uint8_t edgeCount;     // Fronti dall'ultimo LED fermo (satura a 3)
+        volatile uint32_t edgeTotal;    // Fronti visti dalla ISR (contatore libero)
+        uint32_t seenTotal;             // edgeTotal all'ultima valutazione
+        bool level;                     // Livello all'ultima valutazione
+    };
+
+    PinEdges green;
+    PinEdges blue;
+    esp_timer_handle_t timer;
+
+    volatile ChargeState state;
+    volatile bool underLoad;
+
+    static portMUX_TYPE mux;        // Fronti: ISR contro timer
+
+    static void initEdges(PinEdges& edges, uint8_t pin);
+    static void IRAM_ATTR onEdge(void* arg);
+    static void onTimer(void* arg);
+    // Da chiamare in sezione critica
+    static uint32_t blinkTimeoutUs(const PinEdges& edges);
+    static bool isBlinking(const PinEdges& edges, uint32_t now);
+    static bool settle(PinEdges& edges, uint32_t now);
+    static void catchMissedEdge(PinEdges& edges, bool high, uint32_t now);
+    void evaluate();
+};
+
+#endif // CHARGE_MONITOR_H
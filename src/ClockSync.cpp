@@ -0,0 +1,62 @@
+#include "ClockSync.h"
+
+ClockSync::ClockSync() {
+    pendingSeq = 0;
+    reset();
+}
+
+void ClockSync::reset() {
+    sampleCount = 0;
+    sampleIndex = 0;
+    pending = false;
+    pendingT0 = 0;
+    synced = false;
+    offset = 0;
+    rtt = 0;
+}
+
+uint8_t ClockSync::beginRequest(uint32_t localNow) {
+    pendingSeq++;
+    pendingT0 = localNow;
+    pending = true;
+    return pendingSeq;
+}
+
+void ClockSync::onReply(uint8_t seq, uint32_t masterTime, uint32_t localNow) {
+    // Solo la risposta all'ultima richiesta, le altre sono vecchie
+    if (!pending || seq != pendingSeq) return;
+    pending = false;
+
+    uint32_t sampleRtt = localNow - pendingT0;
+    if (sampleRtt > MAX_RTT_US) return;
+
+    samples[sampleIndex].offset = masterTime - (pendingT0 + sampleRtt / 2);
+    samples[sampleIndex].rtt = sampleRtt;
+    sampleIndex = (sampleIndex + 1) % SAMPLES;
+    if (sampleCount < SAMPLES) sampleCount++;
+
+    // Campione migliore = RTT minimo
+    uint8_t best = 0;
+    for (uint8_t i = 1; i < sampleCount; i++) {
+        if (samples[i].rtt < samples[best].rtt) best = i;
+    }
+    offset = samples[best].offset;
+    rtt = samples[best].rtt;
+    synced = true;
+}
+
+void ClockSync::onBeacon(uint32_t masterTime, uint32_t localNow) {
+    // Offset osservato = offset vero - ritardo di volo: il massimo ha il ritardo minimo
+    samples[sampleIndex].offset = masterTime - localNow;
+    samples[sampleIndex].rtt = 0;
+    sampleIndex = (sampleIndex + 1) % SAMPLES;
+    if (sampleCount < SAMPLES) sampleCount++;
+
+    uint8_t best = 0;
+    for (uint8_t i = 1; i < sampleCount; i++) {
+        if ((int32_t)(samples[i].offset - samples[best].offset) > 0) best = i;
+    }
+    offset = samples[best].offset;
+    rtt = 0;
+    synced = true;
+}
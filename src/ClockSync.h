@@ -0,0 +1,52 @@
+#ifndef CLOCK_SYNC_H
+#define CLOCK_SYNC_H
+
+#include <Arduino.h>
+
+// Stima dell'offset tra micros() locale e micros() del master.
+// Scambio request/reply: offset = tMaster - (t0 + rtt/2), si tiene il campione
+// con RTT minimo tra gli ultimi SAMPLES (meno influenzato da ritardi radio/coda).
+// Tutta l'aritmetica è modulo 2^32, quindi regge il wrap di micros().
+class ClockSync {
+public:
+    ClockSync();
+
+    void reset();
+
+    // Slave: prepara una richiesta, ritorna il numero di sequenza da inviare
+    uint8_t beginRequest(uint32_t localNow);
+    // Slave: elabora la risposta del master (tMaster = micros() del master)
+    void onReply(uint8_t seq, uint32_t masterTime, uint32_t localNow);
+
+    // Listener: stima a senso unico dai beacon del master (niente uplink).
+    // Non va mescolata con onReply sulla stessa istanza.
+    void onBeacon(uint32_t masterTime, uint32_t localNow);
+
+    bool isSynced() const { return synced; }
+    uint32_t toLocal(uint32_t masterTime) const { return masterTime - offset; }
+    uint32_t toMaster(uint32_t localTime) const { return localTime + offset; }
+    uint32_t bestRtt() const { return rtt; }
+
+private:
+    static constexpr uint8_t SAMPLES = 8;
+    static constexpr uint32_t MAX_RTT_US = 20000;  // Scarta risposte troppo lente
+
+    struct Sample {
+        uint32_t offset;
+        uint32_t rtt;
+    };
+
+    Sample samples[SAMPLES];
+    uint8_t sampleCount;
+    uint8_t sampleIndex;
+
+    uint8_t pendingSeq;
+    uint32_t pendingT0;
+    bool pending;
+
+    bool synced;
+    uint32_t offset;
+    uint32_t rtt;
+};
+
+#endif // CLOCK_SYNC_H
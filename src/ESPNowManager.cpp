@@ -1,8 +1,31 @@
 #include "ESPNowManager.h"
 #include "Logger.h"
+#include "Profiler.h"
+#include "TraceRecorder.h"
+#include "FlightRecorder.h"
+#include <esp_wifi.h>
+#include <esp_system.h>
 
 // Inizializza callback statica
 MessageCallback ESPNowManager::messageCallback = nullptr;
+RawFrameCallback ESPNowManager::rawCallback = nullptr;
+LinkStats ESPNowManager::linkStats;
+
+ESPNowManager::TxRing ESPNowManager::txQueues[TX_PRIO_COUNT];
+ESPNowManager::InFlightSlot ESPNowManager::inFlightSlots[TX_MAX_INFLIGHT];
+uint16_t ESPNowManager::inFlightTicket = 0;
+uint8_t ESPNowManager::inFlight = 0;
+TxQueueStats ESPNowManager::txStats;
+portMUX_TYPE ESPNowManager::txMux = portMUX_INITIALIZER_UNLOCKED;
+volatile unsigned long ESPNowManager::lastRadioActivity = 0;
+
+uint8_t ESPNowManager::localNodeId = NODE_ALL;
+bool ESPNowManager::relayEnabled = false;
+uint32_t ESPNowManager::bootNonce = 0;
+uint16_t ESPNowManager::originSeqCounter = 0;
+ESPNowManager::DupEntry ESPNowManager::dupCache[RELAY_DUP_CACHE_SIZE];
+uint8_t ESPNowManager::dupIndex = 0;
+portMUX_TYPE ESPNowManager::dupMux = portMUX_INITIALIZER_UNLOCKED;
 
 ESPNowManager::ESPNowManager() {
 }
@@ -21,6 +44,10 @@ bool ESPNowManager::begin() {
 
     Log.info("ESP-NOW initialized successfully");
 
+    // Radio accesa: esp_random() è davvero casuale. 0 resta libero per le voci vuote.
+    bootNonce = esp_random();
+    if (bootNonce == 0) bootNonce = 1;
+
     // Registra callback
     esp_now_register_recv_cb(onDataRecv);
     esp_now_register_send_cb(onDataSent);
@@ -36,33 +63,316 @@ bool ESPNowManager::begin() {
     }
     Log.info("Broadcast peer added");
 
+    // RSSI per-link: la callback di ricezione non lo fornisce, lo si legge dai frame in promiscuo
+    if (LINK_RSSI_PROMISCUOUS) {
+        wifi_promiscuous_filter_t filter = {};
+        filter.filter_mask = WIFI_PROMIS_FILTER_MASK_MGMT;
+        esp_wifi_set_promiscuous_filter(&filter);
+        esp_wifi_set_promiscuous_rx_cb(onPromiscuousRx);
+        esp_wifi_set_promiscuous(true);
+    }
+
     return true;
 }
 
+// Da chiamare nel loop: riprende la coda se esp_now_send era occupato o un completamento è andato perso
+void ESPNowManager::update() {
+    portENTER_CRITICAL(&txMux);
+    uint32_t now = micros();
+    for (int8_t i = 0; i < TX_MAX_INFLIGHT; i++) {
+        if (inFlightSlots[i].used && now - inFlightSlots[i].sentAt > TX_COMPLETE_TIMEOUT_US) {
+            releaseSlot(i);
+            txStats.lostCompletions++;
+        }
+    }
+    portEXIT_CRITICAL(&txMux);
+
+    pumpQueue();
+}
+
+// Accoda il frame; l'invio vero avviene quando c'è uno slot libero, in ordine di priorità.
+// Chiamata dal loop e dal task esp_timer (copie delle pressioni): due frame con la stessa
+// sequenza d'origine verrebbero scartati dalla cache duplicati.
 bool ESPNowManager::sendMessage(const Message& msg, const uint8_t* macAddr) {
-    esp_err_t result;
+    Message frame = msg;
+    frame.origin = localNodeId;
+    portENTER_CRITICAL(&txMux);
+    frame.originSeq = ++originSeqCounter;
+    portEXIT_CRITICAL(&txMux);
+    frame.ttl = RELAY_MODE ? RELAY_MAX_HOPS : 0;
+    frame.hops = 0;
+    frame.relayDelayUs = 0;
+    frame.originNonce = bootNonce;
 
-    if (macAddr == nullptr) {
-        // Invia in broadcast
-        result = esp_now_send(broadcastAddress, (uint8_t*)&msg, sizeof(Message));
-    } else {
-        // Invia a specifico peer
-        result = esp_now_send(macAddr, (uint8_t*)&msg, sizeof(Message));
+    // Con i ripetitori tutto va in broadcast: l'indirizzamento è nel campo dest
+    if (RELAY_MODE) {
+        macAddr = nullptr;
     }
 
-    if (result == ESP_OK) {
-        Log.debug("Message sent successfully");
-        return true;
+    // nullptr = broadcast
+    return enqueue(frame, (macAddr == nullptr) ? broadcastAddress : macAddr, false);
+}
+
+bool ESPNowManager::enqueue(const Message& msg, const uint8_t* dest, bool relayed) {
+    bool broadcast = memcmp(dest, broadcastAddress, 6) == 0;
+
+    TxEntry entry;
+    entry.frame = msg;
+    entry.frame.seq = linkStats.nextTxSeq(dest);
+    entry.frame.flags = broadcast ? (msg.flags | FRAME_FLAG_BROADCAST) : (msg.flags & ~FRAME_FLAG_BROADCAST);
+    if (relayed) entry.frame.flags |= FRAME_FLAG_RELAYED;
+    entry.len = sizeof(Message);
+    memcpy(entry.dest, dest, 6);
+    entry.relayed = relayed;
+
+    TraceRecorder::recordFrame(TRACE_TX, dest, (const uint8_t*)&entry.frame, sizeof(Message));
+    FlightRecorder::record(FR_TX, msg.type, entry.frame.dest | (entry.frame.seq << 8));
+    return enqueueEntry(entry);
+}
+
+// Frame OTA: niente sequenza per-link né campi di instradamento, il tipo è il primo byte
+bool ESPNowManager::sendRaw(const uint8_t* data, size_t len, const uint8_t* macAddr) {
+    if (len == 0 || len > ESP_NOW_MAX_DATA_LEN) {
+        Log.error("Invalid raw frame length: %u", (unsigned)len);
+        return false;
+    }
+
+    TxEntry entry;
+    memcpy(entry.raw, data, len);
+    entry.len = len;
+    memcpy(entry.dest, (macAddr == nullptr) ? broadcastAddress : macAddr, 6);
+    entry.relayed = false;
+
+    return enqueueEntry(entry);
+}
+
+bool ESPNowManager::enqueueEntry(TxEntry& entry) {
+    TxPriority prio = priorityFor(entry.raw[0]);
+    entry.enqueuedAt = micros();
+
+    portENTER_CRITICAL(&txMux);
+    TxRing& ring = txQueues[prio];
+    bool queued = ring.count < TX_QUEUE_SIZE;
+    if (queued) {
+        ring.entries[(ring.head + ring.count) % TX_QUEUE_SIZE] = entry;
+        ring.count++;
+        txStats.enqueued++;
+        txStats.depth++;
+        if (txStats.depth > txStats.maxDepth) txStats.maxDepth = txStats.depth;
     } else {
-        Log.error("Send failed, error code: %d", result);
+        txStats.dropped[prio]++;
+    }
+    portEXIT_CRITICAL(&txMux);
+
+    if (!queued) {
+        FlightRecorder::record(FR_TX_DROP, prio);
+        Log.error("TX queue full (prio %d), message 0x%02X dropped", prio, entry.raw[0]);
         return false;
     }
+
+    pumpQueue();
+    return true;
+}
+
+TxPriority ESPNowManager::priorityFor(uint8_t type) {
+    switch (type) {
+        case MSG_START_GAME:
+        case MSG_BUTTON_PRESSED:
+        case MSG_WINNER_ANNOUNCE:
+        case MSG_FALSE_START:
+        case MSG_MASTER_RESUME:
+            return TX_PRIO_CRITICAL;
+
+        case MSG_HEARTBEAT:
+        case MSG_MASTER_HEARTBEAT:
+        case MSG_PATTERN:
+            return TX_PRIO_HOUSEKEEPING;
+
+        case MSG_OTA_CHUNK:
+        case MSG_OTA_WINDOW_END:    // Stessa coda dei blocchi: non li sorpassa
+            return TX_PRIO_BULK;
+
+        default:
+            return TX_PRIO_NORMAL;
+    }
+}
+
+bool ESPNowManager::isRawType(uint8_t type) {
+    return (type >= MSG_OTA_OFFER && type <= MSG_OTA_COMMIT) || type == MSG_PATTERN;
+}
+
+// C'è spazio nella coda di una priorità (per chi produce frame a ritmo proprio, es. OTA)
+bool ESPNowManager::hasTxRoom(TxPriority prio) {
+    portENTER_CRITICAL(&txMux);
+    bool room = txQueues[prio].count < TX_QUEUE_SIZE;
+    portEXIT_CRITICAL(&txMux);
+    return room;
+}
+
+bool ESPNowManager::isRadioIdle(uint32_t quietMs) {
+    portENTER_CRITICAL(&txMux);
+    bool empty = inFlight == 0;
+    for (uint8_t p = 0; p < TX_PRIO_COUNT && empty; p++) {
+        empty = txQueues[p].count == 0;
+    }
+    portEXIT_CRITICAL(&txMux);
+    return empty && millis() - lastRadioActivity >= quietMs;
+}
+
+// Estrae il frame più prioritario se c'è uno slot di invio libero (chiamare in sezione critica)
+bool ESPNowManager::popNext(TxEntry& entry) {
+    if (inFlight >= TX_MAX_INFLIGHT) return false;
+
+    for (uint8_t p = 0; p < TX_PRIO_COUNT; p++) {
+        TxRing& ring = txQueues[p];
+        if (ring.count == 0) continue;
+
+        entry = ring.entries[ring.head];
+        ring.head = (ring.head + 1) % TX_QUEUE_SIZE;
+        ring.count--;
+        txStats.depth--;
+        return true;
+    }
+    return false;
+}
+
+// Rimette un frame in testa alla sua coda (esp_now_send occupato)
+void ESPNowManager::pushFront(TxPriority prio, const TxEntry& entry) {
+    TxRing& ring = txQueues[prio];
+    if (ring.count >= TX_QUEUE_SIZE) {
+        txStats.dropped[prio]++;
+        return;
+    }
+    ring.head = (ring.head + TX_QUEUE_SIZE - 1) % TX_QUEUE_SIZE;
+    ring.entries[ring.head] = entry;
+    ring.count++;
+    txStats.depth++;
+}
+
+int8_t ESPNowManager::reserveSlot(const uint8_t* dest, uint32_t now) {
+    for (int8_t i = 0; i < TX_MAX_INFLIGHT; i++) {
+        InFlightSlot& slot = inFlightSlots[i];
+        if (slot.used) continue;
+        slot.used = true;
+        memcpy(slot.dest, dest, 6);
+        slot.ticket = inFlightTicket++;
+        slot.sentAt = now;
+        inFlight++;
+        return i;
+    }
+    return -1;
+}
+
+// Slot prenotato da più tempo verso dest (-1 se nessuno)
+int8_t ESPNowManager::oldestSlot(const uint8_t* dest) {
+    int8_t oldest = -1;
+    for (int8_t i = 0; i < TX_MAX_INFLIGHT; i++) {
+        const InFlightSlot& slot = inFlightSlots[i];
+        if (!slot.used || memcmp(slot.dest, dest, 6) != 0) continue;
+        if (oldest < 0 || (int16_t)(slot.ticket - inFlightSlots[oldest].ticket) < 0) {
+            oldest = i;
+        }
+    }
+    return oldest;
+}
+
+void ESPNowManager::releaseSlot(int8_t slot) {
+    if (slot < 0 || !inFlightSlots[slot].used) return;
+    inFlightSlots[slot].used = false;
+    inFlight--;
+}
+
+// Consegna a esp_now_send finché ci sono slot liberi. Chiamata dal loop e dalla callback di invio.
+void ESPNowManager::pumpQueue() {
+    for (;;) {
+        TxEntry entry;
+
+        portENTER_CRITICAL(&txMux);
+        bool hasEntry = popNext(entry);
+        int8_t slot = -1;
+        uint16_t ticket = 0;
+        uint32_t sentAt = 0;
+        if (hasEntry) {
+            // Prenota lo slot prima di uscire dalla sezione critica
+            sentAt = micros();
+            slot = reserveSlot(entry.dest, sentAt);
+            ticket = inFlightSlots[slot].ticket;
+        }
+        portEXIT_CRITICAL(&txMux);
+
+        if (!hasEntry) return;
+
+        // Ripetitore: somma il tempo passato in questo nodo (ricezione -> invio).
+        // Sulla copia inviata, così un eventuale reinvio non lo conta due volte.
+        Message out = entry.frame;
+        const uint8_t* payload = entry.raw;
+        if (entry.relayed) {
+            uint32_t residence = micros() - entry.enqueuedAt + entry.frame.relayDelayUs;
+            out.relayDelayUs = residence > 0xFFFF ? 0xFFFF : residence;
+            payload = (const uint8_t*)&out;
+        }
+
+        linkStats.onTxAttempt(entry.dest);
+        esp_err_t result = esp_now_send(entry.dest, payload, entry.len);
+
+        portENTER_CRITICAL(&txMux);
+        if (result == ESP_OK) {
+            txStats.sent++;
+            uint32_t wait = sentAt - entry.enqueuedAt;
+            if (wait > txStats.queueWaitMaxUs) txStats.queueWaitMaxUs = wait;
+        } else {
+            // Libera il proprio slot. Se un completamento dello stesso peer l'ha già preso
+            // (era il più vecchio), quello del frame completato è ancora occupato: si libera quello.
+            bool own = inFlightSlots[slot].used && inFlightSlots[slot].ticket == ticket;
+            releaseSlot(own ? slot : oldestSlot(entry.dest));
+            if (result == ESP_ERR_ESPNOW_NO_MEM) {
+                // Coda interna ESP-NOW piena: si riprova al prossimo completamento/update
+                txStats.busyRetries++;
+                pushFront(priorityFor(entry.raw[0]), entry);
+            } else {
+                txStats.dropped[priorityFor(entry.raw[0])]++;
+                FlightRecorder::record(FR_TX_DROP, priorityFor(entry.raw[0]), (uint16_t)result);
+            }
+        }
+        portEXIT_CRITICAL(&txMux);
+
+        if (result == ESP_ERR_ESPNOW_NO_MEM) {
+            return;
+        }
+        if (result != ESP_OK) {
+            Log.error("Send failed, error code: %d", result);
+        }
+    }
+}
+
+TxQueueStats ESPNowManager::getTxStats() {
+    portENTER_CRITICAL(&txMux);
+    TxQueueStats copy = txStats;
+    portEXIT_CRITICAL(&txMux);
+    return copy;
+}
+
+void ESPNowManager::dumpTxStats() {
+    TxQueueStats s = getTxStats();
+    Log.info("=== TX queue ===");
+    Log.info("Depth %u (max %u)  enqueued %lu  sent %lu  busy retries %lu  lost completions %lu",
+             s.depth, s.maxDepth, (unsigned long)s.enqueued, (unsigned long)s.sent,
+             (unsigned long)s.busyRetries, (unsigned long)s.lostCompletions);
+    Log.info("Dropped: critical %lu  normal %lu  housekeeping %lu  bulk %lu",
+             (unsigned long)s.dropped[TX_PRIO_CRITICAL], (unsigned long)s.dropped[TX_PRIO_NORMAL],
+             (unsigned long)s.dropped[TX_PRIO_HOUSEKEEPING], (unsigned long)s.dropped[TX_PRIO_BULK]);
+    Log.info("Queue wait max %lu us  send->complete avg %lu us, max %lu us",
+             (unsigned long)s.queueWaitMaxUs, (unsigned long)s.latencyAvgUs, (unsigned long)s.latencyMaxUs);
 }
 
 void ESPNowManager::setMessageCallback(MessageCallback callback) {
     messageCallback = callback;
 }
 
+void ESPNowManager::setRawCallback(RawFrameCallback callback) {
+    rawCallback = callback;
+}
+
 bool ESPNowManager::addPeer(const uint8_t* macAddr) {
     esp_now_peer_info_t peerInfo = {};
     memcpy(peerInfo.peer_addr, macAddr, 6);
@@ -114,20 +424,59 @@ void ESPNowManager::getMAC(uint8_t* macAddr) {
 
 // Callback ricezione dati
 void ESPNowManager::onDataRecv(const uint8_t* macAddr, const uint8_t* data, int len) {
+    PROFILE_SCOPE(PROF_ESPNOW_RX);
+    lastRadioActivity = millis();
+
+    // Frame OTA: lunghezza variabile, consegnati così come sono
+    if (len > 0 && isRawType(data[0])) {
+        if (rawCallback != nullptr) {
+            rawCallback(data, len, macAddr);
+        }
+        return;
+    }
+
     if (len != sizeof(Message)) {
         Log.error("Received invalid message size: %d", len);
         return;
     }
 
+    TraceRecorder::recordFrame(TRACE_RX, macAddr, data, len);
+
     Message msg;
     memcpy(&msg, data, sizeof(Message));
+    FlightRecorder::record(FR_RX, msg.type, msg.origin | (msg.seq << 8));
 
-    char macStr[18];
-    snprintf(macStr, sizeof(macStr), "%02X:%02X:%02X:%02X:%02X:%02X",
-             macAddr[0], macAddr[1], macAddr[2],
-             macAddr[3], macAddr[4], macAddr[5]);
+    // Formattazione solo se la riga verrà stampata: la callback regge il traffico di più tavoli
+    if (Log.isEnabled(LOG_DEBUG)) {
+        char macStr[18];
+        snprintf(macStr, sizeof(macStr), "%02X:%02X:%02X:%02X:%02X:%02X",
+                 macAddr[0], macAddr[1], macAddr[2],
+                 macAddr[3], macAddr[4], macAddr[5]);
+        Log.debug("RX from %s | Type: 0x%02X | SlaveID: %d", macStr, msg.type, msg.slaveId);
+    }
 
-    Log.debug("RX from %s | Type: 0x%02X | SlaveID: %d", macStr, msg.type, msg.slaveId);
+    linkStats.onRx(macAddr, msg.seq, msg.flags & FRAME_FLAG_BROADCAST);
+
+    // Senza ripetitori ogni frame arriva una volta sola e l'indirizzamento è il MAC
+    if (RELAY_MODE) {
+        // Proprio frame rimbalzato da un ripetitore, o già visto per altra via
+        if (msg.originNonce == bootNonce || !checkAndRememberFrame(msg.originNonce, msg.originSeq)) {
+            return;
+        }
+
+        // Ripetitore: inoltra in broadcast con un salto in meno
+        if (relayEnabled && msg.ttl > 0) {
+            Message fwd = msg;
+            fwd.ttl--;
+            fwd.hops++;
+            enqueue(fwd, broadcastAddress, true);
+        }
+
+        // Indirizzato ad altri (il listener passivo ascolta comunque tutto)
+        if (msg.dest != NODE_ALL && msg.dest != localNodeId && localNodeId != NODE_LISTENER) {
+            return;
+        }
+    }
 
     // Chiama callback se registrata
     if (messageCallback != nullptr) {
@@ -135,7 +484,66 @@ void ESPNowManager::onDataRecv(const uint8_t* macAddr, const uint8_t* data, int
     }
 }
 
+// Ritorna false se (nonce d'origine, sequenza) è già stata vista di recente, altrimenti la ricorda.
+// Il nonce e non l'ID: più master sono tutti NODE_MASTER, i pulsanti da associare NODE_ALL,
+// e la sequenza riparte da 0 ad ogni riavvio.
+bool ESPNowManager::checkAndRememberFrame(uint32_t originNonce, uint16_t originSeq) {
+    unsigned long now = millis();
+    bool fresh = true;
+
+    portENTER_CRITICAL(&dupMux);
+    for (uint8_t i = 0; i < RELAY_DUP_CACHE_SIZE; i++) {
+        const DupEntry& e = dupCache[i];
+        if (e.seenAt != 0 && e.originNonce == originNonce && e.originSeq == originSeq &&
+            now - e.seenAt < RELAY_DUP_WINDOW_MS) {
+            fresh = false;
+            break;
+        }
+    }
+    if (fresh) {
+        dupCache[dupIndex].originNonce = originNonce;
+        dupCache[dupIndex].originSeq = originSeq;
+        dupCache[dupIndex].seenAt = now == 0 ? 1 : now;
+        dupIndex = (dupIndex + 1) % RELAY_DUP_CACHE_SIZE;
+    }
+    portEXIT_CRITICAL(&dupMux);
+
+    return fresh;
+}
+
 // Callback invio dati
 void ESPNowManager::onDataSent(const uint8_t* macAddr, esp_now_send_status_t status) {
     Log.debug("TX Status: %s", status == ESP_NOW_SEND_SUCCESS ? "OK" : "FAIL");
+    linkStats.onTxComplete(macAddr, status == ESP_NOW_SEND_SUCCESS);
+    lastRadioActivity = millis();
+
+    // Libera lo slot più vecchio verso quel MAC e misura la latenza invio -> completamento.
+    // Completamento senza slot (già scaduto in update()): solo la ripresa della coda.
+    portENTER_CRITICAL(&txMux);
+    int8_t slot = macAddr != nullptr ? oldestSlot(macAddr) : -1;
+    if (slot >= 0) {
+        uint32_t latency = micros() - inFlightSlots[slot].sentAt;
+        releaseSlot(slot);
+
+        txStats.latencyAvgUs += ((int32_t)latency - (int32_t)txStats.latencyAvgUs) / 8;
+        if (latency > txStats.latencyMaxUs) txStats.latencyMaxUs = latency;
+    }
+    portEXIT_CRITICAL(&txMux);
+
+    pumpQueue();
+}
+
+// Callback promiscua: estrae RSSI e MAC sorgente dagli action frame ESP-NOW
+void ESPNowManager::onPromiscuousRx(void* buf, wifi_promiscuous_pkt_type_t type) {
+    if (type != WIFI_PKT_MGMT) return;
+
+    const wifi_promiscuous_pkt_t* pkt = (const wifi_promiscuous_pkt_t*)buf;
+    const uint8_t* frame = pkt->payload;
+
+    // Header 802.11 (24 byte) + categoria vendor-specific (127) + OUI Espressif
+    if (pkt->rx_ctrl.sig_len < 28) return;
+    if (frame[0] != 0xD0 || frame[24] != 127) return;
+    if (frame[25] != 0x18 || frame[26] != 0xFE || frame[27] != 0x34) return;
+
+    linkStats.onRssi(frame + 10, (int8_t)pkt->rx_ctrl.rssi);
 }
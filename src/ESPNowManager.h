@@ -5,18 +5,63 @@
 #include <esp_now.h>
 #include <WiFi.h>
 #include "config.h"
+#include "LinkStats.h"
 
 // Callback per ricezione messaggi
 typedef void (*MessageCallback)(const Message& msg, const uint8_t* macAddr);
 
+// Callback per frame a lunghezza variabile (OTA, pattern)
+typedef void (*RawFrameCallback)(const uint8_t* data, int len, const uint8_t* macAddr);
+
+// Priorità di invio: i frame di gioco passano sempre davanti all'housekeeping
+enum TxPriority {
+    TX_PRIO_CRITICAL,       // Start, vincitore, falsa partenza, pressioni
+    TX_PRIO_NORMAL,         // Connessione, sync, report
+    TX_PRIO_HOUSEKEEPING,   // Heartbeat
+    TX_PRIO_BULK,           // Trasferimento firmware
+    TX_PRIO_COUNT
+};
+
+// Statistiche della coda di invio
+struct TxQueueStats {
+    uint8_t depth;              // Frame in coda ora
+    uint8_t maxDepth;           // Massima profondità osservata
+    uint32_t enqueued;
+    uint32_t sent;              // Accettati da esp_now_send
+    uint32_t dropped[TX_PRIO_COUNT];  // Coda piena o errore di invio
+    uint32_t busyRetries;       // esp_now_send occupato (NO_MEM), ritentato
+    uint32_t lostCompletions;   // Callback di invio mai arrivata
+    uint32_t queueWaitMaxUs;    // Attesa massima in coda
+    uint32_t latencyAvgUs;      // Invio -> completamento (EMA)
+    uint32_t latencyMaxUs;
+};
+
 class ESPNowManager {
 public:
     ESPNowManager();
 
     bool begin();
+    void update();
     bool sendMessage(const Message& msg, const uint8_t* macAddr = nullptr);
     void setMessageCallback(MessageCallback callback);
 
+    // Frame a lunghezza variabile senza intestazione di instradamento (un solo salto)
+    bool sendRaw(const uint8_t* data, size_t len, const uint8_t* macAddr = nullptr);
+    void setRawCallback(RawFrameCallback callback);
+
+    // Consegna un frame come se arrivasse dalla radio (benchmark, replay)
+    static void injectFrame(const uint8_t* macAddr, const uint8_t* data, int len) {
+        onDataRecv(macAddr, data, len);
+    }
+    bool hasTxRoom(TxPriority prio);
+
+    // Code vuote, nessun invio in volo e nessun frame da quietMs (risparmio energetico)
+    bool isRadioIdle(uint32_t quietMs);
+
+    // Instradamento: ID di questo nodo e funzione ripetitore
+    void setNodeId(uint8_t nodeId) { localNodeId = nodeId; }
+    void setRelay(bool enabled) { relayEnabled = enabled; }
+
     // Gestione peer
     bool addPeer(const uint8_t* macAddr);
     bool removePeer(const uint8_t* macAddr);
@@ -26,12 +71,87 @@ public:
     void printMAC(const uint8_t* macAddr);
     void getMAC(uint8_t* macAddr);
 
+    // Qualità dei link radio
+    LinkStats& getLinkStats() { return linkStats; }
+
+    // Coda di invio
+    TxQueueStats getTxStats();
+    void dumpTxStats();
+
 private:
     static MessageCallback messageCallback;
+    static RawFrameCallback rawCallback;
+    static LinkStats linkStats;
+
+    // Instradamento multi-hop
+    struct DupEntry {
+        uint32_t originNonce;
+        uint16_t originSeq;
+        unsigned long seenAt;
+    };
+
+    static uint8_t localNodeId;
+    static bool relayEnabled;
+    static uint32_t bootNonce;          // Distingue i nodi con lo stesso ID e i riavvii
+    static uint16_t originSeqCounter;
+    static DupEntry dupCache[RELAY_DUP_CACHE_SIZE];
+    static uint8_t dupIndex;
+    static portMUX_TYPE dupMux;
+
+    static bool checkAndRememberFrame(uint32_t originNonce, uint16_t originSeq);
+
+    // Coda di invio a priorità, svuotata dalle callback di completamento
+    struct TxEntry {
+        union {
+            Message frame;                      // Frame di gioco
+            uint8_t raw[ESP_NOW_MAX_DATA_LEN];  // Frame a lunghezza variabile (OTA)
+        };
+        uint8_t len;
+        uint8_t dest[6];
+        uint32_t enqueuedAt;
+        bool relayed;       // Inoltrato: il tempo in coda va sommato a relayDelayUs
+    };
+
+    struct TxRing {
+        TxEntry entries[TX_QUEUE_SIZE];
+        uint8_t head;
+        uint8_t count;
+    };
+
+    static TxRing txQueues[TX_PRIO_COUNT];
+    // Frame consegnati a esp_now_send. La callback di invio riporta solo il MAC: si libera il
+    // più vecchio per quel destinatario (ESP-NOW completa in ordine per peer). Il ticket è
+    // l'ordine di prenotazione, anche con due pumpQueue concorrenti (loop e callback).
+    struct InFlightSlot {
+        bool used;
+        uint8_t dest[6];
+        uint16_t ticket;
+        uint32_t sentAt;
+    };
+
+    static InFlightSlot inFlightSlots[TX_MAX_INFLIGHT];
+    static uint16_t inFlightTicket;
+    static uint8_t inFlight;
+    static TxQueueStats txStats;
+    static portMUX_TYPE txMux;
+    static volatile unsigned long lastRadioActivity;  // Ultimo frame ricevuto o inviato (millis)
+
+    static TxPriority priorityFor(uint8_t type);
+    static bool isRawType(uint8_t type);
+    static bool enqueue(const Message& frame, const uint8_t* dest, bool relayed);
+    static bool enqueueEntry(TxEntry& entry);
+    static bool popNext(TxEntry& entry);
+    static void pushFront(TxPriority prio, const TxEntry& entry);
+    // Slot in volo (chiamare in sezione critica)
+    static int8_t reserveSlot(const uint8_t* dest, uint32_t now);
+    static int8_t oldestSlot(const uint8_t* dest);
+    static void releaseSlot(int8_t slot);
+    static void pumpQueue();
 
     // Callback ESP-NOW statiche
     static void onDataRecv(const uint8_t* macAddr, const uint8_t* data, int len);
     static void onDataSent(const uint8_t* macAddr, esp_now_send_status_t status);
+    static void onPromiscuousRx(void* buf, wifi_promiscuous_pkt_type_t type);
 };
 
 #endif // ESPNOW_MANAGER_H
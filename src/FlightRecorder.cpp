@@ -0,0 +1,125 @@
+#include "FlightRecorder.h"
+#include "Logger.h"
+
+#define FLIGHT_MAGIC 0x464C5431       // "FLT1": cambiare se cambia FlightEvent
+
+#if (FLIGHT_RECORDER_EVENTS & (FLIGHT_RECORDER_EVENTS - 1)) != 0
+#error "FLIGHT_RECORDER_EVENTS must be a power of 2"
+#endif
+
+// Anello in DRAM .noinit: non azzerato dal bootloader né dall'avvio dell'applicazione
+struct FlightRing {
+    uint32_t magic;
+    uint32_t written;       // Eventi scritti in totale: indice = written % dimensione
+    uint16_t boots;
+    FlightEvent events[FLIGHT_RECORDER_EVENTS];
+};
+
+__NOINIT_ATTR static FlightRing ring;
+static portMUX_TYPE flightMux = portMUX_INITIALIZER_UNLOCKED;
+
+bool FlightRecorder::begin() {
+    esp_reset_reason_t reason = esp_reset_reason();
+
+    // All'accensione la RAM ha contenuto casuale
+    if (reason == ESP_RST_POWERON || ring.magic != FLIGHT_MAGIC) {
+        clear();
+    }
+
+    bool crashed = ring.written > 0 &&
+                   (reason == ESP_RST_PANIC || reason == ESP_RST_INT_WDT || reason == ESP_RST_TASK_WDT ||
+                    reason == ESP_RST_WDT || reason == ESP_RST_BROWNOUT);
+
+    ring.boots++;
+    record(FR_BOOT, (uint8_t)reason, ring.boots);
+    return crashed;
+}
+
+void IRAM_ATTR FlightRecorder::record(FlightEventType type, uint8_t a, uint16_t b) {
+    uint32_t now = micros();
+    portENTER_CRITICAL_SAFE(&flightMux);
+    FlightEvent& event = ring.events[ring.written & (FLIGHT_RECORDER_EVENTS - 1)];
+    event.timestamp = now;
+    event.type = type;
+    event.a = a;
+    event.b = b;
+    ring.written++;
+    portEXIT_CRITICAL_SAFE(&flightMux);
+}
+
+void FlightRecorder::clear() {
+    portENTER_CRITICAL(&flightMux);
+    ring.magic = FLIGHT_MAGIC;
+    ring.written = 0;
+    ring.boots = 0;
+    portEXIT_CRITICAL(&flightMux);
+}
+
+const char* FlightRecorder::typeName(uint8_t type) {
+    switch (type) {
+        case FR_BOOT:           return "BOOT";
+        case FR_STATE:          return "STATE";
+        case FR_RX:             return "RX";
+        case FR_TX:             return "TX";
+        case FR_TX_DROP:        return "TX_DROP";
+        case FR_HEARTBEAT_MISS: return "HB_MISS";
+        case FR_BUTTON:         return "BUTTON";
+        default:                return "?";
+    }
+}
+
+// Copia degli eventi fuori dalla sezione critica uno alla volta: la stampa è lenta e
+// gli eventi nuovi continuano ad arrivare (quelli sovrascritti nel frattempo si perdono)
+void FlightRecorder::dump(uint16_t count) {
+    uint32_t written = ring.written;
+    uint32_t available = min(written, (uint32_t)FLIGHT_RECORDER_EVENTS);
+    if (count == 0 || count > available) count = available;
+
+    Serial.printf("--- flight recorder: %u of %lu events, boot %u ---\n",
+                  count, (unsigned long)written, ring.boots);
+    for (uint32_t i = written - count; i != written; i++) {
+        FlightEvent event;
+        portENTER_CRITICAL(&flightMux);
+        event = ring.events[i & (FLIGHT_RECORDER_EVENTS - 1)];
+        portEXIT_CRITICAL(&flightMux);
+
+        char detail[32];
+        switch (event.type) {
+            case FR_STATE:
+                snprintf(detail, sizeof(detail), "%d -> %d", event.a, event.b);
+                break;
+            case FR_RX:
+            case FR_TX:
+                snprintf(detail, sizeof(detail), "0x%02X node %d seq %d", event.a, event.b & 0xFF, event.b >> 8);
+                break;
+            case FR_BUTTON:
+                detail[0] = '\0';
+                break;
+            default:
+                snprintf(detail, sizeof(detail), "%d %d", event.a, event.b);
+                break;
+        }
+        Serial.printf("%10lu %-8s %s\n", (unsigned long)event.timestamp, typeName(event.type), detail);
+    }
+    Serial.println("--- end flight recorder ---");
+}
+
+bool FlightRecorder::handleCommand(const char* line) {
+    if (strncmp(line, "flight", 6) != 0 || (line[6] != ' ' && line[6] != '\0')) return false;
+    const char* arg = line[6] == ' ' ? line + 7 : "";
+
+    if (arg[0] == '\0') {
+        Log.info("Flight recorder: %lu events (capacity %d), boot %u",
+                 (unsigned long)ring.written, FLIGHT_RECORDER_EVENTS, ring.boots);
+    } else if (strcmp(arg, "dump") == 0) {
+        dump();
+    } else if (strncmp(arg, "dump ", 5) == 0) {
+        dump((uint16_t)atoi(arg + 5));
+    } else if (strcmp(arg, "clear") == 0) {
+        clear();
+        Log.info("Flight recorder cleared");
+    } else {
+        Log.warn("Unknown flight command: %s", arg);
+    }
+    return true;
+}
@@ -0,0 +1,49 @@
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+#include <Arduino.h>
+#include <esp_system.h>
+#include "config.h"
+
+// Eventi registrati (a e b dipendono dal tipo)
+enum FlightEventType {
+    FR_BOOT = 1,            // a = motivo del reset, b = avvii dall'accensione
+    FR_STATE,               // a = stato di partenza, b = stato di arrivo
+    FR_RX,                  // a = tipo messaggio, b = origine | seq << 8
+    FR_TX,                  // a = tipo messaggio, b = destinazione | seq << 8
+    FR_TX_DROP,             // a = priorità, b = 0 coda piena, altrimenti errore di esp_now_send
+    FR_HEARTBEAT_MISS,      // a = slave perso (NODE_MASTER sullo slave)
+    FR_BUTTON               // Primo fronte della pressione (ISR)
+};
+
+// Un evento: 8 byte, scritti con una sola sezione critica
+struct FlightEvent {
+    uint32_t timestamp;     // micros()
+    uint8_t type;
+    uint8_t a;
+    uint16_t b;
+};
+
+// Registratore di volo sempre attivo: anello binario degli ultimi FLIGHT_RECORDER_EVENTS
+// eventi in DRAM non inizializzata, che sopravvive a panic, watchdog e riavvii software
+// (non a uno spegnimento). Registrare costa poche decine di cicli, nessuna formattazione:
+// dopo un reset anomalo la coda del boot precedente viene stampata, il resto su richiesta.
+class FlightRecorder {
+public:
+    // Da chiamare all'avvio prima di ogni record: true se il boot precedente è finito male
+    static bool begin();
+
+    static void IRAM_ATTR record(FlightEventType type, uint8_t a = 0, uint16_t b = 0);
+
+    // Stampa gli ultimi count eventi (0 = tutti), dal più vecchio
+    static void dump(uint16_t count = 0);
+
+    // Comandi seriali: "flight" (stato), "flight dump [n]", "flight clear"
+    static bool handleCommand(const char* line);
+
+private:
+    static void clear();
+    static const char* typeName(uint8_t type);
+};
+
+#endif // FLIGHT_RECORDER_H
@@ -1,16 +1,39 @@
 #include "GameManager.h"
 #include "Logger.h"
+#include "TraceRecorder.h"
+#include "FlightRecorder.h"
+#include <esp_system.h>
+
+#if PRESS_COPIES < 1 || (PRESS_COPIES > 1 && PRESS_JITTER_US < PRESS_COPIES - 1) || PRESS_JITTER_US > 2550
+#error "PRESS_COPIES >= 1, PRESS_JITTER_US between PRESS_COPIES - 1 and 2550"
+#endif
+
+// Slave in light sleep sul vecchio clock: si svegliano solo dopo POWER_MASTER_SILENCE_MS,
+// il RESUME deve durare almeno fino alla loro prima finestra da svegli
+#if RESUME_WINDOW_MS * 1000ULL <= POWER_MASTER_SILENCE_MS * 1000ULL + POWER_CYCLE_US
+#error "RESUME_WINDOW_MS must exceed POWER_MASTER_SILENCE_MS + POWER_CYCLE_US"
+#endif
 
 // Flag pulsante definito in main.cpp, serve per pulirlo al game start
 extern volatile bool buttonFlag;
+// Istante (micros) del primo fronte del pulsante, registrato dalla ISR
+extern volatile uint32_t buttonPressMicros;
 
-GameManager::GameManager(LEDController& ledController, ESPNowManager& espNowManager, bool isMaster, uint8_t slaveId)
-    : leds(ledController), espNow(espNowManager), isMaster(isMaster), slaveId(slaveId) {
+GameManager::GameManager(LEDController& ledController, ESPNowManager& espNowManager, NvsStore& nvsStore,
+                         DeviceRole role, uint8_t slaveId)
+    : leds(ledController), espNow(espNowManager), store(nvsStore), slaveId(slaveId),
+      pattern(ledController.getNumLeds()) {
+
+    isMaster = (role == ROLE_MASTER);
+    isListener = (role == ROLE_LISTENER);
 
     currentState = STATE_INIT;
+    sessionEpoch = 0;
     numConnected = 0;
     winnerSlaveId = 0xFF;
     gameStartTime = 0;
+    roundNumber = 0;
+    stateVersion = 0;
     isConnected = false;
     lastConnectRetry = 0;
     lastHeartbeatSent = 0;
@@ -19,63 +42,239 @@ GameManager::GameManager(LEDController& ledController, ESPNowManager& espNowMana
     lastButtonPress = 0;
     lastAnimationUpdate = 0;
     lastMasterHeartbeatSent = 0;
+    startDeferred = false;
+    resumeStart = 0;
+    lastResumeSent = 0;
+    lastLinkStatsDump = 0;
+    hasMasterMac = false;
+    masterNonce = 0;
+    connectAttempts = 0;
+    memset(&resumeRoster, 0, sizeof(resumeRoster));
+    startTimer = nullptr;
+    loopTask = nullptr;
+    startArmed = false;
+    startFired = false;
+    scheduledStartLocal = 0;
+    scheduledRound = false;
+    lastSyncRequest = 0;
+    goLatchedAt = 0;
+    reactionArmPending = false;
+    winPending = false;
+    rollbackPending = false;
+    rollbackActive = false;
+    rollbackStart = 0;
+    falseStartPending = false;
+    falseStartActive = false;
+    falseStartBegin = 0;
+    winPendingSince = 0;
+    winPendingDeadline = 0;
+    winQueryCount = 0;
+    arbitrationTimer = nullptr;
+    pressCopyTimer = nullptr;
+    memset(&pressCopy, 0, sizeof(pressCopy));
+    pressId = 0;
+    pressSentAt = 0;
+    pressCopiesSent = 0;
+    pressDuplicates = 0;
+    arbitrationOpen = false;
+    arbitrationExpired = false;
+    arbitrationWinner = 0xFF;
+    arbitrationBest = 0;
+    pairingOpen = false;
+    pairingOpenedAt = 0;
+    pairedCount = 0;
+    checkpoint = nullptr;
+    ambientSeed = 0;
+    ambientRoster = 0;
+    arenaId = 0;
+    hasAmbient = false;
+    patterns = nullptr;
+    patternSlot = 0xFF;
+    patternVersion = 0;
 
     for (uint8_t i = 0; i < MAX_SLAVES; i++) {
         connectedSlaves[i] = 0xFF;
         lastHeartbeatReceived[i] = 0;
+        lastPressId[i] = 0;
     }
 }
 
 void GameManager::begin() {
     Log.info("=== GameManager Begin ===");
-    Log.info("Mode: %s", isMaster ? "MASTER" : "SLAVE");
+    Log.info("Mode: %s", isMaster ? "MASTER" : (isListener ? "LISTENER" : "SLAVE"));
 
-    if (!isMaster) {
+    if (!isMaster && !isListener) {
         Log.info("Slave ID: %d", slaveId);
     }
 
+    // Timer ad alta risoluzione per lo start programmato: risveglia il task del loop
+    loopTask = xTaskGetCurrentTaskHandle();
+    esp_timer_create_args_t timerArgs = {};
+    timerArgs.callback = &GameManager::onStartTimer;
+    timerArgs.arg = this;
+    timerArgs.dispatch_method = ESP_TIMER_TASK;
+    timerArgs.name = "start";
+    if (esp_timer_create(&timerArgs, &startTimer) != ESP_OK) {
+        Log.error("Start timer creation failed");
+        startTimer = nullptr;
+    }
+
+    // ID di instradamento del nodo
+    espNow.setNodeId(isMaster ? NODE_MASTER : (isListener ? NODE_LISTENER : slaveId));
+
+    // Il master sceglie la tinta dell'animazione ambiente, gli altri la ricevono dagli heartbeat
     if (isMaster) {
+        ambientSeed = (uint8_t)esp_random();
+        hasAmbient = true;
+    }
+
+    // Master con ripetitori: timer che chiude la finestra di arbitraggio
+    if (isMaster && RELAY_MODE) {
+        timerArgs.callback = &GameManager::onArbitrationTimer;
+        timerArgs.name = "arbitration";
+        if (esp_timer_create(&timerArgs, &arbitrationTimer) != ESP_OK) {
+            Log.error("Arbitration timer creation failed");
+            arbitrationTimer = nullptr;
+        }
+    }
+
+    // Slave: timer delle copie ridondanti. ID di partenza casuale: dopo un riavvio
+    // la prima pressione non coincide con l'ultima vista dal master
+    if (!isMaster && !isListener) {
+        pressId = esp_random();
+        if (PRESS_COPIES > 1) {
+            timerArgs.callback = &GameManager::onPressCopyTimer;
+            timerArgs.name = "press_copy";
+            if (esp_timer_create(&timerArgs, &pressCopyTimer) != ESP_OK) {
+                Log.error("Press copy timer creation failed");
+                pressCopyTimer = nullptr;
+            }
+        }
+    }
+
+    if (restoreCheckpoint()) {
+        // Ripartito dal checkpoint: round e roster già ricostruiti
+    } else if (isMaster) {
         setState(STATE_WAITING_CONNECTIONS);
+        resumeSession();
+    } else if (isListener) {
+        // Resta in INIT finché non sente il master
+        Log.info("Listening for master broadcasts...");
     } else {
+        // Master in cache: il primo connect request parte già in unicast
+        if (store.loadMasterInfo(masterMac, sessionEpoch)) {
+            hasMasterMac = espNow.addPeer(masterMac);
+        }
         setState(STATE_WAITING_START);
         sendConnectRequest();
     }
 }
 
 void GameManager::update() {
+    PROFILE_SCOPE(PROF_GAME_UPDATE);
+
+    if (pairingOpen && millis() - pairingOpenedAt > PAIRING_TIMEOUT_MS) {
+        closePairing();
+    }
+
+    // Prima di tutto: il frame di start deve uscire nell'istante programmato
+    updateScheduledStart();
+
     if (isMaster) {
         updateMaster();
+    } else if (isListener) {
+        updateListener();
     } else {
         updateSlave();
     }
+
+    // Unico punto di scrittura del checkpoint: transizioni (anche dalla callback),
+    // cambi di roster e di aggancio
+    saveCheckpoint();
 }
 
 void GameManager::setState(GameState newState) {
     if (currentState == newState) return;
 
     Log.info("State change: %d -> %d", currentState, newState);
+    TraceRecorder::recordState(currentState, newState, roundNumber);
+    FlightRecorder::record(FR_STATE, currentState, newState);
+
+    // Ogni cambio di stato del master è una nuova versione dello snapshot
+    if (isMaster) {
+        stateVersion++;
+    }
+
+    // Tornati in attesa: nessuna misura di reazione in corso
+    if (newState == STATE_WAITING_START) {
+        reaction.disarm();
+        reactionArmPending = false;
+    }
 
     currentState = newState;
     lastAnimationUpdate = millis();
+    patternSlot = 0xFF;  // Il pattern del nuovo stato riparte dall'inizio
+    // Il checkpoint lo scrive update(): setState gira anche nella callback ESP-NOW
+    // e due scritture concorrenti lascerebbero in RTC un blocco con CRC non valido
 }
 
 // ==================== MASTER LOGIC ====================
 
 void GameManager::updateMaster() {
+    if (arbitrationExpired) {
+        closeArbitration();
+    }
+
+    // Chiude il round di reazione quando tutti hanno risposto o scade la finestra
+    if (REACTION_MODE && reaction.isRoundOpen() &&
+        (reaction.getResultCount() >= numConnected || millis() - gameStartTime > REACTION_TIMEOUT_MS)) {
+        reaction.closeRound();
+    }
+
     // Controlla heartbeat in tutti gli stati (tranne WAITING_CONNECTIONS)
     if (currentState != STATE_WAITING_CONNECTIONS && numConnected > 0) {
         checkHeartbeats();
     }
 
-    // Invia heartbeat agli slave durante il gioco
-    if (currentState == STATE_GAME_RUNNING || currentState == STATE_READY) {
+    // Statistiche link periodiche
+    if (millis() - lastLinkStatsDump >= LINK_STATS_DUMP_MS) {
+        lastLinkStatsDump = millis();
+        espNow.getLinkStats().dump();
+        espNow.dumpTxStats();
+        if (PRESS_COPIES > 1) {
+            Log.info("Press copies discarded: %lu", (unsigned long)pressDuplicates);
+        }
+    }
+
+    // Dopo un riavvio ripete il RESUME finché il roster salvato non è tornato
+    if (resumePending()) {
         unsigned long now = millis();
-        if (now - lastMasterHeartbeatSent >= MASTER_HEARTBEAT_INTERVAL_MS) {
-            lastMasterHeartbeatSent = now;
-            sendMasterHeartbeat();
+        if (now - lastResumeSent >= RESUME_INTERVAL_MS) {
+            sendResume();
+        }
+    }
+
+    // Start chiesto fuori finestra: parte appena gli slave in light sleep ascoltano
+    bool listenWindow = !POWER_SAVE || PowerManager::inSendWindow(micros());
+    if (startDeferred && listenWindow) {
+        startDeferred = false;
+        if (currentState == STATE_READY && !startArmed) {
+            startGame();
         }
     }
 
+    // Heartbeat in broadcast in tutti gli stati: lo usano anche i display passivi
+    unsigned long hbNow = millis();
+    if (hbNow - lastMasterHeartbeatSent >= MASTER_HEARTBEAT_INTERVAL_MS && listenWindow) {
+        lastMasterHeartbeatSent = hbNow;
+        sendMasterHeartbeat();
+    }
+
+    // Start armato: i LED li accende updateScheduledStart()
+    if (startArmed || showFalseStart(millis())) {
+        return;
+    }
+
     switch (currentState) {
         case STATE_WAITING_CONNECTIONS:
             // Anima LED ciclando tra i colori degli slave connessi
@@ -84,7 +283,9 @@ void GameManager::updateMaster() {
                 for (uint8_t i = 0; i < numConnected; i++) {
                     connectedColors[i] = SLAVE_COLORS[connectedSlaves[i]];
                 }
-                leds.cycleColors(connectedColors, numConnected, CONNECTION_CYCLE_MS);
+                if (!showAmbient()) {
+                    leds.cycleColors(connectedColors, numConnected, CONNECTION_CYCLE_MS);
+                }
             } else {
                 // Nessuno connesso: effetto arcobaleno
                 leds.rainbow(2000);
@@ -100,17 +301,22 @@ void GameManager::updateMaster() {
 
         case STATE_READY:
             // Aspetta pressione pulsante master per iniziare
+            showAmbient();
             break;
 
         case STATE_GAME_RUNNING:
             // LED rosa durante il gioco
-            leds.setColor(COLOR_PINK);
+            if (!playPattern(PATTERN_SLOT_START, COLOR_PINK)) {
+                leds.setColor(COLOR_PINK);
+            }
             break;
 
         case STATE_WINNER_ANNOUNCED:
             // Mostra colore vincitore (aspetta pressione pulsante master per ripartire)
             if (winnerSlaveId < MAX_SLAVES) {
-                leds.pulse(SLAVE_COLORS[winnerSlaveId], 1000);
+                if (!playPattern(PATTERN_SLOT_WINNER, SLAVE_COLORS[winnerSlaveId])) {
+                    leds.pulse(SLAVE_COLORS[winnerSlaveId], 1000);
+                }
             }
             break;
 
@@ -128,9 +334,11 @@ void GameManager::updateSlave() {
         lastMasterMessage > 0 &&
         (now - lastMasterMessage > HEARTBEAT_TIMEOUT_MS)) {
         Log.warn("Master timeout! Reconnecting...");
+        FlightRecorder::record(FR_HEARTBEAT_MISS, NODE_MASTER);
         isConnected = false;
         lastMasterMessage = 0;
         lastConnectRetry = 0;  // Forza retry immediato
+        clockSync.reset();
         setState(STATE_WAITING_START);
     }
 
@@ -146,11 +354,33 @@ void GameManager::updateSlave() {
         sendHeartbeat();
     }
 
+    // Sincronizzazione orologio col master (più fitta finché non sincronizzato)
+    unsigned long syncInterval = clockSync.isSynced() ? SYNC_INTERVAL_MS : SYNC_FAST_INTERVAL_MS;
+    if (isConnected && (now - lastSyncRequest >= syncInterval)) {
+        lastSyncRequest = now;
+        sendSyncRequest();
+    }
+
+    if (winPending) {
+        checkSpeculativeWin();
+    }
+
+    // Start armato: i LED li accende updateScheduledStart()
+    if (startArmed) {
+        return;
+    }
+
+    if (showFalseStart(now) || showRollback(now)) {
+        return;
+    }
+
     switch (currentState) {
         case STATE_WAITING_START:
             // Anima LED con il proprio colore
             if (isConnected) {
-                leds.pulse(SLAVE_COLORS[slaveId], 1000);
+                if (!showAmbient()) {
+                    leds.pulse(SLAVE_COLORS[slaveId], 1000);
+                }
             } else {
                 // Non ancora connesso: arcobaleno
                 leds.rainbow(1500);
@@ -159,13 +389,24 @@ void GameManager::updateSlave() {
 
         case STATE_GAME_RUNNING:
             // LED rosa, aspetta pressione pulsante
-            leds.setColor(COLOR_PINK);
+            if (!playPattern(PATTERN_SLOT_START, COLOR_PINK)) {
+                leds.setColor(COLOR_PINK);
+            }
+            if (reactionArmPending) {
+                reactionArmPending = false;
+                reaction.arm(leds.getLastShowEnd());
+            }
             break;
 
         case STATE_WINNER_ANNOUNCED:
-            // Mostra colore vincitore
-            if (winnerSlaveId < MAX_SLAVES) {
-                leds.setColor(SLAVE_COLORS[winnerSlaveId]);
+            if (winPending) {
+                // Vincita non ancora confermata: pulse veloce del proprio colore
+                leds.pulse(SLAVE_COLORS[slaveId], 300);
+            } else if (winnerSlaveId < MAX_SLAVES) {
+                // Mostra colore vincitore
+                if (!playPattern(PATTERN_SLOT_WINNER, SLAVE_COLORS[winnerSlaveId])) {
+                    leds.setColor(SLAVE_COLORS[winnerSlaveId]);
+                }
             }
             break;
 
@@ -175,6 +416,16 @@ void GameManager::updateSlave() {
 }
 
 void GameManager::handleMessage(const Message& msg, const uint8_t* macAddr) {
+    if (isListener) {
+        handleListenerMessage(msg, macAddr);
+        return;
+    }
+
+    // Frame di un altro master (altro tavolo sullo stesso canale): ignorato finché il nostro parla
+    if (!isMaster && msg.origin == NODE_MASTER && !acceptMasterFrame(msg, macAddr)) {
+        return;
+    }
+
     switch (msg.type) {
         case MSG_CONNECT_REQUEST:
             if (isMaster) {
@@ -182,38 +433,81 @@ void GameManager::handleMessage(const Message& msg, const uint8_t* macAddr) {
             }
             break;
 
+        case MSG_PAIR_REQUEST:
+            if (isMaster) {
+                handlePairRequest(msg);
+            }
+            break;
+
         case MSG_CONNECT_ACK:
             if (!isMaster) {
-                Log.info("Connected to Master!");
+                Log.info("Connected to Master! (epoch %u)", msg.epoch);
                 isConnected = true;
+                connectAttempts = 0;
                 lastMasterMessage = millis();
+                stateVersion = 0;  // Accetta il prossimo snapshot qualunque sia la versione
+                rememberMaster(macAddr, msg.epoch);
             }
             break;
 
         case MSG_START_GAME:
-            if (!isMaster) {
-                Log.info("Game started by Master!");
+            if (!isMaster && checkMasterEpoch(msg, macAddr)) {
                 lastMasterMessage = millis();
                 buttonFlag = false;  // Scarta eventuali pressioni precedenti
+
+                if ((msg.data & START_FLAG_SCHEDULED) && clockSync.isSynced()) {
+                    uint32_t localStart = clockSync.toLocal(msg.value);
+                    int32_t lead = (int32_t)(localStart - micros());
+                    if (lead > 0 && lead <= 2 * START_LEAD_US) {
+                        Log.info("Game start scheduled in %ld us", (long)lead);
+                        winPending = false;
+                        roundNumber = msg.round;
+                        armScheduledStart(localStart);
+                        break;
+                    }
+                    Log.warn("Scheduled start out of range (%ld us), starting now", (long)lead);
+                }
+
+                Log.info("Game started by Master!");
+                winPending = false;
+                roundNumber = msg.round;
+                scheduledRound = false;
+                reactionArmPending = REACTION_MODE;
                 setState(STATE_GAME_RUNNING);
             }
             break;
 
         case MSG_BUTTON_PRESSED:
             if (isMaster) {
+                // Copie ridondanti della stessa pressione: conta solo la prima arrivata
+                // (ID 0 = mittente senza ridondanza)
+                if (msg.slaveId < MAX_SLAVES && msg.value != 0) {
+                    if (msg.value == lastPressId[msg.slaveId]) {
+                        pressDuplicates++;
+                        break;
+                    }
+                    lastPressId[msg.slaveId] = msg.value;
+                }
                 handleButtonPressedFromSlave(msg);
             }
             break;
 
         case MSG_WINNER_ANNOUNCE:
-            if (!isMaster) {
+            if (!isMaster && checkMasterEpoch(msg, macAddr)) {
                 Log.info("Winner: Slave %d", msg.slaveId);
                 lastMasterMessage = millis();
+                resolveSpeculativeWin(msg.slaveId);
                 winnerSlaveId = msg.slaveId;
                 setState(STATE_WINNER_ANNOUNCED);
             }
             break;
 
+        case MSG_STATE_QUERY:
+            if (isMaster) {
+                sendMasterHeartbeat(msg.slaveId, macAddr);
+            }
+            break;
+
         case MSG_HEARTBEAT:
             if (isMaster && msg.slaveId < MAX_SLAVES) {
                 lastHeartbeatReceived[msg.slaveId] = millis();
@@ -222,9 +516,58 @@ void GameManager::handleMessage(const Message& msg, const uint8_t* macAddr) {
             break;
 
         case MSG_MASTER_HEARTBEAT:
-            if (!isMaster) {
+            if (!isMaster && checkMasterEpoch(msg, macAddr)) {
                 lastMasterMessage = millis();
+                ambientSeed = (uint8_t)msg.timestamp;
+                ambientRoster = msg.roster;
+                hasAmbient = true;
                 Log.debug("Master heartbeat received");
+                if (isConnected) {
+                    applySnapshot(msg);
+                }
+            }
+            break;
+
+        case MSG_SYNC_REQUEST:
+            if (isMaster) {
+                sendSyncReply(msg, macAddr);
+            }
+            break;
+
+        case MSG_SYNC_REPLY:
+            if (!isMaster) {
+                clockSync.onReply(msg.data, msg.value, micros());
+            }
+            break;
+
+        case MSG_START_SKEW:
+            if (isMaster) {
+                Log.info("Slave %d start skew: %ld us (sync +/-%u us)",
+                         msg.slaveId, (long)(int32_t)msg.value, msg.data * 10);
+            }
+            break;
+
+        case MSG_REACTION_RESULT:
+            // Risultato di un round già chiuso (ritardato o ritrasmesso): non va nella classifica
+            if (isMaster && msg.round != roundNumber) {
+                Log.warn("Reaction result of Slave %d for round %u ignored (round %u)",
+                         msg.slaveId, msg.round, roundNumber);
+            } else if (isMaster) {
+                reaction.addResult(msg.slaveId, msg.value);
+            }
+            break;
+
+        case MSG_MASTER_RESUME:
+            if (!isMaster && !(isConnected && msg.epoch == sessionEpoch)) {
+                // Master riavviato: ri-aggancio immediato in unicast
+                Log.info("Master resumed (epoch %u), re-attaching", msg.epoch);
+                isConnected = false;
+                clockSync.reset();
+                setState(STATE_WAITING_START);
+                rememberMaster(macAddr, sessionEpoch);
+                connectAttempts = 0;
+                lastConnectRetry = millis();
+                sendConnectRequest();
             }
             break;
 
@@ -232,13 +575,17 @@ void GameManager::handleMessage(const Message& msg, const uint8_t* macAddr) {
             if (isMaster) {
                 // Ritrasmetti a tutti gli slave
                 Log.warn("False start from Slave %d!", msg.slaveId);
-                Message fsMsg;
-                fsMsg.type = MSG_FALSE_START;
-                fsMsg.slaveId = msg.slaveId;
-                fsMsg.data = 0;
-                fsMsg.timestamp = millis();
+                Message fsMsg = makeMessage(MSG_FALSE_START, msg.slaveId);
                 espNow.sendMessage(fsMsg);
             }
+
+            // Falsa partenza durante lo start programmato: il round viene annullato
+            if (startArmed || (scheduledRound && currentState == STATE_GAME_RUNNING)) {
+                Log.warn("Scheduled start aborted");
+                cancelScheduledStart();
+                setState(isMaster ? STATE_READY : STATE_WAITING_START);
+            }
+
             // Tutti (master e slave) fanno il lampeggio rosso
             falseStartFlash();
             break;
@@ -260,11 +607,31 @@ void GameManager::handleButtonPress() {
 
     Log.debug("Button pressed!");
 
+    // Pressioni durante il lampeggio di falsa partenza: scartate
+    if (falseStartPending || falseStartActive) {
+        return;
+    }
+
+    // Il display passivo non partecipa
+    if (isListener) {
+        return;
+    }
+
+    // Master in associazione: il pulsante la chiude
+    if (pairingOpen) {
+        closePairing();
+        return;
+    }
+
     if (isMaster) {
         // Master: gestisce pressione pulsante in base allo stato
-        if (currentState == STATE_READY) {
-            // Avvia il gioco
-            startGame();
+        if (currentState == STATE_READY && !startArmed) {
+            // Avvia il gioco (con slave in light sleep alla prossima finestra di ascolto)
+            if (POWER_SAVE && !PowerManager::inSendWindow(micros())) {
+                startDeferred = true;
+            } else {
+                startGame();
+            }
         } else if (currentState == STATE_WINNER_ANNOUNCED) {
             // Torna a READY per un nuovo round
             Log.info("Master reset - ready for new round");
@@ -272,19 +639,25 @@ void GameManager::handleButtonPress() {
             leds.setColor(COLOR_OFF);
         }
     } else {
+        // Il timer potrebbe essere scattato dopo l'ultimo update
+        if (startFired) {
+            updateScheduledStart();
+        }
+
+        // Tempo di reazione: anche dopo l'annuncio del vincitore, entro la finestra
+        uint32_t reactionUs;
+        if (reaction.isArmed() && !pressedBeforeStart() &&
+            reaction.capture(buttonPressMicros, reactionUs)) {
+            sendReactionResult(reactionUs);
+        }
+
         // Slave: invia messaggio al master se gioco in corso
-        if (currentState == STATE_GAME_RUNNING) {
+        if (currentState == STATE_GAME_RUNNING && !pressedBeforeStart()) {
             sendButtonPressed();
-        } else if (currentState == STATE_WAITING_START && isConnected) {
+        } else if ((currentState == STATE_WAITING_START || currentState == STATE_GAME_RUNNING) && isConnected) {
             // Falsa partenza! Notifica il master
             Log.warn("False start! Button pressed before game start.");
-            Message fsMsg;
-            fsMsg.type = MSG_FALSE_START;
-            fsMsg.slaveId = slaveId;
-            fsMsg.data = 0;
-            fsMsg.timestamp = millis();
-            espNow.sendMessage(fsMsg);
-            falseStartFlash();
+            sendFalseStart();
         }
     }
 }
@@ -294,6 +667,12 @@ void GameManager::handleButtonPress() {
 void GameManager::handleConnectRequest(const Message& msg, const uint8_t* macAddr) {
     uint8_t slaveId = msg.slaveId;
 
+    // ID fuori roster (frame corrotto o falsificato): nessun posto, nessun ACK
+    if (slaveId >= MAX_SLAVES) {
+        Log.warn("Connect request with invalid Slave ID %d", slaveId);
+        return;
+    }
+
     Log.info("Connect request from Slave %d", slaveId);
 
     if (!isSlaveConnected(slaveId)) {
@@ -304,11 +683,8 @@ void GameManager::handleConnectRequest(const Message& msg, const uint8_t* macAdd
     lastHeartbeatReceived[slaveId] = millis();
 
     // Invia sempre ACK (lo slave potrebbe non aver ricevuto il precedente)
-    Message ackMsg;
-    ackMsg.type = MSG_CONNECT_ACK;
-    ackMsg.slaveId = slaveId;
-    ackMsg.data = 0;
-    ackMsg.timestamp = millis();
+    Message ackMsg = makeMessage(MSG_CONNECT_ACK, slaveId);
+    ackMsg.dest = slaveId;
 
     espNow.addPeer(macAddr);
     espNow.sendMessage(ackMsg, macAddr);
@@ -320,49 +696,181 @@ void GameManager::handleButtonPressedFromSlave(const Message& msg) {
         return;
     }
 
-    // Primo slave a premere vince!
     uint8_t slaveId = msg.slaveId;
-    Log.info("*** WINNER: Slave %d ***", slaveId);
+    if (slaveId >= MAX_SLAVES) {
+        Log.warn("Button press with invalid Slave ID %d", slaveId);
+        return;
+    }
 
-    announceWinner(slaveId);
+    if (!RELAY_MODE || arbitrationTimer == nullptr) {
+        // Primo slave a premere vince!
+        Log.info("*** WINNER: Slave %d ***", slaveId);
+        announceWinner(slaveId);
+        return;
+    }
+
+    // Con ripetitori: l'arrivo viene corretto per i salti e le code attraversate,
+    // e si attende una breve finestra per le pressioni ritrasmesse
+    // Una copia ridondante (data = ritardo dalla prima, in 10 us) conta dall'istante della prima
+    uint32_t corrected = micros() - msg.relayDelayUs - msg.hops * RELAY_HOP_AIRTIME_US - msg.data * 10;
+    Log.info("Press from Slave %d (%d hops, relay delay %u us)", slaveId, msg.hops, msg.relayDelayUs);
+
+    if (!arbitrationOpen) {
+        arbitrationOpen = true;
+        arbitrationWinner = slaveId;
+        arbitrationBest = corrected;
+        esp_timer_start_once(arbitrationTimer, RELAY_ARBITRATION_US);
+    } else if ((int32_t)(corrected - arbitrationBest) < 0) {
+        arbitrationWinner = slaveId;
+        arbitrationBest = corrected;
+    }
+}
+
+// Fine della finestra di arbitraggio. Gira nel task esp_timer: solo il segnale, invio,
+// stato e LED li gestisce updateMaster()
+void GameManager::onArbitrationTimer(void* arg) {
+    GameManager* self = static_cast<GameManager*>(arg);
+    self->arbitrationExpired = true;
+}
+
+// Vince l'arrivo corretto più precoce. Chiusa la finestra prima di leggere il vincitore:
+// una pressione più tarda ne riapre una che scade a round già chiuso.
+void GameManager::closeArbitration() {
+    arbitrationExpired = false;
+    if (!arbitrationOpen) return;
+    arbitrationOpen = false;
+    uint8_t winner = arbitrationWinner;
+
+    if (currentState != STATE_GAME_RUNNING) return;
+
+    Log.info("*** WINNER: Slave %d ***", winner);
+    announceWinner(winner);
 }
 
 void GameManager::startGame() {
     Log.info("*** Starting game! ***");
 
     gameStartTime = millis();
+    roundNumber++;
+    ambientSeed = (uint8_t)esp_random();  // Nuova tinta per l'attesa del prossimo round
+
+    if (REACTION_MODE) {
+        reaction.closeRound();
+        reaction.beginRound();
+    }
+
+    if (SCHEDULED_START) {
+        // Start programmato: tutti passano a GAME_RUNNING allo stesso istante del clock master
+        uint32_t startAt = micros() + START_LEAD_US;
+        Message msg = makeMessage(MSG_START_GAME, 0xFF, START_FLAG_SCHEDULED, startAt);
+        espNow.sendMessage(msg);
+        armScheduledStart(startAt);
+        return;
+    }
+
+    scheduledRound = false;
     setState(STATE_GAME_RUNNING);
 
     // Invia messaggio START_GAME in broadcast
-    Message msg;
-    msg.type = MSG_START_GAME;
-    msg.slaveId = 0xFF;
-    msg.data = 0;
-    msg.timestamp = millis();
+    Message msg = makeMessage(MSG_START_GAME, 0xFF);
 
     espNow.sendMessage(msg);
 }
 
-void GameManager::sendMasterHeartbeat() {
-    Message msg;
-    msg.type = MSG_MASTER_HEARTBEAT;
-    msg.slaveId = 0xFF;
-    msg.data = 0;
-    msg.timestamp = millis();
+void GameManager::sendSyncReply(const Message& msg, const uint8_t* macAddr) {
+    // Il tempo master va preso il più tardi possibile prima dell'invio
+    Message reply = makeMessage(MSG_SYNC_REPLY, msg.slaveId, msg.data);
+    reply.dest = msg.slaveId;
+    reply.value = micros();
+    espNow.sendMessage(reply, macAddr);
+}
+
+// Heartbeat = snapshot completo e versionato dello stato (+ clock per i display passivi).
+// Chi ha perso un evento converge entro un periodo di heartbeat, senza ritrasmissioni.
+// Con destId/macAddr: risposta unicast a MSG_STATE_QUERY.
+void GameManager::sendMasterHeartbeat(uint8_t destId, const uint8_t* macAddr) {
+    Message msg = makeMessage(MSG_MASTER_HEARTBEAT, winnerSlaveId, currentState, micros());
+    msg.timestamp = ambientSeed | ((uint32_t)arenaId << 8);
+    msg.dest = destId;
+    msg.roster = rosterBitmap();
+    msg.version = stateVersion;
+    espNow.sendMessage(msg, macAddr);
+}
+
+uint8_t GameManager::rosterBitmap() {
+    uint8_t bitmap = 0;
+    for (uint8_t i = 0; i < numConnected; i++) {
+        if (connectedSlaves[i] < 8) bitmap |= (1 << connectedSlaves[i]);
+    }
+    return bitmap;
+}
+
+void GameManager::resumeSession() {
+    // Nuova epoca ad ogni avvio: gli slave capiscono subito che il master è ripartito
+    bool hadRoster = store.loadRoster(resumeRoster);
+    sessionEpoch = resumeRoster.epoch + 1;
+    if (sessionEpoch == 0) sessionEpoch = 1;
+
+    Log.info("Session epoch: %u", sessionEpoch);
+
+    if (!hadRoster || resumeRoster.count == 0) {
+        resumeRoster.count = 0;
+        saveRoster();
+        return;
+    }
+
+    Log.info("Resuming session: %d slaves in saved roster", resumeRoster.count);
+    for (uint8_t i = 0; i < resumeRoster.count; i++) {
+        espNow.addPeer(resumeRoster.macs[i]);
+    }
+
+    resumeStart = millis();
+    sendResume();
+}
+
+void GameManager::sendResume() {
+    lastResumeSent = millis();
+    Message msg = makeMessage(MSG_MASTER_RESUME, 0xFF);
     espNow.sendMessage(msg);
 }
 
+bool GameManager::resumePending() {
+    if (resumeRoster.count == 0) return false;
+
+    if (millis() - resumeStart > RESUME_WINDOW_MS) {
+        Log.warn("Resume window expired: %d/%d slaves re-attached", numConnected, resumeRoster.count);
+        resumeRoster.count = 0;
+        return false;
+    }
+
+    for (uint8_t i = 0; i < resumeRoster.count; i++) {
+        if (!isSlaveConnected(resumeRoster.ids[i])) return true;
+    }
+
+    Log.info("Session resumed in %lu ms", millis() - resumeStart);
+    resumeRoster.count = 0;
+    return false;
+}
+
+void GameManager::saveRoster() {
+    PersistedRoster roster;
+    memset(&roster, 0, sizeof(roster));
+    roster.epoch = sessionEpoch;
+    roster.count = numConnected;
+    for (uint8_t i = 0; i < numConnected; i++) {
+        roster.ids[i] = connectedSlaves[i];
+        memcpy(roster.macs[i], slaveMacs[i], 6);
+    }
+    store.saveRoster(roster);
+}
+
 void GameManager::announceWinner(uint8_t slaveId) {
     winnerSlaveId = slaveId;
     setState(STATE_WINNER_ANNOUNCED);
     gameStartTime = millis();
 
     // Invia messaggio WINNER_ANNOUNCE in broadcast
-    Message msg;
-    msg.type = MSG_WINNER_ANNOUNCE;
-    msg.slaveId = slaveId;
-    msg.data = 0;
-    msg.timestamp = millis();
+    Message msg = makeMessage(MSG_WINNER_ANNOUNCE, slaveId);
 
     espNow.sendMessage(msg);
 }
@@ -370,43 +878,204 @@ void GameManager::announceWinner(uint8_t slaveId) {
 // ==================== SLAVE METHODS ====================
 
 void GameManager::sendConnectRequest() {
-    Log.info("Sending connect request to Master...");
+    // Con master in cache: unicast, alternato a broadcast nel caso il master sia cambiato
+    bool unicast = hasMasterMac && (connectAttempts % 2 == 0);
+    connectAttempts++;
 
-    Message msg;
-    msg.type = MSG_CONNECT_REQUEST;
-    msg.slaveId = slaveId;
-    msg.data = 0;
-    msg.timestamp = millis();
+    Log.info("Sending connect request to Master (%s)...", unicast ? "unicast" : "broadcast");
 
-    espNow.sendMessage(msg);
+    Message msg = makeMessage(MSG_CONNECT_REQUEST, slaveId);
+    espNow.sendMessage(msg, unicast ? masterMac : nullptr);
 }
 
 void GameManager::sendButtonPressed() {
     Log.info("Sending button press to Master!");
 
-    Message msg;
-    msg.type = MSG_BUTTON_PRESSED;
-    msg.slaveId = slaveId;
-    msg.data = 0;
-    msg.timestamp = millis();
+    Message msg = makeMessage(MSG_BUTTON_PRESSED, slaveId);
+    if (++pressId == 0) pressId = 1;
+    msg.value = pressId;
 
     espNow.sendMessage(msg);
 
-    // Cambio stato locale (ottimistico)
+    // Copie contro le collisioni delle pressioni simultanee, senza attendere un RTT.
+    // La pressione resta anche per il reinvio dopo uno snapshot (applySnapshot).
+    if (pressCopyTimer != nullptr) {
+        esp_timer_stop(pressCopyTimer);
+    }
+    pressCopy = msg;
+    pressSentAt = micros();
+    pressCopiesSent = 1;
+    if (pressCopyTimer != nullptr) {
+        schedulePressCopy();
+    }
+
+    // Vincita speculativa: feedback immediato, poi conferma o rollback dal master
+    leds.setColor(SLAVE_COLORS[slaveId]);
     setState(STATE_WINNER_ANNOUNCED);
     winnerSlaveId = slaveId;
+    winPending = true;
+    winPendingSince = millis();
+    winPendingDeadline = winPendingSince + WIN_CONFIRM_TIMEOUT_MS;
+    winQueryCount = 0;
 }
 
-void GameManager::sendHeartbeat() {
-    Message msg;
-    msg.type = MSG_HEARTBEAT;
-    msg.slaveId = slaveId;
-    msg.data = 0;
-    msg.timestamp = millis();
+// Prossima copia in un punto casuale della sua fetta della finestra: copie di slave
+// diversi premuti nello stesso istante difficilmente si sovrappongono di nuovo
+void GameManager::schedulePressCopy() {
+    uint32_t slice = PRESS_JITTER_US / (PRESS_COPIES - 1);
+    uint32_t target = (pressCopiesSent - 1) * slice + esp_random() % slice;
+    int32_t wait = (int32_t)(pressSentAt + target - micros());
+    esp_timer_start_once(pressCopyTimer, wait > 0 ? wait : 1);
+}
+
+// Gira nel task esp_timer: dal loop (fino a 10ms tra due giri) le copie uscirebbero dalla
+// finestra. sendMessage() prende sequenze d'origine e per-link sotto lock.
+void GameManager::onPressCopyTimer(void* arg) {
+    GameManager* self = static_cast<GameManager*>(arg);
+
+    uint32_t delayUs = micros() - self->pressSentAt;
+    self->pressCopy.data = delayUs / 10 > 255 ? 255 : delayUs / 10;
+    self->espNow.sendMessage(self->pressCopy);
+
+    if (++self->pressCopiesSent < PRESS_COPIES) {
+        self->schedulePressCopy();
+    }
+}
+
+// Nessuna conferma entro la scadenza: chiede lo snapshot al master, poi rinuncia
+void GameManager::checkSpeculativeWin() {
+    unsigned long now = millis();
+    if ((long)(now - winPendingDeadline) < 0) return;
+
+    if (winQueryCount < WIN_QUERY_MAX) {
+        winQueryCount++;
+        winPendingDeadline = now + WIN_CONFIRM_TIMEOUT_MS;
+        Log.warn("Win not confirmed, querying master (%d/%d)", winQueryCount, WIN_QUERY_MAX);
+        Message msg = makeMessage(MSG_STATE_QUERY, slaveId);
+        espNow.sendMessage(msg, hasMasterMac ? masterMac : nullptr);
+        return;
+    }
+
+    Log.warn("Win never confirmed, rolling back");
+    resolveSpeculativeWin(0xFF);
+    setState(STATE_GAME_RUNNING);
+}
+
+// Commit se il master conferma questo slave, altrimenti rollback con effetto "perso"
+void GameManager::resolveSpeculativeWin(uint8_t actualWinner) {
+    if (!winPending) return;
+    winPending = false;
+
+    if (actualWinner == slaveId) {
+        Log.info("Win confirmed in %lu ms", millis() - winPendingSince);
+        return;
+    }
+
+    Log.info("Speculative win rolled back (winner: %d)", actualWinner);
+    rollbackEffect();
+}
+
+// Può arrivare dalla callback ESP-NOW: niente delay(), l'effetto lo disegna updateSlave()
+void GameManager::rollbackEffect() {
+    rollbackPending = true;
+}
+
+// Il proprio colore si spegne due volte rapidamente (80ms per fase). true = LED occupati.
+bool GameManager::showRollback(unsigned long now) {
+    if (rollbackPending) {
+        rollbackPending = false;
+        rollbackActive = true;
+        rollbackStart = now;
+    }
+    if (!rollbackActive) return false;
+
+    unsigned long phase = (now - rollbackStart) / 80;
+    if (phase < 4) {
+        leds.setColor(phase % 2 == 0 ? COLOR_OFF : SLAVE_COLORS[slaveId]);
+        return true;
+    }
+    rollbackActive = false;
+    leds.setColor(COLOR_OFF);
+    return false;
+}
+
+void GameManager::sendSyncRequest() {
+    uint8_t seq = clockSync.beginRequest(micros());
+    Message msg = makeMessage(MSG_SYNC_REQUEST, slaveId, seq);
+    espNow.sendMessage(msg, hasMasterMac ? masterMac : nullptr);
+}
+
+void GameManager::sendFalseStart() {
+    cancelScheduledStart();
+    setState(STATE_WAITING_START);
+
+    Message fsMsg = makeMessage(MSG_FALSE_START, slaveId);
+    espNow.sendMessage(fsMsg);
+    falseStartFlash();
+}
+
+// Pressione avvenuta prima dell'istante di start programmato (anche se elaborata dopo)
+bool GameManager::pressedBeforeStart() {
+    return scheduledRound && (int32_t)(buttonPressMicros - scheduledStartLocal) < 0;
+}
+
+void GameManager::sendReactionResult(uint32_t reactionUs) {
+    Log.info("Reaction time: %lu.%03lu ms",
+             (unsigned long)(reactionUs / 1000), (unsigned long)(reactionUs % 1000));
+
+    Message msg = makeMessage(MSG_REACTION_RESULT, slaveId, 0, reactionUs);
+    espNow.sendMessage(msg, hasMasterMac ? masterMac : nullptr);
+}
 
+void GameManager::sendHeartbeat() {
+    Message msg = makeMessage(MSG_HEARTBEAT, slaveId);
     espNow.sendMessage(msg);
 }
 
+// Frame del master agganciato, oppure il nostro tace da HEARTBEAT_TIMEOUT_MS e si può passare
+// a un altro. Senza ripetitori conta il MAC, che resta uguale quando il master riavvia (RESUME).
+// Con RELAY_MODE il MAC è spesso quello di un ripetitore: conta il nonce d'origine, che però
+// cambia al riavvio, quindi un master riavviato dietro un ripetitore passa solo dopo il silenzio.
+bool GameManager::acceptMasterFrame(const Message& msg, const uint8_t* macAddr) {
+    bool attached = RELAY_MODE ? masterNonce != 0 : hasMasterMac;
+    bool same = RELAY_MODE ? msg.originNonce == masterNonce : isFromMaster(macAddr);
+    if (attached && !same && millis() - lastMasterMessage <= HEARTBEAT_TIMEOUT_MS) {
+        return false;
+    }
+    masterNonce = msg.originNonce;
+    return true;
+}
+
+// Ritorna false se il messaggio arriva da una sessione master diversa (master riavviato)
+bool GameManager::checkMasterEpoch(const Message& msg, const uint8_t* macAddr) {
+    if (!isConnected || msg.epoch == sessionEpoch) {
+        return true;
+    }
+
+    Log.warn("Master epoch changed (%u -> %u), re-attaching", sessionEpoch, msg.epoch);
+    isConnected = false;
+    clockSync.reset();
+    setState(STATE_WAITING_START);
+    rememberMaster(macAddr, sessionEpoch);
+    connectAttempts = 0;
+    lastConnectRetry = millis();
+    sendConnectRequest();
+    return false;
+}
+
+void GameManager::rememberMaster(const uint8_t* macAddr, uint16_t epoch) {
+    bool changed = !hasMasterMac || memcmp(masterMac, macAddr, 6) != 0 || epoch != sessionEpoch;
+
+    memcpy(masterMac, macAddr, 6);
+    sessionEpoch = epoch;
+    hasMasterMac = espNow.addPeer(masterMac);
+
+    // Scrive in NVS solo se cambiato (riduce usura flash)
+    if (changed) {
+        store.saveMasterInfo(masterMac, sessionEpoch);
+    }
+}
+
 void GameManager::checkHeartbeats() {
     unsigned long now = millis();
 
@@ -417,6 +1086,7 @@ void GameManager::checkHeartbeats() {
 
             Log.warn("Slave %d disconnected! (no heartbeat for %ds)",
                      id, HEARTBEAT_TIMEOUT_MS / 1000);
+            FlightRecorder::record(FR_HEARTBEAT_MISS, id);
             removeConnectedSlave(id);
 
             // Annulla round e torna ad aspettare connessioni
@@ -440,24 +1110,563 @@ void GameManager::removeConnectedSlave(uint8_t id) {
             numConnected--;
             lastHeartbeatReceived[id] = 0;
             Log.info("Slave %d removed. Total: %d/%d", id, numConnected, MAX_SLAVES);
+            stateVersion++;
+            saveRoster();
             return;
         }
     }
 }
 
+// ==================== START PROGRAMMATO ====================
+
+void GameManager::armScheduledStart(uint32_t localStart) {
+    if (startTimer != nullptr) {
+        esp_timer_stop(startTimer);
+    }
+
+    scheduledStartLocal = localStart;
+    scheduledRound = true;
+    startFired = false;
+    startArmed = true;
+
+    // Il timer scatta START_SPIN_US prima: sveglia il loop, che attende l'ultimo tratto
+    int32_t lead = (int32_t)(localStart - micros()) - START_SPIN_US;
+    if (lead > 0 && startTimer != nullptr && esp_timer_start_once(startTimer, (uint64_t)lead) == ESP_OK) {
+        return;
+    }
+    // Già nell'ultimo tratto: lo attende il loop. Senza timer si parte subito, da adesso
+    if (lead > 0) {
+        scheduledStartLocal = micros();
+    }
+    startFired = true;
+}
+
+void GameManager::cancelScheduledStart() {
+    if (startTimer != nullptr) {
+        esp_timer_stop(startTimer);
+    }
+    startArmed = false;
+    startFired = false;
+    reaction.disarm();
+}
+
+void GameManager::setLatencyCalibration(uint32_t isrLatencyUs) {
+    reaction.setCalibration(isrLatencyUs);
+}
+
+// Gira nel task esp_timer, START_SPIN_US prima dello start: solo il segnale e il risveglio
+// del loop (fermo nella sua attesa fino a 10ms). LED e stato li tocca il loop, che intanto
+// può disegnare un frame o ricevere uno snapshot.
+void GameManager::onStartTimer(void* arg) {
+    GameManager* self = static_cast<GameManager*>(arg);
+    if (self->startArmed) {
+        self->startFired = true;
+        if (self->loopTask != nullptr) {
+            xTaskNotifyGive(self->loopTask);
+        }
+    }
+}
+
+// Nel loop: a START_SPIN_US dallo start (svegliato dal timer, o già lì per conto suo) attende
+// l'istante senza cedere la CPU, poi accende i LED e cambia stato. Se il loop è arrivato
+// tardi si parte subito.
+void GameManager::updateScheduledStart() {
+    if (!startArmed) return;
+    if (!startFired && (int32_t)(scheduledStartLocal - micros()) > START_SPIN_US) return;
+
+    // Una falsa partenza dalla callback può annullare lo start durante l'attesa
+    uint32_t spinFrom = micros();
+    while (startArmed && (int32_t)(scheduledStartLocal - micros()) > 0) {
+    }
+    if (!startArmed) return;
+
+    startArmed = false;
+    startFired = false;
+    uint32_t firedAt = micros();
+    leds.setColor(COLOR_PINK);
+    goLatchedAt = leds.getLastShowEnd();
+    setState(STATE_GAME_RUNNING);
+
+    int32_t skew = (int32_t)(firedAt - scheduledStartLocal);
+    Log.info("Scheduled start, skew %ld us, spin %lu us", (long)skew, (unsigned long)(firedAt - spinFrom));
+
+    if (!isMaster && !isListener) {
+        if (REACTION_MODE) {
+            reaction.arm(goLatchedAt);
+        }
+
+        uint32_t uncertainty = clockSync.bestRtt() / 2 / 10;
+        Message msg = makeMessage(MSG_START_SKEW, slaveId, uncertainty > 255 ? 255 : uncertainty, (uint32_t)skew);
+        espNow.sendMessage(msg, hasMasterMac ? masterMac : nullptr);
+    }
+}
+
+// ==================== SNAPSHOT ====================
+
+// Applica lo snapshot del master. Idempotente: riapplicare lo stesso snapshot non cambia nulla.
+void GameManager::applySnapshot(const Message& msg) {
+    // Snapshot più vecchio dell'ultimo applicato (riordino): ignora
+    if (stateVersion != 0 && (int16_t)(msg.version - stateVersion) < 0) {
+        return;
+    }
+    stateVersion = msg.version;
+
+    // Uno start armato ha la precedenza: lo snapshot lo vede ancora come READY
+    if (startArmed) {
+        return;
+    }
+
+    // Slave non più nel roster del master: va ri-agganciato
+    if (!isListener && slaveId < 8 && !(msg.roster & (1 << slaveId))) {
+        Log.warn("Not in master roster, reconnecting");
+        isConnected = false;
+        lastConnectRetry = 0;
+        setState(STATE_WAITING_START);
+        return;
+    }
+
+    GameState masterState = (GameState)msg.data;
+
+    // Vincita speculativa e master ancora in gioco sullo stesso round: la pressione è andata persa
+    if (winPending && masterState == STATE_GAME_RUNNING && msg.round == roundNumber) {
+        Log.warn("Press not received by master, resending");
+        // Stessa pressione (ID e istante): il ritardo dalla prima satura come nelle copie
+        Message press = pressCopy;
+        uint32_t delayUs = micros() - pressSentAt;
+        press.data = delayUs / 10 > 255 ? 255 : delayUs / 10;
+        espNow.sendMessage(press);
+        return;
+    }
+
+    switch (masterState) {
+        case STATE_GAME_RUNNING:
+            // START perso: entra nel round (senza misura di reazione, il riferimento è ignoto)
+            if (msg.round != roundNumber &&
+                (currentState != STATE_GAME_RUNNING || isListener)) {
+                Log.warn("Missed start of round %u, joining from snapshot", msg.round);
+                roundNumber = msg.round;
+                scheduledRound = false;
+                reactionArmPending = false;
+                setState(STATE_GAME_RUNNING);
+            }
+            break;
+
+        case STATE_WINNER_ANNOUNCED:
+            if (msg.slaveId < MAX_SLAVES) {
+                resolveSpeculativeWin(msg.slaveId);
+            }
+            if (msg.slaveId < MAX_SLAVES &&
+                (currentState != STATE_WINNER_ANNOUNCED || winnerSlaveId != msg.slaveId)) {
+                Log.warn("Winner from snapshot: Slave %d", msg.slaveId);
+                winnerSlaveId = msg.slaveId;
+                roundNumber = msg.round;
+                setState(STATE_WINNER_ANNOUNCED);
+            }
+            break;
+
+        case STATE_WAITING_CONNECTIONS:
+        case STATE_READY:
+            // Round finito sul master: gli slave tornano in attesa, i display rispecchiano
+            if (isListener) {
+                setState(masterState);
+            } else if (currentState != STATE_WAITING_START) {
+                resolveSpeculativeWin(0xFF);
+                setState(STATE_WAITING_START);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+// ==================== LISTENER ====================
+
+void GameManager::updateListener() {
+    // Master sparito: torna all'animazione di attesa
+    if (currentState != STATE_INIT && millis() - lastMasterMessage > HEARTBEAT_TIMEOUT_MS) {
+        Log.warn("Master lost");
+        setState(STATE_INIT);
+        clockSync.reset();
+    }
+
+    if (startArmed || showFalseStart(millis())) {
+        return;
+    }
+
+    switch (currentState) {
+        case STATE_WAITING_CONNECTIONS:
+            if (!showAmbient()) {
+                leds.rainbow(2000);
+            }
+            break;
+
+        case STATE_GAME_RUNNING:
+            if (!playPattern(PATTERN_SLOT_START, COLOR_PINK)) {
+                leds.setColor(COLOR_PINK);
+            }
+            break;
+
+        case STATE_WINNER_ANNOUNCED:
+            if (winnerSlaveId < MAX_SLAVES) {
+                if (!playPattern(PATTERN_SLOT_WINNER, SLAVE_COLORS[winnerSlaveId])) {
+                    leds.pulse(SLAVE_COLORS[winnerSlaveId], 1000);
+                }
+            }
+            break;
+
+        case STATE_READY:
+            if (!showAmbient()) {
+                leds.setColor(COLOR_OFF);
+            }
+            break;
+
+        default:
+            // Master non ancora sentito
+            leds.rainbow(4000);
+            break;
+    }
+}
+
+// Ricostruisce lo stato dai soli broadcast del master, senza mai trasmettere
+void GameManager::handleListenerMessage(const Message& msg, const uint8_t* macAddr) {
+    switch (msg.type) {
+        case MSG_MASTER_HEARTBEAT:
+        case MSG_MASTER_RESUME:
+        case MSG_START_GAME:
+        case MSG_WINNER_ANNOUNCE:
+            // Solo il master invia questi tipi: da qui si impara il suo MAC (altri tavoli esclusi)
+            if (!acceptMasterFrame(msg, macAddr)) return;
+            memcpy(masterMac, macAddr, 6);
+            hasMasterMac = true;
+            if (msg.epoch != sessionEpoch) {
+                stateVersion = 0;  // Master riavviato: le versioni ripartono
+            }
+            sessionEpoch = msg.epoch;
+            lastMasterMessage = millis();
+            break;
+
+        case MSG_FALSE_START:
+            // Anche lo slave colpevole trasmette in broadcast: si segue solo il master
+            if (msg.origin != NODE_MASTER || !acceptMasterFrame(msg, macAddr)) return;
+            break;
+
+        default:
+            return;
+    }
+
+    switch (msg.type) {
+        case MSG_MASTER_HEARTBEAT:
+            clockSync.onBeacon(msg.value, micros());
+            ambientSeed = (uint8_t)msg.timestamp;
+            ambientRoster = msg.roster;
+            hasAmbient = true;
+            applySnapshot(msg);
+            break;
+
+        case MSG_START_GAME:
+            if ((msg.data & START_FLAG_SCHEDULED) && clockSync.isSynced()) {
+                uint32_t localStart = clockSync.toLocal(msg.value);
+                int32_t lead = (int32_t)(localStart - micros());
+                if (lead > 0 && lead <= 2 * START_LEAD_US) {
+                    roundNumber = msg.round;
+                    armScheduledStart(localStart);
+                    break;
+                }
+            }
+            roundNumber = msg.round;
+            scheduledRound = false;
+            setState(STATE_GAME_RUNNING);
+            break;
+
+        case MSG_WINNER_ANNOUNCE:
+            winnerSlaveId = msg.slaveId;
+            setState(STATE_WINNER_ANNOUNCED);
+            break;
+
+        case MSG_FALSE_START:
+            cancelScheduledStart();
+            falseStartFlash();
+            break;
+
+        default:
+            break;
+    }
+}
+
+// Può arrivare dalla callback ESP-NOW: niente delay() né LED, l'effetto lo disegna il loop
 void GameManager::falseStartFlash() {
-    // 3 lampeggi rossi veloci
-    for (int i = 0; i < 3; i++) {
-        leds.setColor(COLOR_RED);
-        delay(200);
-        leds.setColor(COLOR_OFF);
-        delay(200);
+    falseStartPending = true;
+}
+
+// Pattern installato dal master o 3 lampeggi rossi (200ms per fase), stessa durata.
+// true = LED occupati.
+bool GameManager::showFalseStart(unsigned long now) {
+    if (falseStartPending) {
+        falseStartPending = false;
+        falseStartActive = true;
+        falseStartBegin = now;
+        patternSlot = 0xFF;  // Il pattern riparte da capo
+    }
+    if (!falseStartActive) return false;
+
+    unsigned long elapsed = now - falseStartBegin;
+    if (elapsed < PATTERN_FALSE_START_MS) {
+        if (!playPattern(PATTERN_SLOT_FALSE_START, COLOR_RED)) {
+            leds.setColor((elapsed / 200) % 2 == 0 ? COLOR_RED : COLOR_OFF);
+        }
+        return true;
     }
-    buttonFlag = false;  // Pulisci eventuali pressioni durante il flash
+    falseStartActive = false;
+    leds.setColor(COLOR_OFF);
+    return false;
+}
+
+// Un frame del pattern dello slot se installato (false = usare l'animazione di firmware)
+bool GameManager::playPattern(uint8_t slot, uint32_t contextColor) {
+    if (patterns == nullptr || !patterns->has(slot)) return false;
+
+    if (patternSlot != slot || patternVersion != patterns->getVersion()) {
+        uint8_t code[PATTERN_MAX_LEN];
+        uint8_t len;
+        if (!patterns->copy(slot, code, len)) return false;
+        pattern.load(code, len, contextColor);
+        patternSlot = slot;
+        patternVersion = patterns->getVersion();
+    }
+
+    unsigned long now = millis();
+    if (pattern.isDue(now)) {
+        pattern.renderFrame(now);
+        leds.showFrame(pattern.getFrame());
+    }
+    return true;
+}
+
+// Fetta di questo nodo nell'onda condivisa: master (e listener) in testa, poi gli slave
+// in ordine di ID. Nessun traffico per frame: bastano clock sync e heartbeat del master.
+bool GameManager::showAmbient() {
+    if (!AMBIENT_SYNC || !hasAmbient) return false;
+    if (!isMaster && !clockSync.isSynced()) return false;
+
+    uint32_t sharedNow = isMaster ? micros() : clockSync.toMaster(micros());
+    uint8_t roster = isMaster ? rosterBitmap() : ambientRoster;
+    uint8_t position = 0;
+    if (!isMaster && !isListener) {
+        position = 1 + __builtin_popcount(roster & ((1 << slaveId) - 1));
+    }
+    leds.wave(sharedNow, position, 1 + __builtin_popcount(roster), ambientSeed);
+    return true;
 }
 
 // ==================== UTILITY ====================
 
+Message GameManager::makeMessage(uint8_t type, uint8_t id, uint8_t data, uint32_t value) {
+    Message msg;
+    msg.type = type;
+    msg.slaveId = id;
+    msg.data = data;
+    msg.seq = 0;
+    msg.epoch = sessionEpoch;
+    msg.flags = 0;
+    msg.roster = 0;
+    msg.timestamp = millis();
+    msg.value = value;
+    msg.round = roundNumber;
+    msg.version = 0;
+    // Gli slave parlano solo col master, tranne la falsa partenza che va a tutti
+    msg.dest = (isMaster || type == MSG_FALSE_START) ? NODE_ALL : NODE_MASTER;
+    msg.origin = NODE_ALL;      // Campi di instradamento: li imposta ESPNowManager
+    msg.originSeq = 0;
+    msg.ttl = 0;
+    msg.hops = 0;
+    msg.relayDelayUs = 0;
+    return msg;
+}
+
+// ==================== RISPARMIO ENERGETICO ====================
+
+// Solo slave agganciato e sincronizzato, in attesa fuori da un round: con lo start
+// programmato il frame di START arriva in una finestra e tiene sveglio lo slave fino al via
+bool GameManager::canSleep(uint32_t& sleepUs) {
+    if (!POWER_SAVE || isMaster || isListener) return false;
+    // Un ripetitore addormentato smette di inoltrare fuori dalle finestre di ascolto
+    if (RELAY_MODE && IS_RELAY) return false;
+    if (!isConnected || !clockSync.isSynced()) return false;
+    if (currentState != STATE_WAITING_START && currentState != STATE_WINNER_ANNOUNCED) return false;
+    if (startArmed || startFired || winPending || reactionArmPending || rollbackPending || rollbackActive ||
+        falseStartPending || falseStartActive) return false;
+
+    // Master muto (riavviato o fuori portata): il clock potrebbe non essere più allineato
+    unsigned long now = millis();
+    if (now - lastMasterMessage > POWER_MASTER_SILENCE_MS) return false;
+
+    uint32_t masterNow = clockSync.toMaster(micros());
+    if (PowerManager::inListenWindow(masterNow)) return false;
+
+    // Heartbeat e sync in scadenza: prima li manda il loop
+    unsigned long sinceHeartbeat = now - lastHeartbeatSent;
+    unsigned long sinceSync = now - lastSyncRequest;
+    if (sinceHeartbeat >= HEARTBEAT_INTERVAL_MS || sinceSync >= SYNC_INTERVAL_MS) return false;
+
+    uint32_t us = PowerManager::untilListenWindow(masterNow);
+    us = min(us, (uint32_t)(HEARTBEAT_INTERVAL_MS - sinceHeartbeat) * 1000);
+    us = min(us, (uint32_t)(SYNC_INTERVAL_MS - sinceSync) * 1000);
+    us = min(us, (uint32_t)POWER_FRAME_MS * 1000);
+
+    sleepUs = us;
+    return true;
+}
+
+// ==================== CHECKPOINT ====================
+
+void GameManager::saveCheckpoint() {
+    if (checkpoint == nullptr) return;
+
+    GameCheckpoint cp;
+    captureCheckpoint(cp);
+    checkpoint->save(cp);
+}
+
+void GameManager::captureCheckpoint(GameCheckpoint& cp) {
+    memset(&cp, 0, sizeof(cp));
+    cp.role = isMaster ? ROLE_MASTER : (isListener ? ROLE_LISTENER : ROLE_SLAVE);
+    cp.slaveId = slaveId;
+    cp.state = currentState;
+    cp.winner = winnerSlaveId;
+    cp.round = roundNumber;
+    cp.epoch = sessionEpoch;
+    cp.version = stateVersion;
+
+    if (isMaster) {
+        cp.rosterCount = numConnected;
+        memcpy(cp.rosterIds, connectedSlaves, sizeof(cp.rosterIds));
+        memcpy(cp.rosterMacs, slaveMacs, sizeof(cp.rosterMacs));
+    } else {
+        memcpy(cp.masterMac, masterMac, 6);
+        cp.connected = isConnected && hasMasterMac;
+    }
+}
+
+// Dopo panic/watchdog/brownout riprende il round senza handshake: il master mantiene
+// epoca e roster (gli slave non si accorgono di nulla), lo slave resta agganciato
+bool GameManager::restoreCheckpoint() {
+    if (checkpoint == nullptr || !checkpoint->isWarmBoot()) return false;
+
+    if (!applyCheckpoint(checkpoint->get())) {
+        return false;
+    }
+
+    Log.info("Restored after %s reset (#%u): state %d, round %u, epoch %u",
+             checkpoint->getResetReasonName(), checkpoint->getRecoveries(),
+             currentState, roundNumber, sessionEpoch);
+    saveCheckpoint();
+    return true;
+}
+
+bool GameManager::applyCheckpoint(const GameCheckpoint& cp) {
+    uint8_t role = isMaster ? ROLE_MASTER : (isListener ? ROLE_LISTENER : ROLE_SLAVE);
+    if (cp.role != role || cp.slaveId != slaveId || cp.state > STATE_WINNER_ANNOUNCED) {
+        Log.warn("Checkpoint does not match this device, ignored");
+        return false;
+    }
+
+    unsigned long now = millis();
+    sessionEpoch = cp.epoch;
+    roundNumber = cp.round;
+    winnerSlaveId = cp.winner;
+    currentState = (GameState)cp.state;
+    lastAnimationUpdate = now;
+    gameStartTime = now;
+
+    if (isMaster) {
+        numConnected = 0;
+        for (uint8_t i = 0; i < cp.rosterCount && i < MAX_SLAVES; i++) {
+            uint8_t id = cp.rosterIds[i];
+            if (id >= MAX_SLAVES) continue;
+            espNow.addPeer(cp.rosterMacs[i]);
+            connectedSlaves[numConnected] = id;
+            memcpy(slaveMacs[numConnected], cp.rosterMacs[i], 6);
+            lastHeartbeatReceived[id] = now;
+            numConnected++;
+        }
+        // Versione più alta di qualsiasi snapshot già inviato: gli slave lo applicano
+        stateVersion = cp.version + 1;
+        sendMasterHeartbeat();
+    } else if (!isListener) {
+        memcpy(masterMac, cp.masterMac, 6);
+        hasMasterMac = cp.connected && espNow.addPeer(masterMac);
+        isConnected = hasMasterMac;
+        stateVersion = 0;
+        lastMasterMessage = now;
+        if (isConnected) {
+            lastHeartbeatSent = now;
+            sendHeartbeat();
+        } else {
+            sendConnectRequest();
+        }
+    } else {
+        stateVersion = 0;
+        lastMasterMessage = now;
+    }
+    return true;
+}
+
+// ==================== ASSOCIAZIONE ====================
+
+void GameManager::openPairing() {
+    if (!isMaster) return;
+
+    pairingOpen = true;
+    pairingOpenedAt = millis();
+    pairedCount = 0;
+    Log.info("Pairing open: press the new buttons in order (master button to close)");
+}
+
+void GameManager::closePairing() {
+    if (!pairingOpen) return;
+
+    pairingOpen = false;
+    Log.info("Pairing closed, %d buttons paired", pairedCount);
+}
+
+// Ogni nuovo pulsante riceve il primo ID né connesso né già assegnato in questa sessione:
+// con il roster vuoto gli ID seguono l'ordine di pressione, un sostituto prende l'ID mancante
+void GameManager::handlePairRequest(const Message& msg) {
+    if (!pairingOpen) return;
+
+    uint8_t id = 0xFF;
+    for (uint8_t i = 0; i < pairedCount; i++) {
+        if (pairedTokens[i] == msg.value) {
+            id = pairedIds[i];  // Richiesta ripetuta: l'assegnazione si è persa
+            break;
+        }
+    }
+
+    if (id == 0xFF) {
+        for (uint8_t candidate = 0; candidate < MAX_SLAVES && id == 0xFF; candidate++) {
+            bool taken = isSlaveConnected(candidate);
+            for (uint8_t i = 0; i < pairedCount && !taken; i++) {
+                taken = pairedIds[i] == candidate;
+            }
+            if (!taken) id = candidate;
+        }
+        if (id == 0xFF) {
+            Log.warn("Pairing: no free ID left");
+            return;
+        }
+
+        pairedTokens[pairedCount] = msg.value;
+        pairedIds[pairedCount] = id;
+        pairedCount++;
+        pairingOpenedAt = millis();  // Ogni associazione prolunga la finestra
+        Log.info("Pairing: assigned ID %d", id);
+    }
+
+    Message reply = makeMessage(MSG_PAIR_ASSIGN, id, ROLE_SLAVE, msg.value);
+    espNow.sendMessage(reply);
+}
+
 bool GameManager::isSlaveConnected(uint8_t id) {
     for (uint8_t i = 0; i < numConnected; i++) {
         if (connectedSlaves[i] == id) {
@@ -478,4 +1687,6 @@ void GameManager::addConnectedSlave(uint8_t id, const uint8_t* macAddr) {
     numConnected++;
 
     Log.info("Slave %d connected. Total: %d/%d", id, numConnected, MAX_SLAVES);
+    stateVersion++;
+    saveRoster();
 }
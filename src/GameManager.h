@@ -5,10 +5,20 @@
 #include "config.h"
 #include "LEDController.h"
 #include "ESPNowManager.h"
+#include "NvsStore.h"
+#include "ClockSync.h"
+#include "ReactionTimer.h"
+#include "RtcCheckpoint.h"
+#include "PowerManager.h"
+#include "Profiler.h"
+#include "PatternEngine.h"
+#include "PatternManager.h"
+#include <esp_timer.h>
 
 class GameManager {
 public:
-    GameManager(LEDController& ledController, ESPNowManager& espNowManager, bool isMaster, uint8_t slaveId = 0);
+    GameManager(LEDController& ledController, ESPNowManager& espNowManager, NvsStore& nvsStore,
+                DeviceRole role, uint8_t slaveId = 0);
 
     void begin();
     void update();
@@ -17,19 +27,55 @@ public:
     GameState getState() const { return currentState; }
     void setState(GameState newState);
 
+    // In gioco: master avviato, slave agganciato, listener sintonizzato sul master
+    bool isReady() const { return isMaster || (isListener ? currentState != STATE_INIT : isConnected); }
+
+    // Slave inattivo: può dormire per sleepUs (fino alla prossima finestra o al prossimo evento)
+    bool canSleep(uint32_t& sleepUs);
+
     // Handler messaggi ESP-NOW
     void handleMessage(const Message& msg, const uint8_t* macAddr);
 
     // Gestione pulsante
     void handleButtonPress();
 
+    // Calibrazione latenze per la misura del tempo di reazione
+    void setLatencyCalibration(uint32_t isrLatencyUs);
+
+    // Checkpoint in RTC: salvato dal loop dopo ogni transizione, ripristinato dopo un reset anomalo
+    void setCheckpoint(RtcCheckpoint* checkpoint) { this->checkpoint = checkpoint; }
+
+    // Stato minimo ripristinabile (checkpoint RTC, intestazione delle tracce)
+    void captureCheckpoint(GameCheckpoint& cp);
+    bool applyCheckpoint(const GameCheckpoint& cp);
+
+    // Master: arena (tavolo) annunciata negli heartbeat, per l'hub di torneo
+    void setArenaId(uint8_t arenaId) { this->arenaId = arenaId; }
+    uint8_t getArenaId() const { return arenaId; }
+
+    // Pattern LED programmabili per start, vincitore e falsa partenza
+    void setPatterns(PatternManager* patterns) { this->patterns = patterns; }
+
+    // Slave e listener: il frame arriva dal master agganciato
+    bool isFromMaster(const uint8_t* macAddr) const {
+        return hasMasterMac && memcmp(masterMac, macAddr, 6) == 0;
+    }
+
+    // Master: associazione, assegna gli ID liberi ai nuovi pulsanti in ordine di pressione
+    void openPairing();
+    void closePairing();
+    bool isPairing() const { return pairingOpen; }
+
 private:
     LEDController& leds;
     ESPNowManager& espNow;
+    NvsStore& store;
 
     bool isMaster;
+    bool isListener;
     uint8_t slaveId;
     GameState currentState;
+    uint16_t sessionEpoch;  // Master: epoca corrente. Slave: epoca del master agganciato
 
     // Master specific
     uint8_t connectedSlaves[MAX_SLAVES];
@@ -37,16 +83,80 @@ private:
     uint8_t numConnected;
     uint8_t winnerSlaveId;
     unsigned long gameStartTime;
+    uint16_t roundNumber;       // Master: round corrente. Slave: ultimo round avviato
+    uint16_t stateVersion;      // Master: versione snapshot. Slave: ultima applicata
+
+    // Master specific - arbitraggio con ripetitori (pressioni ritrasmesse arrivano dopo)
+    esp_timer_handle_t arbitrationTimer;
+    volatile bool arbitrationOpen;
+    volatile bool arbitrationExpired; // Settato dal timer, il vincitore lo annuncia il loop
+    uint8_t arbitrationWinner;
+    uint32_t arbitrationBest;         // Arrivo corretto per salti e code dei ripetitori
+
+    // Master specific - con slave in light sleep lo start parte in una finestra di ascolto
+    bool startDeferred;
 
     // Master specific - heartbeat
     unsigned long lastHeartbeatReceived[MAX_SLAVES];
     unsigned long lastMasterHeartbeatSent;
+    unsigned long lastLinkStatsDump;
+
+    // Master specific - ripresa sessione dopo riavvio
+    PersistedRoster resumeRoster;     // Roster letto da NVS all'avvio
+    unsigned long resumeStart;
+    unsigned long lastResumeSent;
 
     // Slave specific
     bool isConnected;
     unsigned long lastConnectRetry;
     unsigned long lastHeartbeatSent;
     unsigned long lastMasterMessage;  // Ultimo messaggio ricevuto dal master
+    uint8_t masterMac[6];             // MAC del master (cache in NVS)
+    bool hasMasterMac;
+    uint32_t masterNonce;             // Con RELAY_MODE: nonce d'origine del master (0 = non noto)
+    uint8_t connectAttempts;
+
+    // Start programmato (master e slave)
+    ClockSync clockSync;                // Slave: offset verso il clock del master
+    esp_timer_handle_t startTimer;
+    volatile bool startArmed;
+    volatile bool startFired;           // Settato dal timer, LED e stato li cambia il loop
+    TaskHandle_t loopTask;              // Svegliato dal timer START_SPIN_US prima dello start
+    uint32_t scheduledStartLocal;       // Istante di start in micros() locali
+    bool scheduledRound;                // Round corrente avviato con start programmato
+    unsigned long lastSyncRequest;
+
+    // Tempo di reazione
+    ReactionTimer reaction;
+    uint32_t goLatchedAt;               // Fine show() del frame di start programmato
+    bool reactionArmPending;            // Start non programmato: arma al primo frame
+
+    // Slave: vincita speculativa (mostrata subito, confermata o annullata dal master)
+    bool winPending;
+    unsigned long winPendingSince;
+    unsigned long winPendingDeadline;
+    uint8_t winQueryCount;
+
+    // Slave: effetto "perso" del rollback, deciso anche dalla callback e disegnato dal loop
+    volatile bool rollbackPending;
+    bool rollbackActive;
+    unsigned long rollbackStart;
+
+    // Tutti: lampeggio di falsa partenza, deciso anche dalla callback e disegnato dal loop
+    volatile bool falseStartPending;
+    bool falseStartActive;
+    unsigned long falseStartBegin;
+
+    // Slave: copie ridondanti della pressione (stesso ID, partenze sparse nella finestra)
+    esp_timer_handle_t pressCopyTimer;
+    Message pressCopy;
+    uint32_t pressId;
+    uint32_t pressSentAt;
+    uint8_t pressCopiesSent;
+
+    // Master: ultima pressione accettata per slave, le copie successive si scartano
+    uint32_t lastPressId[MAX_SLAVES];
+    uint32_t pressDuplicates;
 
     // Button debounce
     bool buttonPressed;
@@ -61,20 +171,83 @@ private:
     void handleButtonPressedFromSlave(const Message& msg);
     void startGame();
     void announceWinner(uint8_t slaveId);
+    void sendSyncReply(const Message& msg, const uint8_t* macAddr);
     void checkHeartbeats();
-    void sendMasterHeartbeat();
+    void sendMasterHeartbeat(uint8_t destId = NODE_ALL, const uint8_t* macAddr = nullptr);
+    static void onArbitrationTimer(void* arg);
+    void closeArbitration();
+    uint8_t rosterBitmap();
     void removeConnectedSlave(uint8_t id);
+    void resumeSession();
+    void sendResume();
+    bool resumePending();
+    void saveRoster();
 
     // Metodi privati Slave
     void updateSlave();
     void sendConnectRequest();
     void sendButtonPressed();
+    void schedulePressCopy();
+    static void onPressCopyTimer(void* arg);
     void sendHeartbeat();
+    void sendSyncRequest();
+    void sendFalseStart();
+    bool pressedBeforeStart();
+    void sendReactionResult(uint32_t reactionUs);
+    void checkSpeculativeWin();
+    void resolveSpeculativeWin(uint8_t actualWinner);
+    void rollbackEffect();
+    bool showRollback(unsigned long now);
+    bool acceptMasterFrame(const Message& msg, const uint8_t* macAddr);
+    bool checkMasterEpoch(const Message& msg, const uint8_t* macAddr);
+    void rememberMaster(const uint8_t* macAddr, uint16_t epoch);
+
+    // Start programmato
+    void armScheduledStart(uint32_t localStart);
+    void cancelScheduledStart();
+    void updateScheduledStart();
+    static void onStartTimer(void* arg);
+
+    // Snapshot autorevole del master (slave e listener)
+    void applySnapshot(const Message& msg);
+
+    // Metodi privati Listener (display passivo, nessun invio)
+    void updateListener();
+    void handleListenerMessage(const Message& msg, const uint8_t* macAddr);
 
     // Falsa partenza
     void falseStartFlash();
+    bool showFalseStart(unsigned long now);
+
+    // Animazione ambiente sincronizzata (tempo e seme del master, posizione nel roster)
+    uint8_t ambientSeed;                // Master: scelto ad ogni round. Slave/listener: dall'heartbeat
+    uint8_t ambientRoster;              // Slave/listener: roster dell'ultimo heartbeat
+    uint8_t arenaId;
+    bool hasAmbient;
+    bool showAmbient();
+
+    // Pattern programmabili: slot in esecuzione, ricaricato se cambia slot o programma
+    PatternManager* patterns;
+    PatternEngine pattern;
+    uint8_t patternSlot;
+    uint16_t patternVersion;
+    bool playPattern(uint8_t slot, uint32_t contextColor);
+
+    // Checkpoint
+    RtcCheckpoint* checkpoint;
+    void saveCheckpoint();
+    bool restoreCheckpoint();
+
+    // Master: associazione
+    bool pairingOpen;
+    unsigned long pairingOpenedAt;
+    uint8_t pairedCount;
+    uint32_t pairedTokens[MAX_SLAVES];  // Token dei pulsanti associati in questa sessione
+    uint8_t pairedIds[MAX_SLAVES];
+    void handlePairRequest(const Message& msg);
 
     // Utility
+    Message makeMessage(uint8_t type, uint8_t id, uint8_t data = 0, uint32_t value = 0);
     bool isSlaveConnected(uint8_t id);
     void addConnectedSlave(uint8_t id, const uint8_t* macAddr);
 };
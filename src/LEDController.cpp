@@ -1,25 +1,47 @@
 #include "LEDController.h"
+#include "Profiler.h"
+#include "Logger.h"
 
 LEDController::LEDController(uint8_t pin, uint16_t numLeds) {
     this->numLeds = numLeds;
     this->strip = new Adafruit_NeoPixel(numLeds, pin, NEO_GRB + NEO_KHZ800);
     this->lastUpdate = 0;
     this->animationStep = 0;
+    this->lastShowEnd = 0;
+    this->splashOn = false;
+    this->splashStart = 0;
+    this->splashDuration = 0;
+    this->budgetMa = LED_BUDGET_MA;
+    this->limitScale = 256;
+    this->framesShown = 0;
+    this->framesLimited = 0;
+    this->peakUa = 0;
+    this->minScale = 256;
+    this->statsSince = 0;
+}
+
+// Tutti gli show passano da qui: registra quando il frame è stato trasmesso
+void LEDController::show() {
+    PROFILE_SCOPE(PROF_LED_SHOW);
+    limitCurrent();
+    strip->show();
+    lastShowEnd = micros();
 }
 
 void LEDController::begin() {
     strip->begin();
     strip->setBrightness(255);  // Massima luminosità (0-255)
     clear();
-    strip->show();
+    show();
 }
 
 void LEDController::setColor(uint32_t color) {
+    splashOn = false;
     strip->setBrightness(255);
     for (uint16_t i = 0; i < numLeds; i++) {
         strip->setPixelColor(i, color);
     }
-    strip->show();
+    show();
 }
 
 void LEDController::setColor(uint8_t r, uint8_t g, uint8_t b) {
@@ -28,20 +50,21 @@ void LEDController::setColor(uint8_t r, uint8_t g, uint8_t b) {
 
 void LEDController::setBrightness(uint8_t brightness) {
     strip->setBrightness(brightness);
-    strip->show();
+    show();
 }
 
 void LEDController::clear() {
     strip->clear();
-    strip->show();
+    show();
 }
 
 void LEDController::update() {
-    strip->show();
+    show();
 }
 
 // Effetto pulsante (fade in/out)
 void LEDController::pulse(uint32_t color, uint16_t duration) {
+    if (isSplashing()) return;
     unsigned long now = millis();
     if (now - lastUpdate > 20) {  // Aggiorna ogni 20ms
         lastUpdate = now;
@@ -57,6 +80,7 @@ void LEDController::pulse(uint32_t color, uint16_t duration) {
 
 // Effetto arcobaleno
 void LEDController::rainbow(uint16_t duration) {
+    if (isSplashing()) return;
     unsigned long now = millis();
     if (now - lastUpdate > duration / 256) {
         lastUpdate = now;
@@ -67,12 +91,13 @@ void LEDController::rainbow(uint16_t duration) {
             uint16_t hue = ((i * 256 / numLeds) + animationStep) % 256;
             strip->setPixelColor(i, strip->ColorHSV(hue * 256));
         }
-        strip->show();
+        show();
     }
 }
 
 // Cicla tra diversi colori
 void LEDController::cycleColors(uint32_t* colors, uint8_t numColors, uint16_t intervalMs) {
+    if (isSplashing()) return;
     unsigned long now = millis();
     if (now - lastUpdate >= intervalMs) {
         lastUpdate = now;
@@ -83,6 +108,7 @@ void LEDController::cycleColors(uint32_t* colors, uint8_t numColors, uint16_t in
 
 // Effetto spinner circolare (un LED alla volta che gira)
 void LEDController::spinner(uint32_t color, uint16_t speedMs) {
+    if (isSplashing()) return;
     unsigned long now = millis();
     if (now - lastUpdate >= speedMs) {
         lastUpdate = now;
@@ -98,12 +124,13 @@ void LEDController::spinner(uint32_t color, uint16_t speedMs) {
                              strip->Color(r / 4, g / 4, b / 4));
         strip->setPixelColor((animationStep - 2 + numLeds) % numLeds,
                              strip->Color(r / 16, g / 16, b / 16));
-        strip->show();
+        show();
     }
 }
 
 // Effetto lampeggio di tutti i LED
 void LEDController::blink(uint32_t color, uint16_t intervalMs) {
+    if (isSplashing()) return;
     unsigned long now = millis();
     if (now - lastUpdate >= intervalMs) {
         lastUpdate = now;
@@ -119,6 +146,111 @@ void LEDController::blink(uint32_t color, uint16_t intervalMs) {
     }
 }
 
+// Nessuno stato locale: nodi con lo stesso tempo condiviso disegnano frame coerenti
+void LEDController::wave(uint32_t sharedMicros, uint8_t position, uint8_t count, uint8_t seed) {
+    if (isSplashing()) return;
+    unsigned long now = millis();
+    if (now - lastUpdate > 20) {  // Aggiorna ogni 20ms
+        lastUpdate = now;
+
+        uint16_t phase = (uint64_t)(sharedMicros % AMBIENT_PERIOD_US) * 65536 / AMBIENT_PERIOD_US;
+        uint32_t total = (uint32_t)max(count, (uint8_t)1) * numLeds;
+
+        strip->setBrightness(255);
+        for (uint16_t i = 0; i < numLeds; i++) {
+            // La tinta cala lungo la fila: l'onda avanza nell'ordine del roster
+            uint32_t index = (uint32_t)position * numLeds + i;
+            uint16_t hue = phase + ((uint16_t)seed << 8) - (uint16_t)(index * 65536 / total);
+            strip->setPixelColor(i, strip->ColorHSV(hue));
+        }
+        show();
+    }
+}
+
+void LEDController::showFrame(const uint8_t* rgb) {
+    if (isSplashing()) return;
+
+    strip->setBrightness(255);
+    for (uint16_t i = 0; i < numLeds; i++) {
+        strip->setPixelColor(i, rgb[i * 3], rgb[i * 3 + 1], rgb[i * 3 + 2]);
+    }
+    show();
+}
+
+void LEDController::splash(uint32_t color, uint16_t durationMs) {
+    setColor(color);
+    splashOn = true;
+    splashStart = millis();
+    splashDuration = durationMs;
+}
+
+bool LEDController::isSplashing() {
+    if (splashOn && millis() - splashStart >= splashDuration) {
+        // Fine splash: spegne, la prossima animazione riparte da zero
+        splashOn = false;
+        clear();
+    }
+    return splashOn;
+}
+
+// Stima la corrente del frame dai byte già pronti (luminosità compresa) e, oltre il budget,
+// li scala in proporzione. Il frame scalato resta nel buffer: riproporlo non lo riduce ancora.
+void LEDController::limitCurrent() {
+    uint8_t* pixels = strip->getPixels();
+    uint32_t channelSum = 0;
+    for (uint16_t i = 0; i < numLeds * 3; i++) {
+        channelSum += pixels[i];
+    }
+
+    uint32_t idleUa = (uint32_t)numLeds * LED_IDLE_UA;
+    uint32_t dynamicUa = channelSum * (LED_CHANNEL_UA / 255);
+    uint32_t totalUa = idleUa + dynamicUa;
+    uint32_t budgetUa = (uint32_t)budgetMa * 1000;
+    framesShown++;
+    if (totalUa > peakUa) peakUa = totalUa;
+
+    // Scala che porta il frame al budget; verso l'alto si torna gradualmente
+    uint16_t needed = 256;
+    if (totalUa > budgetUa && dynamicUa > 0) {
+        needed = budgetUa > idleUa ? (uint16_t)((uint64_t)(budgetUa - idleUa) * 256 / dynamicUa) : 0;
+    }
+    if (needed < limitScale) {
+        limitScale = needed;
+    } else {
+        limitScale = min((uint16_t)(limitScale + LED_LIMIT_RELEASE), needed);
+    }
+
+    if (limitScale >= 256 || channelSum == 0) return;
+
+    framesLimited++;
+    if (limitScale < minScale) minScale = limitScale;
+    for (uint16_t i = 0; i < numLeds * 3; i++) {
+        pixels[i] = (pixels[i] * limitScale) >> 8;
+    }
+}
+
+bool LEDController::handleCommand(const char* line) {
+    if (strncmp(line, "led", 3) != 0 || (line[3] != ' ' && line[3] != '\0')) return false;
+
+    if (strcmp(line, "led reset") == 0) {
+        framesShown = 0;
+        framesLimited = 0;
+        peakUa = 0;
+        minScale = 256;
+        statsSince = millis();
+        Log.info("LED stats reset");
+        return true;
+    }
+
+    uint32_t pct = framesShown > 0 ? framesLimited * 100 / framesShown : 0;
+    Log.info("LED budget %u mA, peak estimate %lu mA, limited %lu/%lu frames (%lu%%), min scale %u%%, over %lus",
+             budgetMa, (unsigned long)(peakUa / 1000), (unsigned long)framesLimited,
+             (unsigned long)framesShown, (unsigned long)pct, minScale * 100 / 256,
+             (unsigned long)((millis() - statsSince) / 1000));
+    return true;
+}
+
 uint32_t LEDController::getColor(uint8_t r, uint8_t g, uint8_t b) {
     return strip->Color(r, g, b);
 }
+
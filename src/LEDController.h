@@ -23,16 +23,60 @@ public:
     void spinner(uint32_t color, uint16_t speedMs);
     void blink(uint32_t color, uint16_t intervalMs);
 
+    // Fetta di un arcobaleno che scorre su più dispositivi: il tempo (micros() del master)
+    // dà la fase, position/count la posizione di questo nodo nella fila, seed la tinta di partenza
+    void wave(uint32_t sharedMicros, uint8_t position, uint8_t count, uint8_t seed);
+
+    // Frame già calcolato (pattern programmabili): numLeds terne R, G, B
+    void showFrame(const uint8_t* rgb);
+    uint16_t getNumLeds() const { return numLeds; }
+
+    // Colore fisso non bloccante: sospende le animazioni per durationMs,
+    // un setColor() esplicito (stato di gioco) lo interrompe subito
+    void splash(uint32_t color, uint16_t durationMs);
+    bool isSplashing();
+
+    // La prossima chiamata di un'animazione disegna subito un frame (benchmark)
+    void forceNextFrame() { lastUpdate = 0; }
+
     // Utility
     uint32_t getColor(uint8_t r, uint8_t g, uint8_t b);
 
+    // Limite di corrente: ogni frame oltre il budget viene scalato prima di show()
+    void setCurrentBudget(uint16_t budgetMa) { this->budgetMa = budgetMa; }
+    uint16_t getCurrentBudget() const { return budgetMa; }
+
+    // Comandi seriali: "led" (statistiche del limitatore), "led reset"
+    bool handleCommand(const char* line);
+
+    // Timing: fine dell'ultimo show() (micros)
+    uint32_t getLastShowEnd() const { return lastShowEnd; }
+
 private:
     Adafruit_NeoPixel* strip;
     uint16_t numLeds;
+    volatile uint32_t lastShowEnd;
+
+    void show();
+    void limitCurrent();
+
+    // Limitatore di corrente
+    uint16_t budgetMa;
+    uint16_t limitScale;        // Fattore applicato (/256): scende subito, risale di LED_LIMIT_RELEASE
+    uint32_t framesShown;
+    uint32_t framesLimited;
+    uint32_t peakUa;            // Stima massima prima della limitazione
+    uint16_t minScale;
+    uint32_t statsSince;
 
     // Variabili per animazioni
     unsigned long lastUpdate;
     uint16_t animationStep;
+
+    // Splash di avvio
+    bool splashOn;
+    unsigned long splashStart;
+    uint16_t splashDuration;
 };
 
 #endif // LED_CONTROLLER_H
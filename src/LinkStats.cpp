@@ -0,0 +1,156 @@
+#include "LinkStats.h"
+#include "Logger.h"
+
+LinkStats::LinkStats() {
+    memset(entries, 0, sizeof(entries));
+    mux = portMUX_INITIALIZER_UNLOCKED;
+}
+
+LinkStats::Entry* LinkStats::find(const uint8_t* macAddr, bool create) {
+    Entry* oldest = &entries[0];
+
+    for (uint8_t i = 0; i < LINK_TABLE_SIZE; i++) {
+        if (entries[i].used && memcmp(entries[i].mac, macAddr, 6) == 0) {
+            entries[i].lastSeen = millis();
+            return &entries[i];
+        }
+        if (!entries[i].used || (oldest->used && entries[i].lastSeen < oldest->lastSeen)) {
+            oldest = &entries[i];
+        }
+    }
+
+    if (!create) return nullptr;
+
+    // Tabella piena: sostituisce il link visto meno di recente
+    memset(oldest, 0, sizeof(Entry));
+    memcpy(oldest->mac, macAddr, 6);
+    oldest->used = true;
+    oldest->lastSeen = millis();
+    return oldest;
+}
+
+const LinkStats::Entry* LinkStats::find(const uint8_t* macAddr) const {
+    for (uint8_t i = 0; i < LINK_TABLE_SIZE; i++) {
+        if (entries[i].used && memcmp(entries[i].mac, macAddr, 6) == 0) {
+            return &entries[i];
+        }
+    }
+    return nullptr;
+}
+
+void LinkStats::updateEma(uint16_t& ema, uint16_t sample) {
+    int32_t diff = (int32_t)(sample << 4) - ema;
+    ema += diff / (1 << EMA_SHIFT);
+}
+
+uint8_t LinkStats::nextTxSeq(const uint8_t* macAddr) {
+    portENTER_CRITICAL(&mux);
+    Entry* e = find(macAddr, true);
+    uint8_t seq = e->txSeq++;
+    portEXIT_CRITICAL(&mux);
+    return seq;
+}
+
+void LinkStats::onTxAttempt(const uint8_t* macAddr) {
+    portENTER_CRITICAL(&mux);
+    Entry* e = find(macAddr, true);
+    e->txAttempts++;
+    portEXIT_CRITICAL(&mux);
+}
+
+void LinkStats::onTxComplete(const uint8_t* macAddr, bool success) {
+    portENTER_CRITICAL(&mux);
+    Entry* e = find(macAddr, true);
+    if (!success) e->txFailures++;
+    updateEma(e->txFailEma, success ? 0 : 100);
+    portEXIT_CRITICAL(&mux);
+}
+
+void LinkStats::onRx(const uint8_t* macAddr, uint8_t seq, bool broadcast) {
+    portENTER_CRITICAL(&mux);
+    Entry* e = find(macAddr, true);
+    e->rxCount++;
+    if (broadcast) {
+        countRx(*e, seq, e->lastBcastSeq, e->hasBcastSeq);
+    } else {
+        countRx(*e, seq, e->lastUcastSeq, e->hasUcastSeq);
+    }
+    portEXIT_CRITICAL(&mux);
+}
+
+void LinkStats::countRx(Entry& e, uint8_t seq, uint8_t& lastSeq, bool& hasSeq) {
+    if (hasSeq) {
+        uint8_t gap = (uint8_t)(seq - lastSeq - 1);
+        // Buchi enormi = riavvio del mittente o duplicato, non perdita
+        if (gap < 128) {
+            e.rxLost += gap;
+            updateEma(e.lossEma, (uint16_t)(gap * 100 / (gap + 1)));
+        }
+    }
+    lastSeq = seq;
+    hasSeq = true;
+}
+
+void LinkStats::onRssi(const uint8_t* macAddr, int8_t rssi) {
+    // Solo per link già noti: il promiscuo vede anche traffico estraneo
+    portENTER_CRITICAL(&mux);
+    Entry* e = find(macAddr, false);
+    if (e != nullptr) {
+        if (e->rssiEma == 0) {
+            e->rssiEma = rssi * 16;
+        } else {
+            e->rssiEma += (rssi * 16 - e->rssiEma) / (1 << EMA_SHIFT);
+        }
+        e->lastRssi = rssi;
+    }
+    portEXIT_CRITICAL(&mux);
+}
+
+void LinkStats::fillSnapshot(const Entry& e, LinkSnapshot& out) const {
+    memcpy(out.mac, e.mac, 6);
+    out.rssi = (int8_t)(e.rssiEma / 16);
+    out.lossPct = (uint8_t)(e.lossEma / 16);
+    out.txFailPct = (uint8_t)(e.txFailEma / 16);
+    out.txCount = (uint16_t)(e.txAttempts > 0xFFFF ? 0xFFFF : e.txAttempts);
+    out.rxCount = (uint16_t)(e.rxCount > 0xFFFF ? 0xFFFF : e.rxCount);
+}
+
+uint8_t LinkStats::snapshot(LinkSnapshot* out, uint8_t maxEntries) const {
+    uint8_t n = 0;
+    portENTER_CRITICAL(&mux);
+    for (uint8_t i = 0; i < LINK_TABLE_SIZE && n < maxEntries; i++) {
+        if (!entries[i].used) continue;
+        fillSnapshot(entries[i], out[n++]);
+    }
+    portEXIT_CRITICAL(&mux);
+    return n;
+}
+
+bool LinkStats::getLink(const uint8_t* macAddr, LinkSnapshot& out) const {
+    portENTER_CRITICAL(&mux);
+    const Entry* e = find(macAddr);
+    if (e != nullptr) {
+        fillSnapshot(*e, out);
+    }
+    portEXIT_CRITICAL(&mux);
+    return e != nullptr;
+}
+
+void LinkStats::dump() const {
+    // Copia sotto lock, stampa fuori: il log non va in sezione critica
+    Entry copy[LINK_TABLE_SIZE];
+    portENTER_CRITICAL(&mux);
+    memcpy(copy, entries, sizeof(copy));
+    portEXIT_CRITICAL(&mux);
+
+    Log.info("=== Link stats ===");
+    for (uint8_t i = 0; i < LINK_TABLE_SIZE; i++) {
+        const Entry& e = copy[i];
+        if (!e.used) continue;
+        Log.info("%02X:%02X:%02X:%02X:%02X:%02X  TX %lu (fail %lu, %u%%)  RX %lu (lost %lu, %u%%)  RSSI %d dBm",
+                 e.mac[0], e.mac[1], e.mac[2], e.mac[3], e.mac[4], e.mac[5],
+                 (unsigned long)e.txAttempts, (unsigned long)e.txFailures, e.txFailEma / 16,
+                 (unsigned long)e.rxCount, (unsigned long)e.rxLost, e.lossEma / 16,
+                 e.rssiEma / 16);
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef LINK_STATS_H
+#define LINK_STATS_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// Snapshot compatto di un link (per dump o invio)
+struct LinkSnapshot {
+    uint8_t mac[6];
+    int8_t rssi;            // RSSI medio (EMA), dBm
+    uint8_t lossPct;        // Perdita stimata da buchi di sequenza (EMA), %
+    uint8_t txFailPct;      // Invii falliti (EMA), %
+    uint16_t txCount;
+    uint16_t rxCount;
+} __attribute__((packed));
+
+// Statistiche per-peer della radio in una tabella fissa indicizzata per MAC.
+// Scritta dal loop (invii) e dalle callback ESP-NOW (task WiFi): ogni accesso passa da mux,
+// anche perché la sostituzione di un link azzera una voce che l'altro task può usare.
+class LinkStats {
+public:
+    LinkStats();
+
+    void onTxAttempt(const uint8_t* macAddr);
+    void onTxComplete(const uint8_t* macAddr, bool success);
+    void onRx(const uint8_t* macAddr, uint8_t seq, bool broadcast);
+    void onRssi(const uint8_t* macAddr, int8_t rssi);
+
+    // Sequenza di invio per destinazione (broadcast e unicast hanno spazi separati)
+    uint8_t nextTxSeq(const uint8_t* macAddr);
+
+    uint8_t snapshot(LinkSnapshot* out, uint8_t maxEntries) const;
+    bool getLink(const uint8_t* macAddr, LinkSnapshot& out) const;
+    void dump() const;
+
+private:
+    struct Entry {
+        uint8_t mac[6];
+        bool used;
+        unsigned long lastSeen;
+
+        uint32_t txAttempts;
+        uint32_t txFailures;
+        uint32_t rxCount;
+        uint32_t rxLost;
+
+        uint8_t txSeq;
+        uint8_t lastBcastSeq;
+        uint8_t lastUcastSeq;
+        bool hasBcastSeq;
+        bool hasUcastSeq;
+
+        int8_t lastRssi;
+        // EMA in virgola fissa (x16), alpha = 1/8
+        int16_t rssiEma;
+        uint16_t lossEma;       // % x16
+        uint16_t txFailEma;     // % x16
+    };
+
+    static constexpr uint8_t EMA_SHIFT = 3;
+
+    Entry entries[LINK_TABLE_SIZE];
+    mutable portMUX_TYPE mux;
+
+    // Da chiamare in sezione critica
+    Entry* find(const uint8_t* macAddr, bool create);
+    const Entry* find(const uint8_t* macAddr) const;
+    void fillSnapshot(const Entry& e, LinkSnapshot& out) const;
+    static void updateEma(uint16_t& ema, uint16_t sample);
+    void countRx(Entry& e, uint8_t seq, uint8_t& lastSeq, bool& hasSeq);
+};
+
+#endif // LINK_STATS_H
@@ -0,0 +1,604 @@
+#include "LoadGenerator.h"
+
+#ifdef LOADGEN_MODE
+
+#include "Logger.h"
+#include "GameManager.h"
+#include "NvsStore.h"
+#include <esp_system.h>
+
+// Uscita del logger durante "load local": il master simulato formatta tutto, non trasmette nulla
+class NullStream : public Stream {
+public:
+    size_t write(uint8_t) override { return 1; }
+    size_t write(const uint8_t*, size_t size) override { return size; }
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    void flush() override {}
+};
+
+static NullStream nullStream;
+
+// Roster del master simulato: fuori dal namespace di gioco
+static NvsStore scratchStore("prenoto_load");
+static GameManager* localMaster = nullptr;
+
+static void forwardToLocal(const Message& msg, const uint8_t* macAddr) {
+    localMaster->handleMessage(msg, macAddr);
+}
+
+LoadGenerator* LoadGenerator::instance = nullptr;
+
+LoadGenerator::LoadGenerator(LEDController& leds, ESPNowManager& espNow)
+    : leds(leds), espNow(espNow) {
+    mux = portMUX_INITIALIZER_UNLOCKED;
+    scenario = LOAD_IDLE;
+    phase = PHASE_BASELINE;
+    masterEpoch = 0;
+    lastStartRound = 0;
+    probeSeq = 0;
+    probeInFlight = false;
+    probeSentAt = 0;
+    lineLen = 0;
+    instance = this;
+}
+
+void LoadGenerator::begin() {
+    // Tutte le risposte del master, qualunque ID virtuale abbiano come destinatario
+    espNow.setNodeId(NODE_LISTENER);
+    espNow.setMessageCallback(onMessage);
+}
+
+void LoadGenerator::onMessage(const Message& msg, const uint8_t* macAddr) {
+    if (instance != nullptr) {
+        instance->handleMessage(msg, macAddr);
+    }
+}
+
+void LoadGenerator::handleMessage(const Message& msg, const uint8_t* macAddr) {
+    uint32_t now = micros();
+    if (msg.origin != NODE_MASTER) return;
+
+    uint8_t validMask = (1 << min((int)virtualCount, MAX_SLAVES)) - 1;
+
+    portENTER_CRITICAL(&mux);
+    masterEpoch = msg.epoch;
+    bool loading = phase == PHASE_LOAD;
+
+    switch (msg.type) {
+        case MSG_SYNC_REPLY:
+            if (probeInFlight && msg.data == probeSeq) {
+                uint32_t rtt = now - probeSentAt;
+                probeInFlight = false;
+                if (!loading) {
+                    stats.baselineSumUs += rtt;
+                    stats.baselineCount++;
+                } else {
+                    stats.probeSumUs += rtt;
+                    stats.probeCount++;
+                    if (rtt > stats.probeMaxUs) stats.probeMaxUs = rtt;
+                }
+            }
+            break;
+
+        case MSG_CONNECT_ACK:
+            if (scenario == LOAD_CONNECT && loading && msg.slaveId < LOADGEN_MAX_VIRTUAL) {
+                uint64_t bit = 1ULL << msg.slaveId;
+                if (msg.slaveId >= MAX_SLAVES) {
+                    stats.errors++;             // ID fuori roster: andava rifiutato
+                } else if (!(ackedMask & bit)) {
+                    stats.responses++;
+                }
+                ackedMask |= bit;
+            }
+            break;
+
+        case MSG_MASTER_HEARTBEAT:
+            // Slave virtuale agganciato sparito dal roster: heartbeat persi sotto carico
+            if (scenario == LOAD_HEARTBEAT && loading) {
+                stats.responses++;
+                if (hasRoster) {
+                    stats.errors += __builtin_popcount(lastRoster & ~msg.roster & validMask);
+                }
+            }
+            lastRoster = msg.roster;
+            hasRoster = true;
+            break;
+
+        case MSG_START_GAME:
+            if (scenario == LOAD_PRESS && loading && msg.round != lastStartRound) {
+                lastStartRound = msg.round;
+                pressDelayUs = LOADGEN_PRESS_MARGIN_US + ((msg.data & START_FLAG_SCHEDULED) ? START_LEAD_US : 0);
+                startHeardAt = now;
+                startHeard = true;
+                stats.expected++;
+            }
+            break;
+
+        case MSG_WINNER_ANNOUNCE:
+            if (scenario == LOAD_PRESS && awaitingWinner) {
+                awaitingWinner = false;
+                stats.responses++;
+                if (msg.slaveId != expectedWinner) stats.errors++;
+                lastWinner = msg.slaveId;
+                winnerAt = now;
+                roundDone = true;
+            }
+            break;
+
+        default:
+            break;
+    }
+    portEXIT_CRITICAL(&mux);
+}
+
+// Frame come lo costruirebbe lo slave virtuale; in broadcast come gli slave veri.
+// Coda locale piena: il frame non parte e si conta a parte (limite di questa scheda).
+bool LoadGenerator::sendAs(uint8_t type, uint8_t virtualId, TxPriority prio, uint8_t data, uint32_t value) {
+    if (!espNow.hasTxRoom(prio)) {
+        stats.localDrops++;
+        return false;
+    }
+
+    Message msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type = type;
+    msg.slaveId = virtualId;
+    msg.data = data;
+    msg.epoch = masterEpoch;
+    msg.timestamp = millis();
+    msg.value = value;
+    msg.round = lastStartRound;
+    msg.dest = NODE_MASTER;
+    if (!espNow.sendMessage(msg)) {
+        stats.localDrops++;
+        return false;
+    }
+    return true;
+}
+
+void LoadGenerator::sendProbe() {
+    if (!espNow.hasTxRoom(TX_PRIO_NORMAL)) return;
+
+    portENTER_CRITICAL(&mux);
+    probeSeq++;
+    probeSentAt = micros();
+    probeInFlight = true;
+    portEXIT_CRITICAL(&mux);
+
+    sendAs(MSG_SYNC_REQUEST, 0, TX_PRIO_NORMAL, probeSeq);
+    stats.probesSent++;
+}
+
+void LoadGenerator::startScenario(Scenario next, uint32_t seconds) {
+    portENTER_CRITICAL(&mux);
+    memset(&stats, 0, sizeof(stats));
+    ackedMask = 0;
+    hasRoster = false;
+    startHeard = false;
+    awaitingWinner = false;
+    roundDone = false;
+    expectedWinner = 0xFF;
+    probeInFlight = false;
+    phase = PHASE_BASELINE;
+    portEXIT_CRITICAL(&mux);
+
+    roundsSeen = 0;
+    nextVirtual = 0;
+    ticksDone = 0;
+    durationMs = seconds * 1000;
+    scenarioStart = millis();
+    lastReport = scenarioStart;
+    probeSentAt = micros();
+    scenario = next;
+
+    // Le risposte unicast del master (ACK, SYNC_REPLY) richiedono che abbia questa scheda
+    // tra i peer: ci si presenta come slave virtuale 0, come farebbe uno slave vero
+    sendAs(MSG_CONNECT_REQUEST, 0, TX_PRIO_NORMAL);
+    Log.info("Load: %s, %d virtual slaves, measuring idle latency...", scenarioName(next), virtualCount);
+}
+
+void LoadGenerator::update() {
+    if (scenario == LOAD_IDLE) {
+        leds.pulse(COLOR_PINK, 3000);
+        return;
+    }
+    leds.spinner(COLOR_PINK, 60);
+
+    // Sonda: una in volo, persa oltre il timeout
+    uint32_t nowUs = micros();
+    portENTER_CRITICAL(&mux);
+    bool expired = probeInFlight && nowUs - probeSentAt > LOADGEN_PROBE_TIMEOUT_MS * 1000UL;
+    if (expired) {
+        probeInFlight = false;
+        stats.probesLost++;
+    }
+    bool probeIdle = !probeInFlight;
+    portEXIT_CRITICAL(&mux);
+    if (probeIdle && nowUs - probeSentAt >= LOADGEN_PROBE_MS * 1000UL) {
+        sendProbe();
+    }
+
+    unsigned long now = millis();
+
+    // Riposo: solo sonde. Senza risposte si parte comunque (latenza a riposo = 0)
+    if (phase == PHASE_BASELINE) {
+        if (stats.baselineCount < LOADGEN_BASELINE_PROBES && stats.probesSent < 2 * LOADGEN_BASELINE_PROBES) {
+            return;
+        }
+        if (stats.baselineCount == 0) {
+            Log.warn("Load: no reply from the master, is it running?");
+        }
+        portENTER_CRITICAL(&mux);
+        phase = PHASE_LOAD;
+        portEXIT_CRITICAL(&mux);
+        scenarioStart = now;
+        lastReport = now;
+        loadStartUs = micros();
+        return;
+    }
+
+    uint32_t elapsedUs = micros() - loadStartUs;
+    switch (scenario) {
+        case LOAD_CONNECT:
+            updateConnect(elapsedUs);
+            break;
+        case LOAD_HEARTBEAT:
+            updateHeartbeat(elapsedUs);
+            break;
+        case LOAD_PRESS:
+            if (startHeard && micros() - startHeardAt >= pressDelayUs) {
+                firePresses();
+            }
+            if (roundDone) {
+                roundDone = false;
+                roundsSeen++;
+                Log.info("Load: round %u winner %d (expected %d), %lu us after the first press",
+                         roundsSeen, lastWinner, expectedWinner, (unsigned long)(winnerAt - firstPressAt));
+                Log.info("Load: press the master button twice for the next round");
+            }
+            break;
+        default:
+            break;
+    }
+
+    if (now - lastReport >= LOADGEN_REPORT_MS) {
+        lastReport = now;
+        Log.info("Load: %lu frames sent, %lu local drops, %lu/%lu responses, %lu errors",
+                 (unsigned long)stats.sent, (unsigned long)stats.localDrops,
+                 (unsigned long)stats.responses, (unsigned long)stats.expected, (unsigned long)stats.errors);
+    }
+
+    bool done = scenario == LOAD_PRESS ? roundsSeen >= roundsWanted : now - scenarioStart >= durationMs;
+    if (done) {
+        finishScenario();
+    }
+}
+
+// Tempesta di connessioni: ad ogni giro tutti gli slave non ancora agganciati ritentano
+// insieme, come dopo un blackout. A coda piena il giro riprende al loop successivo.
+void LoadGenerator::updateConnect(uint32_t elapsedUs) {
+    uint32_t due = elapsedUs / (LOADGEN_CONNECT_RETRY_MS * 1000UL) + 1;
+    if (nextVirtual == 0) {
+        if (ticksDone >= due) return;
+        ticksDone++;
+    }
+
+    while (nextVirtual < virtualCount) {
+        portENTER_CRITICAL(&mux);
+        bool acked = ackedMask & (1ULL << nextVirtual);
+        portEXIT_CRITICAL(&mux);
+        if (!acked) {
+            if (!espNow.hasTxRoom(TX_PRIO_NORMAL)) return;
+            if (sendAs(MSG_CONNECT_REQUEST, nextVirtual, TX_PRIO_NORMAL)) stats.sent++;
+        }
+        nextVirtual++;
+    }
+    nextVirtual = 0;
+}
+
+// virtualCount * rateHz heartbeat al secondo, a gruppi di burst frame consecutivi
+void LoadGenerator::updateHeartbeat(uint32_t elapsedUs) {
+    uint32_t due = (uint64_t)elapsedUs * virtualCount * rateHz / (1000000ULL * burst);
+    while (ticksDone < due) {
+        ticksDone++;
+        for (uint8_t b = 0; b < burst; b++) {
+            if (sendAs(MSG_HEARTBEAT, nextVirtual, TX_PRIO_HOUSEKEEPING)) stats.sent++;
+            nextVirtual = (nextVirtual + 1) % virtualCount;
+        }
+    }
+}
+
+// Tutti gli slave virtuali premono dopo il via, a spreadUs l'uno dall'altro, partendo ogni
+// round da un ID diverso. Ogni pressione parte in pressCopies copie con lo stesso ID, come
+// dagli slave veri (una per fetta di PRESS_JITTER_US). Vince il primo ID valido partito:
+// gli ID oltre MAX_SLAVES vanno ignorati.
+void LoadGenerator::firePresses() {
+    struct PlannedSend {
+        uint32_t at;
+        uint32_t base;              // Partenza della prima copia dello stesso slave
+        uint8_t id;
+        uint8_t copy;
+    };
+    static PlannedSend plan[LOADGEN_MAX_VIRTUAL * PRESS_MAX_COPIES];
+    static uint32_t planIds[LOADGEN_MAX_VIRTUAL];
+
+    startHeard = false;
+    uint8_t offset = roundsSeen % virtualCount;
+    uint16_t planned = 0;
+
+    // Calendario ordinato per istante di partenza (inserimento: al più qualche centinaio di voci)
+    for (uint8_t k = 0; k < virtualCount; k++) {
+        uint8_t id = (offset + k) % virtualCount;
+        planIds[id] = esp_random() | 1;
+        for (uint8_t c = 0; c < pressCopies; c++) {
+            PlannedSend p;
+            p.base = k * spreadUs;
+            p.at = p.base;
+            if (c > 0) {
+                uint32_t slice = PRESS_JITTER_US / (pressCopies - 1);
+                p.at += (c - 1) * slice + esp_random() % slice;
+            }
+            p.id = id;
+            p.copy = c;
+            uint16_t i = planned++;
+            while (i > 0 && plan[i - 1].at > p.at) {
+                plan[i] = plan[i - 1];
+                i--;
+            }
+            plan[i] = p;
+        }
+    }
+
+    uint8_t first = 0xFF;
+    firstPressAt = micros();
+    for (uint16_t i = 0; i < planned; i++) {
+        const PlannedSend& p = plan[i];
+        while (micros() - firstPressAt < p.at) {
+        }
+
+        // Raffica alla velocità della radio: si aspetta posto in coda invece di scartare
+        uint32_t waitStart = micros();
+        while (!espNow.hasTxRoom(TX_PRIO_CRITICAL) && micros() - waitStart < 5000) {
+            espNow.update();
+        }
+
+        uint32_t delayUs = p.copy > 0 ? micros() - firstPressAt - p.base : 0;
+        if (!sendAs(MSG_BUTTON_PRESSED, p.id, TX_PRIO_CRITICAL, delayUs / 10 > 255 ? 255 : delayUs / 10, planIds[p.id])) {
+            continue;
+        }
+        stats.sent++;
+        if (p.id < MAX_SLAVES && first == 0xFF) {
+            first = p.id;
+            portENTER_CRITICAL(&mux);
+            expectedWinner = p.id;
+            awaitingWinner = true;
+            portEXIT_CRITICAL(&mux);
+        }
+    }
+}
+
+void LoadGenerator::finishScenario() {
+    uint32_t seconds = (millis() - scenarioStart + 500) / 1000;
+    Scenario finished = scenario;
+    scenario = LOAD_IDLE;
+
+    if (finished == LOAD_CONNECT) {
+        stats.expected = min((int)virtualCount, MAX_SLAVES);
+    } else if (finished == LOAD_HEARTBEAT) {
+        stats.expected = (uint32_t)seconds * 1000 / MASTER_HEARTBEAT_INTERVAL_MS;
+    }
+    printResult(scenarioName(finished), seconds);
+}
+
+void LoadGenerator::printResult(const char* name, uint32_t seconds) {
+    LoadStats s;
+    portENTER_CRITICAL(&mux);
+    s = stats;
+    portEXIT_CRITICAL(&mux);
+
+    Serial.printf("load,%s,%lu,%u,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu\n", name, (unsigned long)seconds,
+                  virtualCount, (unsigned long)s.sent, (unsigned long)s.localDrops,
+                  (unsigned long)s.responses, (unsigned long)s.expected, (unsigned long)s.errors,
+                  (unsigned long)(s.baselineCount > 0 ? s.baselineSumUs / s.baselineCount : 0),
+                  (unsigned long)(s.probeCount > 0 ? s.probeSumUs / s.probeCount : 0),
+                  (unsigned long)s.probeMaxUs, (unsigned long)s.probesLost);
+}
+
+// ==================== MASTER SIMULATO ====================
+
+// Master sulla scheda stessa, frame consegnati da ESPNowManager::injectFrame: tempesta di
+// connessioni, poi per ogni round heartbeat di tutti e pressioni di tutti. Le colonne della
+// sonda sono il costo di un frame (minimo, medio, massimo); errori = vincitori sbagliati e
+// roster diverso da MAX_SLAVES (gli ID in eccesso vanno rifiutati).
+void LoadGenerator::runLocal(uint8_t count, uint16_t rounds) {
+    Log.info("Load: local master, %d virtual slaves, %u rounds", count, rounds);
+    Log.begin(nullStream, LOG_INFO);
+
+    if (localMaster == nullptr) {
+        localMaster = new GameManager(leds, espNow, scratchStore, ROLE_MASTER, 0);
+        localMaster->begin();
+    }
+    espNow.setMessageCallback(forwardToLocal);
+    espNow.setNodeId(NODE_MASTER);
+
+    memset(&stats, 0, sizeof(stats));
+    uint32_t minUs = UINT32_MAX;
+    static uint16_t originSeq[LOADGEN_MAX_VIRTUAL];    // Tra un'esecuzione e l'altra: cache duplicati
+    uint8_t raw[sizeof(Message)];
+    uint8_t mac[6] = {0x02, 0x4C, 0x4F, 0x41, 0x44, 0x00};  // Locali, uno per slave virtuale
+    GameCheckpoint cp;
+
+    auto inject = [&](uint8_t type, uint8_t id) {
+        Message msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.type = type;
+        msg.slaveId = id;
+        msg.epoch = cp.epoch;
+        msg.round = cp.round;
+        msg.origin = id;
+        msg.dest = NODE_MASTER;
+        msg.originSeq = ++originSeq[id];
+        msg.originNonce = 0x4C4F4100 | id;  // Un nodo per slave virtuale
+        msg.seq = (uint8_t)msg.originSeq;
+        msg.flags = FRAME_FLAG_BROADCAST;
+        memcpy(raw, &msg, sizeof(msg));
+        mac[5] = id;
+
+        uint32_t start = micros();
+        ESPNowManager::injectFrame(mac, raw, sizeof(raw));
+        uint32_t elapsed = micros() - start;
+
+        stats.sent++;
+        stats.probeCount++;
+        stats.probeSumUs += elapsed;
+        if (elapsed > stats.probeMaxUs) stats.probeMaxUs = elapsed;
+        if (elapsed < minUs) minUs = elapsed;
+    };
+
+    // Attende che lo stato del master simulato arrivi a target (start programmato, finestre)
+    auto waitState = [&](uint8_t target, uint32_t timeoutMs) {
+        unsigned long start = millis();
+        localMaster->captureCheckpoint(cp);
+        while (cp.state != target && millis() - start < timeoutMs) {
+            localMaster->update();
+            espNow.update();
+            delay(1);
+            localMaster->captureCheckpoint(cp);
+        }
+        return cp.state == target;
+    };
+
+    unsigned long runStart = millis();
+    localMaster->captureCheckpoint(cp);
+    for (uint8_t id = 0; id < count; id++) {
+        inject(MSG_CONNECT_REQUEST, id);
+    }
+    localMaster->update();
+    localMaster->captureCheckpoint(cp);
+    if (cp.rosterCount != MAX_SLAVES) stats.errors++;
+
+    for (uint16_t r = 0; r < rounds; r++) {
+        for (uint8_t id = 0; id < count; id++) {
+            inject(MSG_HEARTBEAT, id);
+        }
+
+        // Fine round precedente: il pulsante del master torna a READY, poi avvia
+        if (cp.state == STATE_WINNER_ANNOUNCED) {
+            delay(BUTTON_DEBOUNCE_MS + 1);
+            localMaster->handleButtonPress();
+        }
+        if (!waitState(STATE_READY, 1000)) {
+            stats.errors++;
+            break;
+        }
+        delay(BUTTON_DEBOUNCE_MS + 1);
+        localMaster->handleButtonPress();
+        if (!waitState(STATE_GAME_RUNNING, 2000)) {
+            stats.errors++;
+            break;
+        }
+        stats.expected++;
+
+        uint8_t offset = r % count;
+        uint8_t expected = 0xFF;
+        for (uint8_t k = 0; k < count; k++) {
+            uint8_t id = (offset + k) % count;
+            if (id < MAX_SLAVES && expected == 0xFF) expected = id;
+            inject(MSG_BUTTON_PRESSED, id);
+        }
+
+        // Con i ripetitori il vincitore arriva a fine finestra di arbitraggio
+        if (waitState(STATE_WINNER_ANNOUNCED, 200)) {
+            stats.responses++;
+            if (cp.winner != expected) stats.errors++;
+        } else {
+            stats.errors++;
+        }
+    }
+    uint32_t seconds = (millis() - runStart + 500) / 1000;
+
+    Log.begin(Serial, LOG_INFO);
+    espNow.setNodeId(NODE_LISTENER);
+    espNow.setMessageCallback(onMessage);
+
+    // Riposo = costo minimo di un frame
+    stats.baselineSumUs = stats.probeCount > 0 ? minUs : 0;
+    stats.baselineCount = 1;
+    virtualCount = count;
+    printResult("local", seconds);
+}
+
+const char* LoadGenerator::scenarioName(Scenario s) {
+    switch (s) {
+        case LOAD_CONNECT:   return "connect";
+        case LOAD_HEARTBEAT: return "hb";
+        case LOAD_PRESS:     return "press";
+        default:             return "idle";
+    }
+}
+
+void LoadGenerator::poll(Stream& serial) {
+    while (serial.available() > 0) {
+        int c = serial.read();
+        if (c == '\r') continue;
+        if (c != '\n') {
+            if (lineLen < sizeof(line) - 1) line[lineLen++] = c;
+            continue;
+        }
+        line[lineLen] = '\0';
+        lineLen = 0;
+        if (line[0] == '\0') continue;
+
+        int count = 0, a = 0, b = 0, c3 = 0;
+        if (strcmp(line, "load") == 0) {
+            Log.info("Load: %s, master epoch %u", scenarioName(scenario), masterEpoch);
+        } else if (strcmp(line, "load stop") == 0) {
+            if (scenario != LOAD_IDLE) finishScenario();
+        } else if (scenario != LOAD_IDLE) {
+            Log.warn("Load: scenario running, 'load stop' first");
+        } else if (sscanf(line, "load connect %d %d", &count, &a) == 2) {
+            if (count < 1 || count > LOADGEN_MAX_VIRTUAL || a < 1) {
+                Log.warn("Usage: load connect <1-%d> <seconds>", LOADGEN_MAX_VIRTUAL);
+                continue;
+            }
+            virtualCount = count;
+            startScenario(LOAD_CONNECT, a);
+        } else if (sscanf(line, "load hb %d %d %d %d", &count, &a, &b, &c3) >= 3) {
+            if (c3 == 0) c3 = 1;
+            if (count < 1 || count > LOADGEN_MAX_VIRTUAL || a < 1 || b < 1 || c3 < 1 || c3 > count) {
+                Log.warn("Usage: load hb <1-%d> <hz> <seconds> [burst <= slaves]", LOADGEN_MAX_VIRTUAL);
+                continue;
+            }
+            virtualCount = count;
+            rateHz = a;
+            burst = c3;
+            startScenario(LOAD_HEARTBEAT, b);
+        } else if (sscanf(line, "load press %d %d %d %d", &count, &a, &b, &c3) >= 3) {
+            if (c3 == 0) c3 = PRESS_COPIES;
+            if (count < 1 || count > LOADGEN_MAX_VIRTUAL || a < 0 || b < 1 ||
+                c3 > PRESS_MAX_COPIES || (c3 > 1 && PRESS_JITTER_US < c3 - 1)) {
+                Log.warn("Usage: load press <1-%d> <spread_us> <rounds> [copies 1-%d]",
+                         LOADGEN_MAX_VIRTUAL, PRESS_MAX_COPIES);
+                continue;
+            }
+            virtualCount = count;
+            spreadUs = a;
+            roundsWanted = b;
+            pressCopies = c3;
+            startScenario(LOAD_PRESS, 0);
+            Log.info("Load: start rounds with the master button");
+        } else if (sscanf(line, "load local %d %d", &count, &a) == 2) {
+            if (count < MAX_SLAVES || count > LOADGEN_MAX_VIRTUAL || a < 1) {
+                Log.warn("Usage: load local <%d-%d> <rounds>", MAX_SLAVES, LOADGEN_MAX_VIRTUAL);
+                continue;
+            }
+            runLocal(count, a);
+        } else {
+            Log.warn("Unknown command: %s", line);
+        }
+    }
+}
+
+#endif // LOADGEN_MODE
@@ -0,0 +1,126 @@
+#ifndef LOAD_GENERATOR_H
+#define LOAD_GENERATOR_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "LEDController.h"
+#include "ESPNowManager.h"
+
+// Generatore di carico (env loadgen): una scheda impersona fino a LOADGEN_MAX_VIRTUAL
+// slave virtuali (ID falsificato nel payload, stesso MAC) contro un master vero.
+// Durante ogni scenario una sonda SYNC_REQUEST -> SYNC_REPLY misura la latenza di
+// elaborazione del master, confrontata con quella a riposo; le risposte del master
+// (ACK, roster negli heartbeat, vincitori) ne verificano la correttezza. Gli ID oltre
+// MAX_SLAVES devono essere rifiutati. Risultato in righe CSV:
+//   load,<scenario>,<secondi>,<virtuali>,<inviati>,<scartati_qui>,<risposte>,<attese>,<errori>,
+//        <sonda_riposo_us>,<sonda_media_us>,<sonda_max_us>,<sonde_perse>
+// Scenari: tempesta di connessioni (come dopo un blackout), raffica di heartbeat con
+// ritmo e raffiche configurabili, pressioni simultanee ad ogni start del master.
+// "load local" usa invece un master simulato sulla scheda stessa: i frame passano per
+// ESPNowManager::injectFrame e si misura direttamente il costo di onDataRecv -> handleMessage.
+class LoadGenerator {
+public:
+    LoadGenerator(LEDController& leds, ESPNowManager& espNow);
+
+    void begin();
+    void update();                  // Dal loop: invii a ritmo, sonde, fine scenario
+    void handleMessage(const Message& msg, const uint8_t* macAddr);     // Callback ESP-NOW
+
+    // "load connect <virtuali> <secondi>", "load hb <virtuali> <hz> <secondi> [raffica]",
+    // "load press <virtuali> <distanza_us> <round> [copie]", "load local <virtuali> <round>",
+    // "load stop", "load" (stato)
+    void poll(Stream& serial);
+
+private:
+    enum Scenario : uint8_t {
+        LOAD_IDLE,
+        LOAD_CONNECT,
+        LOAD_HEARTBEAT,
+        LOAD_PRESS
+    };
+
+    enum Phase : uint8_t {
+        PHASE_BASELINE,             // Solo sonde: latenza del master a riposo
+        PHASE_LOAD
+    };
+
+    struct LoadStats {
+        uint32_t sent;
+        uint32_t localDrops;        // Coda di invio locale piena: limite del generatore, non del master
+        uint32_t responses;
+        uint32_t expected;
+        uint32_t errors;
+        uint32_t probesSent;
+        uint32_t probesLost;
+        uint32_t probeCount;
+        uint32_t probeSumUs;
+        uint32_t probeMaxUs;
+        uint32_t baselineSumUs;
+        uint32_t baselineCount;
+    };
+
+    LEDController& leds;
+    ESPNowManager& espNow;
+    portMUX_TYPE mux;
+
+    volatile Scenario scenario;
+    Phase phase;
+    uint8_t virtualCount;
+    uint32_t rateHz;                // Heartbeat per slave virtuale al secondo
+    uint8_t burst;                  // Frame consecutivi per occasione di invio
+    uint32_t spreadUs;              // Pressioni: distanza tra uno slave e il successivo
+    uint8_t pressCopies;            // Copie ridondanti per pressione (PRESS_COPIES di default)
+    uint16_t roundsWanted;
+    unsigned long scenarioStart;
+    uint32_t durationMs;
+    uint32_t loadStartUs;
+    uint8_t nextVirtual;
+    uint32_t ticksDone;             // Connessione: giri di ritentativi, heartbeat: occasioni di invio
+    uint32_t firstPressAt;
+    unsigned long lastReport;
+
+    // Scritti anche dalla callback (task WiFi) sotto mux
+    LoadStats stats;
+    uint64_t ackedMask;             // Connessione: ID che hanno ricevuto l'ACK
+    uint8_t lastRoster;             // Heartbeat: roster dell'ultimo heartbeat del master
+    bool hasRoster;
+    volatile bool startHeard;
+    volatile uint32_t startHeardAt;
+    volatile uint32_t pressDelayUs;
+    volatile uint8_t expectedWinner;    // Primo ID valido partito, 0xFF = nessuno
+    volatile bool awaitingWinner;
+    volatile bool roundDone;
+    uint8_t lastWinner;
+    uint32_t winnerAt;
+    uint16_t roundsSeen;
+
+    // Master sentito: epoca da mettere nei frame degli slave virtuali
+    uint16_t masterEpoch;
+    uint16_t lastStartRound;
+
+    // Sonda di latenza (una in volo alla volta)
+    uint8_t probeSeq;
+    volatile bool probeInFlight;
+    uint32_t probeSentAt;
+
+    char line[64];
+    uint8_t lineLen;
+
+    void startScenario(Scenario next, uint32_t seconds);
+    void finishScenario();
+    bool sendAs(uint8_t type, uint8_t virtualId, TxPriority prio, uint8_t data = 0, uint32_t value = 0);
+    void sendProbe();
+    void updateConnect(uint32_t elapsedUs);
+    void updateHeartbeat(uint32_t elapsedUs);
+    void firePresses();
+    void printResult(const char* name, uint32_t seconds);
+
+    // Master simulato sulla scheda
+    void runLocal(uint8_t count, uint16_t rounds);
+
+    static LoadGenerator* instance;
+    static void onMessage(const Message& msg, const uint8_t* macAddr);
+    static const char* scenarioName(Scenario s);
+};
+
+#endif // LOAD_GENERATOR_H
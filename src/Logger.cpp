@@ -1,4 +1,5 @@
 #include "Logger.h"
+#include "Profiler.h"
 
 Logger Log;
 
@@ -41,6 +42,7 @@ void Logger::error(const char* fmt, ...) {
 
 void Logger::log(LogLevel level, const char* fmt, va_list args) {
     if (!_output || level < _minLevel) return;
+    PROFILE_SCOPE(PROF_LOG);
 
     const char* color;
     const char* prefix;
@@ -16,6 +16,7 @@ class Logger {
 public:
     void begin(Stream& output, LogLevel minLevel = LOG_DEBUG);
     void setLevel(LogLevel level);
+    bool isEnabled(LogLevel level) const { return _output != nullptr && level >= _minLevel; }
 
     void debug(const char* fmt, ...);
     void info(const char* fmt, ...);
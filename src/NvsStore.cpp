@@ -0,0 +1,232 @@
+#include "NvsStore.h"
+#include "Logger.h"
+
+bool NvsStore::loadRoster(PersistedRoster& roster) {
+    memset(&roster, 0, sizeof(roster));
+
+    if (!prefs.begin(nsName, true)) {
+        return false;
+    }
+    size_t len = prefs.getBytes("roster", &roster, sizeof(roster));
+    prefs.end();
+
+    if (len != sizeof(roster) || roster.count > MAX_SLAVES) {
+        memset(&roster, 0, sizeof(roster));
+        return false;
+    }
+    return true;
+}
+
+void NvsStore::saveRoster(const PersistedRoster& roster) {
+    if (!prefs.begin(nsName, false)) {
+        Log.error("NVS open failed");
+        return;
+    }
+    prefs.putBytes("roster", &roster, sizeof(roster));
+    prefs.end();
+}
+
+bool NvsStore::loadMasterInfo(uint8_t* macAddr, uint16_t& epoch) {
+    if (!prefs.begin(nsName, true)) {
+        return false;
+    }
+    size_t len = prefs.getBytes("masterMac", macAddr, 6);
+    epoch = prefs.getUShort("masterEpoch", 0);
+    prefs.end();
+
+    return len == 6;
+}
+
+void NvsStore::saveMasterInfo(const uint8_t* macAddr, uint16_t epoch) {
+    if (!prefs.begin(nsName, false)) {
+        Log.error("NVS open failed");
+        return;
+    }
+    prefs.putBytes("masterMac", macAddr, 6);
+    prefs.putUShort("masterEpoch", epoch);
+    prefs.end();
+}
+
+bool NvsStore::loadIdentity(DeviceRole& role, uint8_t& slaveId) {
+    if (!prefs.begin(nsName, true)) {
+        return false;
+    }
+    bool found = prefs.isKey("role");
+    uint8_t storedRole = prefs.getUChar("role", ROLE_SLAVE);
+    slaveId = prefs.getUChar("slaveId", 0);
+    prefs.end();
+
+    if (!found || storedRole > ROLE_HUB || slaveId >= MAX_SLAVES) {
+        return false;
+    }
+    role = (DeviceRole)storedRole;
+    return true;
+}
+
+void NvsStore::saveIdentity(DeviceRole role, uint8_t slaveId) {
+    if (!prefs.begin(nsName, false)) {
+        Log.error("NVS open failed");
+        return;
+    }
+    prefs.putUChar("role", role);
+    prefs.putUChar("slaveId", slaveId);
+    prefs.end();
+}
+
+void NvsStore::clearIdentity() {
+    if (!prefs.begin(nsName, false)) {
+        Log.error("NVS open failed");
+        return;
+    }
+    prefs.remove("role");
+    prefs.remove("slaveId");
+    prefs.end();
+}
+
+uint8_t NvsStore::loadArenaId() {
+    if (!prefs.begin(nsName, true)) {
+        return 0;
+    }
+    uint8_t arenaId = prefs.getUChar("arena", 0);
+    prefs.end();
+    return arenaId;
+}
+
+void NvsStore::saveArenaId(uint8_t arenaId) {
+    if (!prefs.begin(nsName, false)) {
+        Log.error("NVS open failed");
+        return;
+    }
+    prefs.putUChar("arena", arenaId);
+    prefs.end();
+}
+
+bool NvsStore::loadOtaProgress(OtaProgress& progress) {
+    memset(&progress, 0, sizeof(progress));
+
+    if (!prefs.begin(nsName, true)) {
+        return false;
+    }
+    size_t len = prefs.getBytes("otaProgress", &progress, sizeof(progress));
+    prefs.end();
+
+    if (len != sizeof(progress)) {
+        memset(&progress, 0, sizeof(progress));
+        return false;
+    }
+    return true;
+}
+
+void NvsStore::saveOtaProgress(const OtaProgress& progress) {
+    if (!prefs.begin(nsName, false)) {
+        Log.error("NVS open failed");
+        return;
+    }
+    prefs.putBytes("otaProgress", &progress, sizeof(progress));
+    prefs.end();
+}
+
+void NvsStore::clearOtaProgress() {
+    if (!prefs.begin(nsName, false)) {
+        Log.error("NVS open failed");
+        return;
+    }
+    prefs.remove("otaProgress");
+    prefs.end();
+}
+
+uint32_t NvsStore::loadOtaApplied() {
+    if (!prefs.begin(nsName, true)) {
+        return 0;
+    }
+    uint32_t imageId = prefs.getULong("otaApplied", 0);
+    prefs.end();
+    return imageId;
+}
+
+void NvsStore::saveOtaApplied(uint32_t imageId) {
+    if (!prefs.begin(nsName, false)) {
+        Log.error("NVS open failed");
+        return;
+    }
+    prefs.putULong("otaApplied", imageId);
+    prefs.end();
+}
+
+bool NvsStore::loadOtaSource(OtaSource& source) {
+    memset(&source, 0, sizeof(source));
+
+    if (!prefs.begin(nsName, true)) {
+        return false;
+    }
+    size_t len = prefs.getBytes("otaSource", &source, sizeof(source));
+    prefs.end();
+
+    if (len != sizeof(source) || source.size == 0) {
+        memset(&source, 0, sizeof(source));
+        return false;
+    }
+    return true;
+}
+
+void NvsStore::saveOtaSource(const OtaSource& source) {
+    if (!prefs.begin(nsName, false)) {
+        Log.error("NVS open failed");
+        return;
+    }
+    prefs.putBytes("otaSource", &source, sizeof(source));
+    prefs.end();
+}
+
+uint8_t NvsStore::loadPattern(uint8_t slot, uint8_t* code) {
+    char key[8];
+    snprintf(key, sizeof(key), "pat%d", slot);
+
+    if (!prefs.begin(nsName, true)) {
+        return 0;
+    }
+    size_t len = prefs.getBytes(key, code, PATTERN_MAX_LEN);
+    prefs.end();
+    return (uint8_t)len;
+}
+
+void NvsStore::savePattern(uint8_t slot, const uint8_t* code, uint8_t len) {
+    char key[8];
+    snprintf(key, sizeof(key), "pat%d", slot);
+
+    if (!prefs.begin(nsName, false)) {
+        Log.error("NVS open failed");
+        return;
+    }
+    if (len == 0) {
+        prefs.remove(key);
+    } else {
+        prefs.putBytes(key, code, len);
+    }
+    prefs.end();
+}
+
+bool NvsStore::loadBenchBaseline(BenchBaseline& baseline) {
+    memset(&baseline, 0, sizeof(baseline));
+
+    if (!prefs.begin(nsName, true)) {
+        return false;
+    }
+    size_t len = prefs.getBytes("benchBase", &baseline, sizeof(baseline));
+    prefs.end();
+
+    if (len != sizeof(baseline) || baseline.count == 0 || baseline.count > BENCH_MAX_RESULTS) {
+        memset(&baseline, 0, sizeof(baseline));
+        return false;
+    }
+    return true;
+}
+
+void NvsStore::saveBenchBaseline(const BenchBaseline& baseline) {
+    if (!prefs.begin(nsName, false)) {
+        Log.error("NVS open failed");
+        return;
+    }
+    prefs.putBytes("benchBase", &baseline, sizeof(baseline));
+    prefs.end();
+}
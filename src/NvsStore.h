@@ -0,0 +1,84 @@
+#ifndef NVS_STORE_H
+#define NVS_STORE_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include "config.h"
+
+// Roster del master salvato in NVS (sopravvive a riavvii e brownout)
+struct PersistedRoster {
+    uint16_t epoch;                  // Epoca di sessione dell'ultimo avvio
+    uint8_t count;                   // Slave presenti nel roster
+    uint8_t ids[MAX_SLAVES];         // ID slave
+    uint8_t macs[MAX_SLAVES][6];     // MAC slave (per ri-aggiungere i peer)
+};
+
+// Slave: trasferimento OTA in corso (per riprendere dopo un riavvio o un'interruzione)
+struct OtaProgress {
+    uint32_t imageId;
+    uint32_t size;
+    uint16_t nextWindow;             // Finestre già scritte in flash
+    uint32_t erasedUpTo;             // Byte della partizione già cancellati
+};
+
+// Master: immagine ricevuta via USB nella partizione OTA libera
+struct OtaSource {
+    uint32_t size;
+    uint8_t sha256[32];
+};
+
+// Benchmark: risultati salvati come riferimento (hash del nome, ns per operazione)
+struct BenchBaseline {
+    uint8_t count;
+    uint32_t nameHash[BENCH_MAX_RESULTS];
+    uint32_t nsPerOp[BENCH_MAX_RESULTS];
+};
+
+// Persistenza su NVS (flash) di identità, roster master, MAC master lato slave e stato OTA
+class NvsStore {
+public:
+    // Namespace diverso per dati di prova che non devono toccare quelli di gioco
+    explicit NvsStore(const char* nsName = NAMESPACE) : nsName(nsName) {}
+
+    // Master: roster + epoca
+    bool loadRoster(PersistedRoster& roster);
+    void saveRoster(const PersistedRoster& roster);
+
+    // Slave: MAC ed epoca dell'ultimo master a cui si è agganciato
+    bool loadMasterInfo(uint8_t* macAddr, uint16_t& epoch);
+    void saveMasterInfo(const uint8_t* macAddr, uint16_t epoch);
+
+    // Ruolo e ID della scheda (associazione)
+    bool loadIdentity(DeviceRole& role, uint8_t& slaveId);
+    void saveIdentity(DeviceRole role, uint8_t slaveId);
+    void clearIdentity();
+
+    // Master: ID dell'arena (tavolo) riportato negli heartbeat per l'hub, 0 = non assegnato
+    uint8_t loadArenaId();
+    void saveArenaId(uint8_t arenaId);
+
+    // OTA: progresso e ultima immagine applicata (slave), immagine da distribuire (master)
+    bool loadOtaProgress(OtaProgress& progress);
+    void saveOtaProgress(const OtaProgress& progress);
+    void clearOtaProgress();
+    uint32_t loadOtaApplied();
+    void saveOtaApplied(uint32_t imageId);
+    bool loadOtaSource(OtaSource& source);
+    void saveOtaSource(const OtaSource& source);
+
+    // Master: pattern LED installati, uno per slot (0 = nessuno)
+    uint8_t loadPattern(uint8_t slot, uint8_t* code);
+    void savePattern(uint8_t slot, const uint8_t* code, uint8_t len);
+
+    // Benchmark: baseline per il confronto tra build
+    bool loadBenchBaseline(BenchBaseline& baseline);
+    void saveBenchBaseline(const BenchBaseline& baseline);
+
+private:
+    static constexpr const char* NAMESPACE = "prenoto";
+
+    Preferences prefs;
+    const char* nsName;
+};
+
+#endif // NVS_STORE_H
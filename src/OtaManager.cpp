@@ -0,0 +1,775 @@
+#include "OtaManager.h"
+#include "Logger.h"
+#include "PowerManager.h"
+#include "GameManager.h"
+#include <esp_ota_ops.h>
+#include <mbedtls/sha256.h>
+
+OtaManager::OtaManager(ESPNowManager& espNow, NvsStore& nvs, DeviceRole role, uint8_t slaveId)
+    : espNow(espNow), nvs(nvs), game(nullptr), slaveId(slaveId) {
+    isMaster = (role == ROLE_MASTER);
+    enabled = (role != ROLE_LISTENER);
+    gameIdle = true;
+
+    phase = OTA_IDLE;
+    mux = portMUX_INITIALIZER_UNLOCKED;
+    phaseStart = 0;
+    lastActivity = 0;
+    lastSendAt = 0;
+
+    partition = nullptr;
+    imageId = 0;
+    imageSize = 0;
+    memset(imageSha, 0, sizeof(imageSha));
+    chunkCount = 0;
+    windowCount = 0;
+    currentWindow = 0;
+
+    joined = 0;
+    participants = 0;
+    reported = 0;
+    missing = 0;
+    startWindow = 0;
+    toSend = 0;
+    commitsSent = 0;
+    doneMask = 0;
+    failedMask = 0;
+    uploadReceived = 0;
+    transferStart = 0;
+    chunksSent = 0;
+    chunksRepaired = 0;
+    nackRounds = 0;
+
+    received = 0;
+    erasedUpTo = 0;
+    offerPending = false;
+    windowEndPending = -1;
+    commitPending = false;
+
+    for (uint8_t i = 0; i < MAX_SLAVES; i++) {
+        silentRounds[i] = 0;
+    }
+}
+
+void OtaManager::update(bool gameIdle) {
+    this->gameIdle = gameIdle;
+    if (!enabled) return;
+
+    if (isMaster) {
+        updateMaster();
+    } else {
+        updateSlave();
+    }
+}
+
+// Chiamata dalla callback di ricezione ESP-NOW: lo slave copia solo i blocchi,
+// scritture in flash e risposte avvengono in update()
+void OtaManager::handleFrame(const uint8_t* data, int len, const uint8_t* macAddr) {
+    if (!enabled) return;
+
+    if (isMaster) {
+        handleMasterFrame(data, len, macAddr);
+    } else if (game != nullptr && game->isFromMaster(macAddr)) {
+        // Frame OTA a un salto: il mittente è il master stesso
+        handleSlaveFrame(data, len);
+    }
+}
+
+// Blocchi presenti nella finestra (l'ultima può essere parziale)
+uint32_t OtaManager::windowMask(uint16_t window) const {
+    uint32_t first = (uint32_t)window * OTA_WINDOW_CHUNKS;
+    if (first >= chunkCount) return 0;
+
+    uint32_t count = chunkCount - first;
+    if (count >= OTA_WINDOW_CHUNKS) return 0xFFFFFFFF;
+    return (1UL << count) - 1;
+}
+
+// SHA-256 dei primi size byte della partizione (usa windowBuf come buffer)
+bool OtaManager::hashPartition(const esp_partition_t* part, uint32_t size, uint8_t* sha) {
+    mbedtls_sha256_context ctx;
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_starts_ret(&ctx, 0);
+
+    bool ok = true;
+    for (uint32_t offset = 0; offset < size && ok; offset += sizeof(windowBuf)) {
+        uint32_t len = size - offset;
+        if (len > sizeof(windowBuf)) len = sizeof(windowBuf);
+
+        ok = esp_partition_read(part, offset, windowBuf, len) == ESP_OK;
+        if (ok) {
+            mbedtls_sha256_update_ret(&ctx, windowBuf, len);
+        }
+    }
+
+    mbedtls_sha256_finish_ret(&ctx, sha);
+    mbedtls_sha256_free(&ctx);
+    return ok;
+}
+
+// ==================== MASTER ====================
+
+bool OtaManager::handleCommand(const char* line) {
+    if (!isMaster) return false;
+
+    if (strcmp(line, "ota push") == 0) {
+        pushStoredImage();
+    } else if (strcmp(line, "ota push self") == 0) {
+        pushRunningImage();
+    } else if (strncmp(line, "ota upload ", 11) == 0) {
+        beginUpload(strtoul(line + 11, nullptr, 10));
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool OtaManager::pushRunningImage() {
+    if (!isMaster) return false;
+    return startPush(esp_ota_get_running_partition(), ESP.getSketchSize(), nullptr);
+}
+
+bool OtaManager::pushStoredImage() {
+    if (!isMaster) return false;
+
+    OtaSource source;
+    if (!nvs.loadOtaSource(source)) {
+        Log.warn("OTA: no uploaded image, use 'ota upload <bytes>' first");
+        return false;
+    }
+    return startPush(esp_ota_get_next_update_partition(nullptr), source.size, source.sha256);
+}
+
+// Prepara la partizione OTA libera del master; i byte seguono subito il comando
+bool OtaManager::beginUpload(uint32_t size) {
+    if (phase != OTA_IDLE || !gameIdle) {
+        Log.warn("OTA: busy, upload refused");
+        return false;
+    }
+
+    const esp_partition_t* dst = esp_ota_get_next_update_partition(nullptr);
+    if (dst == nullptr || size == 0 || size > dst->size) {
+        Log.error("OTA: invalid upload size %lu", (unsigned long)size);
+        return false;
+    }
+
+    uint32_t eraseLen = (size + SPI_FLASH_SEC_SIZE - 1) / SPI_FLASH_SEC_SIZE * SPI_FLASH_SEC_SIZE;
+    Log.info("OTA: erasing %lu bytes of %s...", (unsigned long)eraseLen, dst->label);
+    if (esp_partition_erase_range(dst, 0, eraseLen) != ESP_OK) {
+        Log.error("OTA: erase failed");
+        return false;
+    }
+
+    partition = dst;
+    imageSize = size;
+    uploadReceived = 0;
+    lastActivity = millis();
+    phase = OTA_USB_UPLOAD;
+    Log.info("OTA: ready, send %lu bytes", (unsigned long)size);
+    return true;
+}
+
+void OtaManager::receiveUpload(Stream& serial) {
+    if (phase != OTA_USB_UPLOAD) return;
+
+    while (uploadReceived < imageSize && serial.available() > 0) {
+        uint32_t want = imageSize - uploadReceived;
+        if (want > sizeof(windowBuf)) want = sizeof(windowBuf);
+        if (want > (uint32_t)serial.available()) want = serial.available();
+
+        size_t got = serial.readBytes(windowBuf, want);
+        if (esp_partition_write(partition, uploadReceived, windowBuf, got) != ESP_OK) {
+            Log.error("OTA: flash write failed at %lu", (unsigned long)uploadReceived);
+            phase = OTA_IDLE;
+            return;
+        }
+        uploadReceived += got;
+        lastActivity = millis();
+    }
+
+    if (uploadReceived >= imageSize) {
+        OtaSource source;
+        source.size = imageSize;
+        if (!hashPartition(partition, imageSize, source.sha256)) {
+            Log.error("OTA: read back failed");
+            phase = OTA_IDLE;
+            return;
+        }
+        nvs.saveOtaSource(source);
+        Log.info("OTA: upload complete (%lu bytes)", (unsigned long)imageSize);
+
+        phase = OTA_IDLE;
+        startPush(partition, imageSize, source.sha256);
+    } else if (millis() - lastActivity > OTA_SERIAL_TIMEOUT_MS) {
+        Log.error("OTA: upload timed out at %lu/%lu bytes",
+                  (unsigned long)uploadReceived, (unsigned long)imageSize);
+        phase = OTA_IDLE;
+    }
+}
+
+bool OtaManager::startPush(const esp_partition_t* source, uint32_t size, const uint8_t* sha) {
+    if (phase != OTA_IDLE || !gameIdle) {
+        Log.warn("OTA: busy, push refused");
+        return false;
+    }
+    if (source == nullptr || size == 0 || size > source->size) {
+        Log.error("OTA: no valid image to push");
+        return false;
+    }
+
+    partition = source;
+    imageSize = size;
+    if (sha != nullptr) {
+        memcpy(imageSha, sha, sizeof(imageSha));
+    } else if (!hashPartition(source, size, imageSha)) {
+        Log.error("OTA: image read failed");
+        return false;
+    }
+    imageId = ((uint32_t)imageSha[0] << 24) | ((uint32_t)imageSha[1] << 16) |
+              ((uint32_t)imageSha[2] << 8) | imageSha[3];
+    chunkCount = (size + OTA_CHUNK_SIZE - 1) / OTA_CHUNK_SIZE;
+    windowCount = (chunkCount + OTA_WINDOW_CHUNKS - 1) / OTA_WINDOW_CHUNKS;
+
+    portENTER_CRITICAL(&mux);
+    joined = 0;
+    participants = 0;
+    startWindow = windowCount;
+    doneMask = 0;
+    failedMask = 0;
+    portEXIT_CRITICAL(&mux);
+
+    for (uint8_t i = 0; i < MAX_SLAVES; i++) {
+        silentRounds[i] = 0;
+    }
+    chunksSent = 0;
+    chunksRepaired = 0;
+    nackRounds = 0;
+
+    lastSendAt = 0;
+    phaseStart = millis();
+    phase = OTA_OFFERING;
+
+    Log.info("OTA: offering image %08lX, %lu bytes, %u chunks in %u windows",
+             (unsigned long)imageId, (unsigned long)imageSize, chunkCount, windowCount);
+    return true;
+}
+
+void OtaManager::updateMaster() {
+    unsigned long now = millis();
+
+    switch (phase) {
+        case OTA_OFFERING:
+            // Offerta nelle finestre di ascolto: la sentono anche gli slave in light sleep
+            if (now - lastSendAt >= OTA_OFFER_INTERVAL_MS &&
+                (!POWER_SAVE || PowerManager::inSendWindow(micros()))) {
+                lastSendAt = now;
+                sendOffer();
+            }
+            if (now - phaseStart >= OTA_OFFER_WINDOW_MS) {
+                if (participants == 0) {
+                    Log.info("OTA: no slave needs image %08lX", (unsigned long)imageId);
+                    phase = OTA_IDLE;
+                    break;
+                }
+                Log.info("OTA: %d slaves joined, starting at window %u/%u",
+                         __builtin_popcount(participants), startWindow, windowCount);
+                transferStart = now;
+                currentWindow = startWindow;
+                beginWindow();
+            }
+            break;
+
+        case OTA_SENDING:
+            sendPendingChunks();
+            break;
+
+        case OTA_WAIT_NACKS:
+            checkNacks();
+            break;
+
+        case OTA_COMMITTING: {
+            uint8_t answered = (doneMask | failedMask) & participants;
+            bool repeatsOver = commitsSent >= OTA_COMMIT_REPEAT && now - lastSendAt >= OTA_OFFER_INTERVAL_MS;
+            if (answered == participants || repeatsOver) {
+                finishPush();
+            } else if (commitsSent < OTA_COMMIT_REPEAT && now - lastSendAt >= OTA_OFFER_INTERVAL_MS) {
+                lastSendAt = now;
+                commitsSent++;
+                OtaCommitFrame frame = {MSG_OTA_COMMIT, imageId};
+                espNow.sendRaw((const uint8_t*)&frame, sizeof(frame));
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+void OtaManager::handleMasterFrame(const uint8_t* data, int len, const uint8_t* macAddr) {
+    if (data[0] == MSG_OTA_STATUS && len >= (int)sizeof(OtaStatusFrame)) {
+        OtaStatusFrame frame;
+        memcpy(&frame, data, sizeof(frame));
+        if (frame.imageId != imageId || frame.slaveId >= MAX_SLAVES) return;
+        uint8_t bit = 1 << frame.slaveId;
+
+        // Dopo l'adesione contano solo i frame dello stesso MAC
+        portENTER_CRITICAL(&mux);
+        bool sameSlave = (joined & bit) && memcmp(joinedMacs[frame.slaveId], macAddr, 6) == 0;
+        bool newcomer = !(joined & bit) && phase == OTA_OFFERING;
+        if (newcomer && frame.status == OTA_STATUS_ACCEPT) {
+            memcpy(joinedMacs[frame.slaveId], macAddr, 6);
+        }
+        portEXIT_CRITICAL(&mux);
+        if (!sameSlave && !newcomer) return;
+
+        if (phase == OTA_OFFERING) {
+            switch (frame.status) {
+                case OTA_STATUS_ACCEPT:
+                    portENTER_CRITICAL(&mux);
+                    joined |= bit;
+                    participants |= bit;
+                    if (frame.nextWindow < startWindow) startWindow = frame.nextWindow;
+                    portEXIT_CRITICAL(&mux);
+                    break;
+                case OTA_STATUS_UP_TO_DATE:
+                    Log.debug("OTA: Slave %d already up to date", frame.slaveId);
+                    break;
+                case OTA_STATUS_BUSY:
+                    Log.warn("OTA: Slave %d busy", frame.slaveId);
+                    break;
+                default:
+                    Log.warn("OTA: Slave %d cannot receive the image", frame.slaveId);
+                    break;
+            }
+        } else if (phase == OTA_COMMITTING) {
+            portENTER_CRITICAL(&mux);
+            if (frame.status == OTA_STATUS_DONE) doneMask |= bit;
+            if (frame.status == OTA_STATUS_FAILED) failedMask |= bit;
+            portEXIT_CRITICAL(&mux);
+        }
+    } else if (data[0] == MSG_OTA_NACK && len >= (int)sizeof(OtaNackFrame)) {
+        OtaNackFrame frame;
+        memcpy(&frame, data, sizeof(frame));
+        if (frame.imageId != imageId || frame.slaveId >= MAX_SLAVES) return;
+        if (phase != OTA_WAIT_NACKS || frame.window != currentWindow) return;
+
+        uint8_t bit = 1 << frame.slaveId;
+        portENTER_CRITICAL(&mux);
+        if ((participants & bit) && memcmp(joinedMacs[frame.slaveId], macAddr, 6) == 0) {
+            reported |= bit;
+            missing |= frame.missing & windowMask(frame.window);
+        }
+        portEXIT_CRITICAL(&mux);
+    }
+}
+
+void OtaManager::beginWindow() {
+    if (currentWindow >= windowCount) {
+        Log.info("OTA: all windows delivered, committing");
+        commitsSent = 0;
+        lastSendAt = 0;
+        phase = OTA_COMMITTING;
+        return;
+    }
+
+    toSend = windowMask(currentWindow);
+    phase = OTA_SENDING;
+}
+
+// Riempie la coda bulk senza saturarla; la fine finestra segue i blocchi nella stessa coda
+void OtaManager::sendPendingChunks() {
+    while (toSend != 0 && espNow.hasTxRoom(TX_PRIO_BULK)) {
+        uint8_t bit = __builtin_ctz(toSend);
+        if (!sendChunk(currentWindow * OTA_WINDOW_CHUNKS + bit)) {
+            Log.error("OTA: image read failed, transfer aborted");
+            phase = OTA_IDLE;
+            return;
+        }
+        toSend &= ~(1UL << bit);
+    }
+
+    if (toSend != 0 || !espNow.hasTxRoom(TX_PRIO_BULK)) return;
+
+    portENTER_CRITICAL(&mux);
+    reported = 0;
+    missing = 0;
+    portEXIT_CRITICAL(&mux);
+
+    OtaWindowEndFrame frame = {MSG_OTA_WINDOW_END, imageId, currentWindow};
+    espNow.sendRaw((const uint8_t*)&frame, sizeof(frame));
+    phaseStart = millis();
+    phase = OTA_WAIT_NACKS;
+}
+
+bool OtaManager::sendChunk(uint16_t index) {
+    OtaChunkFrame frame;
+    uint32_t offset = (uint32_t)index * OTA_CHUNK_SIZE;
+    uint32_t len = imageSize - offset;
+    if (len > OTA_CHUNK_SIZE) len = OTA_CHUNK_SIZE;
+
+    if (esp_partition_read(partition, offset, frame.data, len) != ESP_OK) {
+        return false;
+    }
+    frame.type = MSG_OTA_CHUNK;
+    frame.imageId = imageId;
+    frame.index = index;
+    frame.len = len;
+
+    espNow.sendRaw((const uint8_t*)&frame, sizeof(frame) - OTA_CHUNK_SIZE + len);
+    chunksSent++;
+    return true;
+}
+
+// Tutti hanno risposto (o timeout): finestra successiva, oppure ripara i mancanti
+void OtaManager::checkNacks() {
+    portENTER_CRITICAL(&mux);
+    uint8_t rep = reported;
+    uint32_t miss = missing;
+    portEXIT_CRITICAL(&mux);
+
+    if ((rep & participants) != participants && millis() - phaseStart < OTA_NACK_TIMEOUT_MS) {
+        return;
+    }
+    nackRounds++;
+
+    for (uint8_t i = 0; i < MAX_SLAVES; i++) {
+        uint8_t bit = 1 << i;
+        if (!(participants & bit)) continue;
+
+        if (rep & bit) {
+            silentRounds[i] = 0;
+        } else if (++silentRounds[i] >= OTA_MAX_SILENT_ROUNDS) {
+            Log.warn("OTA: Slave %d not responding, dropped from transfer", i);
+            participants &= ~bit;
+        }
+    }
+
+    if (participants == 0) {
+        Log.error("OTA: no slave left, transfer aborted");
+        phase = OTA_IDLE;
+        return;
+    }
+
+    if ((rep & participants) == participants && miss == 0) {
+        currentWindow++;
+        beginWindow();
+        return;
+    }
+
+    // Solo i blocchi mancanti; se qualcuno non ha risposto si ripete almeno la fine finestra
+    toSend = miss;
+    chunksRepaired += __builtin_popcount(miss);
+    phase = OTA_SENDING;
+}
+
+void OtaManager::finishPush() {
+    unsigned long elapsed = millis() - transferStart;
+    unsigned long rate = elapsed > 0 ? (unsigned long)((uint64_t)imageSize * 1000 / elapsed) : 0;
+
+    Log.info("=== OTA image %08lX ===", (unsigned long)imageId);
+    Log.info("%lu bytes in %lu ms (%lu B/s)  chunks sent %lu  repaired %lu  NACK rounds %lu",
+             (unsigned long)imageSize, elapsed, rate, (unsigned long)chunksSent,
+             (unsigned long)chunksRepaired, (unsigned long)nackRounds);
+
+    for (uint8_t i = 0; i < MAX_SLAVES; i++) {
+        uint8_t bit = 1 << i;
+        if (!(joined & bit)) continue;
+
+        const char* result = (doneMask & bit) ? "updated" :
+                             (failedMask & bit) ? "FAILED" :
+                             (participants & bit) ? "no answer" : "dropped";
+        Log.info("Slave %d: %s", i, result);
+    }
+
+    phase = OTA_IDLE;
+}
+
+void OtaManager::sendOffer() {
+    OtaOfferFrame frame;
+    frame.type = MSG_OTA_OFFER;
+    frame.imageId = imageId;
+    frame.size = imageSize;
+    frame.chunkCount = chunkCount;
+    frame.chunkSize = OTA_CHUNK_SIZE;
+    frame.windowChunks = OTA_WINDOW_CHUNKS;
+    memcpy(frame.sha256, imageSha, sizeof(frame.sha256));
+    espNow.sendRaw((const uint8_t*)&frame, sizeof(frame));
+}
+
+// ==================== SLAVE ====================
+
+void OtaManager::handleSlaveFrame(const uint8_t* data, int len) {
+    switch (data[0]) {
+        case MSG_OTA_OFFER:
+            if (len < (int)sizeof(OtaOfferFrame)) return;
+            portENTER_CRITICAL(&mux);
+            memcpy(&pendingOffer, data, sizeof(pendingOffer));
+            offerPending = true;
+            portEXIT_CRITICAL(&mux);
+            break;
+
+        case MSG_OTA_CHUNK: {
+            const int header = sizeof(OtaChunkFrame) - OTA_CHUNK_SIZE;
+            if (len < header) return;
+
+            OtaChunkFrame frame;
+            memcpy(&frame, data, len > (int)sizeof(frame) ? sizeof(frame) : len);
+            if (phase != OTA_RECEIVING || frame.imageId != imageId) return;
+            if (len < header + frame.len || frame.index >= chunkCount) return;
+
+            uint32_t first = (uint32_t)currentWindow * OTA_WINDOW_CHUNKS;
+            if (frame.index < first || frame.index >= first + OTA_WINDOW_CHUNKS) return;
+
+            uint32_t expected = imageSize - (uint32_t)frame.index * OTA_CHUNK_SIZE;
+            if (expected > OTA_CHUNK_SIZE) expected = OTA_CHUNK_SIZE;
+            if (frame.len != expected) return;
+
+            uint8_t bit = frame.index - first;
+            memcpy(windowBuf + bit * OTA_CHUNK_SIZE, frame.data, frame.len);
+            portENTER_CRITICAL(&mux);
+            received |= 1UL << bit;
+            portEXIT_CRITICAL(&mux);
+            lastActivity = millis();
+            break;
+        }
+
+        case MSG_OTA_WINDOW_END: {
+            if (len < (int)sizeof(OtaWindowEndFrame)) return;
+            OtaWindowEndFrame frame;
+            memcpy(&frame, data, sizeof(frame));
+            if (phase != OTA_RECEIVING || frame.imageId != imageId) return;
+            windowEndPending = frame.window;
+            break;
+        }
+
+        case MSG_OTA_COMMIT: {
+            if (len < (int)sizeof(OtaCommitFrame)) return;
+            OtaCommitFrame frame;
+            memcpy(&frame, data, sizeof(frame));
+            if (frame.imageId != imageId) return;
+            commitPending = true;
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+void OtaManager::updateSlave() {
+    unsigned long now = millis();
+
+    portENTER_CRITICAL(&mux);
+    bool hasOffer = offerPending;
+    OtaOfferFrame offer = pendingOffer;
+    offerPending = false;
+    portEXIT_CRITICAL(&mux);
+
+    if (hasOffer) {
+        handleOffer(offer);
+    }
+
+    if (phase == OTA_RECEIVING) {
+        int32_t window = windowEndPending;
+        if (window >= 0) {
+            windowEndPending = -1;
+            handleWindowEnd(window);
+        }
+        if (commitPending) {
+            commitPending = false;
+            handleCommit();
+        } else if (phase == OTA_RECEIVING && now - lastActivity > OTA_IDLE_TIMEOUT_MS) {
+            // Il progresso resta in NVS: riprende alla prossima offerta della stessa immagine
+            Log.warn("OTA: transfer stalled at window %u/%u, suspended", currentWindow, windowCount);
+            phase = OTA_IDLE;
+        }
+    } else if (phase == OTA_RESTARTING) {
+        // Il master ripete il commit finché non riceve l'esito
+        if (commitPending) {
+            commitPending = false;
+            sendStatus(imageId, OTA_STATUS_DONE);
+        }
+        if (now - phaseStart >= OTA_RESTART_DELAY_MS) {
+            ESP.restart();
+        }
+    }
+}
+
+void OtaManager::handleOffer(const OtaOfferFrame& offer) {
+    if (phase == OTA_RESTARTING) return;
+
+    // Offerta ripetuta: conferma l'adesione (la prima risposta può essersi persa)
+    if (phase == OTA_RECEIVING && offer.imageId == imageId) {
+        lastActivity = millis();
+        sendStatus(imageId, OTA_STATUS_ACCEPT);
+        return;
+    }
+
+    if (nvs.loadOtaApplied() == offer.imageId) {
+        sendStatus(offer.imageId, OTA_STATUS_UP_TO_DATE);
+        return;
+    }
+    if (!gameIdle) {
+        sendStatus(offer.imageId, OTA_STATUS_BUSY);
+        return;
+    }
+
+    // chunkCount incoerente con size: l'ultimo blocco farebbe andare sotto zero imageSize - offset
+    const esp_partition_t* dst = esp_ota_get_next_update_partition(nullptr);
+    if (dst == nullptr || offer.size == 0 || offer.size > dst->size ||
+        offer.chunkCount != (offer.size + OTA_CHUNK_SIZE - 1) / OTA_CHUNK_SIZE ||
+        offer.chunkSize != OTA_CHUNK_SIZE || offer.windowChunks != OTA_WINDOW_CHUNKS) {
+        Log.error("OTA: cannot receive image %08lX (%lu bytes)",
+                  (unsigned long)offer.imageId, (unsigned long)offer.size);
+        sendStatus(offer.imageId, OTA_STATUS_FAILED);
+        return;
+    }
+
+    // Prima di entrare in ricezione, così la callback vede un'immagine coerente
+    partition = dst;
+    imageId = offer.imageId;
+    imageSize = offer.size;
+    memcpy(imageSha, offer.sha256, sizeof(imageSha));
+    chunkCount = offer.chunkCount;
+    windowCount = (chunkCount + OTA_WINDOW_CHUNKS - 1) / OTA_WINDOW_CHUNKS;
+
+    OtaProgress progress;
+    if (nvs.loadOtaProgress(progress) && progress.imageId == imageId && progress.size == imageSize) {
+        currentWindow = progress.nextWindow;
+        erasedUpTo = progress.erasedUpTo;
+        Log.info("OTA: resuming image %08lX at window %u/%u",
+                 (unsigned long)imageId, currentWindow, windowCount);
+    } else {
+        currentWindow = 0;
+        erasedUpTo = 0;
+        saveProgress();
+        Log.info("OTA: receiving image %08lX, %lu bytes into %s",
+                 (unsigned long)imageId, (unsigned long)imageSize, dst->label);
+    }
+
+    received = 0;
+    windowEndPending = -1;
+    commitPending = false;
+    lastActivity = millis();
+    phase = OTA_RECEIVING;
+
+    sendStatus(imageId, OTA_STATUS_ACCEPT);
+}
+
+void OtaManager::handleWindowEnd(uint16_t window) {
+    lastActivity = millis();
+
+    // Finestra già scritta: il nostro NACK vuoto si è perso
+    if (window < currentWindow) {
+        sendNack(window, 0);
+        return;
+    }
+    if (window > currentWindow) {
+        Log.warn("OTA: master moved past window %u, suspended", currentWindow);
+        phase = OTA_IDLE;
+        return;
+    }
+
+    portENTER_CRITICAL(&mux);
+    uint32_t have = received;
+    portEXIT_CRITICAL(&mux);
+
+    uint32_t missingMask = windowMask(window) & ~have;
+    if (missingMask == 0) {
+        if (!writeWindow(window)) {
+            Log.error("OTA: flash write failed at window %u", window);
+            nvs.clearOtaProgress();
+            sendStatus(imageId, OTA_STATUS_FAILED);
+            phase = OTA_IDLE;
+            return;
+        }
+
+        portENTER_CRITICAL(&mux);
+        currentWindow = window + 1;
+        received = 0;
+        portEXIT_CRITICAL(&mux);
+        saveProgress();
+    }
+
+    sendNack(window, missingMask);
+}
+
+// Cancella i settori ancora vergini che la finestra tocca, poi la scrive
+bool OtaManager::writeWindow(uint16_t window) {
+    uint32_t offset = (uint32_t)window * OTA_WINDOW_CHUNKS * OTA_CHUNK_SIZE;
+    uint32_t len = imageSize - offset;
+    if (len > sizeof(windowBuf)) len = sizeof(windowBuf);
+
+    uint32_t end = offset + len;
+    if (end > erasedUpTo) {
+        uint32_t eraseEnd = (end + SPI_FLASH_SEC_SIZE - 1) / SPI_FLASH_SEC_SIZE * SPI_FLASH_SEC_SIZE;
+        if (eraseEnd > partition->size) eraseEnd = partition->size;
+        if (esp_partition_erase_range(partition, erasedUpTo, eraseEnd - erasedUpTo) != ESP_OK) {
+            return false;
+        }
+        erasedUpTo = eraseEnd;
+    }
+
+    return esp_partition_write(partition, offset, windowBuf, len) == ESP_OK;
+}
+
+void OtaManager::handleCommit() {
+    if (currentWindow < windowCount) {
+        Log.warn("OTA: commit with transfer incomplete (window %u/%u)", currentWindow, windowCount);
+        return;
+    }
+
+    Log.info("OTA: verifying image...");
+    uint8_t sha[32];
+    bool ok = hashPartition(partition, imageSize, sha) && memcmp(sha, imageSha, sizeof(sha)) == 0;
+    nvs.clearOtaProgress();
+
+    if (!ok) {
+        Log.error("OTA: SHA-256 mismatch, image discarded");
+    } else if (esp_ota_set_boot_partition(partition) != ESP_OK) {
+        Log.error("OTA: image rejected by bootloader check");
+        ok = false;
+    }
+
+    if (!ok) {
+        sendStatus(imageId, OTA_STATUS_FAILED);
+        phase = OTA_IDLE;
+        return;
+    }
+
+    nvs.saveOtaApplied(imageId);
+    Log.info("OTA: image %08lX verified, restarting", (unsigned long)imageId);
+    sendStatus(imageId, OTA_STATUS_DONE);
+    phaseStart = millis();
+    phase = OTA_RESTARTING;
+}
+
+void OtaManager::saveProgress() {
+    OtaProgress progress;
+    progress.imageId = imageId;
+    progress.size = imageSize;
+    progress.nextWindow = currentWindow;
+    progress.erasedUpTo = erasedUpTo;
+    nvs.saveOtaProgress(progress);
+}
+
+void OtaManager::sendStatus(uint32_t id, uint8_t status) {
+    OtaStatusFrame frame;
+    frame.type = MSG_OTA_STATUS;
+    frame.slaveId = slaveId;
+    frame.imageId = id;
+    frame.nextWindow = currentWindow;
+    frame.status = status;
+    espNow.sendRaw((const uint8_t*)&frame, sizeof(frame));
+}
+
+void OtaManager::sendNack(uint16_t window, uint32_t missingMask) {
+    OtaNackFrame frame;
+    frame.type = MSG_OTA_NACK;
+    frame.slaveId = slaveId;
+    frame.imageId = imageId;
+    frame.window = window;
+    frame.missing = missingMask;
+    espNow.sendRaw((const uint8_t*)&frame, sizeof(frame));
+}
@@ -0,0 +1,133 @@
+#ifndef OTA_MANAGER_H
+#define OTA_MANAGER_H
+
+#include <Arduino.h>
+#include <esp_partition.h>
+#include "config.h"
+#include "ESPNowManager.h"
+#include "NvsStore.h"
+
+class GameManager;
+
+// Distribuzione del firmware dal master agli slave via ESP-NOW.
+// Il master trasmette l'immagine in broadcast a finestre di OTA_WINDOW_CHUNKS blocchi;
+// a fine finestra ogni slave risponde con la bitmap dei blocchi mancanti e il master
+// ritrasmette solo quelli. Lo slave tiene la finestra in RAM, la scrive nella partizione
+// OTA libera quando è completa e salva il progresso in NVS: un trasferimento interrotto
+// riprende dall'ultima finestra scritta alla successiva offerta della stessa immagine.
+class OtaManager {
+public:
+    OtaManager(ESPNowManager& espNow, NvsStore& nvs, DeviceRole role, uint8_t slaveId);
+
+    void update(bool gameIdle);     // Dal loop; gameIdle = nessun round in corso
+    void handleFrame(const uint8_t* data, int len, const uint8_t* macAddr);  // Callback ESP-NOW
+
+    bool isActive() const { return phase != OTA_IDLE; }
+
+    // Slave: frame OTA accettati solo dal master agganciato (l'hash dell'offerta viene dallo
+    // stesso mittente, da solo non dice chi ha mandato l'immagine)
+    void setGame(GameManager* game) { this->game = game; }
+
+    // Master: sorgenti dell'immagine
+    bool pushRunningImage();        // Firmware in esecuzione
+    bool pushStoredImage();         // Ultima immagine caricata via USB
+
+    // Master: comandi seriali ("ota upload <byte>", "ota push", "ota push self")
+    bool handleCommand(const char* line);
+    bool isReceivingUpload() const { return phase == OTA_USB_UPLOAD; }
+    void receiveUpload(Stream& serial);
+
+private:
+    enum OtaPhase {
+        OTA_IDLE,
+        // Master
+        OTA_USB_UPLOAD,     // Immagine in arrivo via USB CDC
+        OTA_OFFERING,       // Offerta in broadcast, raccolta adesioni
+        OTA_SENDING,        // Invio dei blocchi della finestra (o dei mancanti)
+        OTA_WAIT_NACKS,     // Attesa delle bitmap dei mancanti
+        OTA_COMMITTING,     // Commit ripetuto, raccolta esiti
+        // Slave
+        OTA_RECEIVING,
+        OTA_RESTARTING
+    };
+
+    ESPNowManager& espNow;
+    NvsStore& nvs;
+    GameManager* game;
+    bool isMaster;
+    bool enabled;           // Il listener non trasmette: escluso dagli aggiornamenti
+    uint8_t slaveId;
+    bool gameIdle;
+
+    volatile OtaPhase phase;
+    portMUX_TYPE mux;
+    unsigned long phaseStart;
+    unsigned long lastActivity;
+    unsigned long lastSendAt;
+
+    // Immagine corrente
+    const esp_partition_t* partition;   // Master: sorgente, slave: destinazione
+    uint32_t imageId;
+    uint32_t imageSize;
+    uint8_t imageSha[32];
+    uint16_t chunkCount;
+    uint16_t windowCount;
+    volatile uint16_t currentWindow;
+
+    // Master
+    uint8_t joined;             // Slave che hanno aderito all'offerta
+    uint8_t participants;       // ...ancora attivi
+    uint8_t reported;           // NACK ricevuti per la finestra corrente
+    uint32_t missing;           // Unione dei blocchi mancanti
+    uint8_t silentRounds[MAX_SLAVES];
+    uint8_t joinedMacs[MAX_SLAVES][6];  // MAC di chi ha aderito: lo stesso ID di un altro tavolo non conta
+    uint16_t startWindow;       // Finestra più arretrata tra gli slave (ripresa)
+    uint32_t toSend;            // Blocchi della finestra ancora da inviare in questo giro
+    uint8_t commitsSent;
+    uint8_t doneMask;
+    uint8_t failedMask;
+    uint32_t uploadReceived;
+    unsigned long transferStart;
+    uint32_t chunksSent;
+    uint32_t chunksRepaired;
+    uint32_t nackRounds;
+
+    // Slave
+    uint32_t received;          // Bitmap blocchi ricevuti della finestra corrente
+    uint32_t erasedUpTo;        // Byte della partizione già cancellati
+    volatile bool offerPending;
+    OtaOfferFrame pendingOffer;
+    volatile int32_t windowEndPending;  // -1 = nessuno
+    volatile bool commitPending;
+
+    // Slave: finestra in ricezione. Master: buffer per upload USB e hash.
+    uint8_t windowBuf[OTA_WINDOW_CHUNKS * OTA_CHUNK_SIZE];
+
+    // Master
+    bool beginUpload(uint32_t size);
+    bool startPush(const esp_partition_t* source, uint32_t size, const uint8_t* sha);
+    void updateMaster();
+    void handleMasterFrame(const uint8_t* data, int len, const uint8_t* macAddr);
+    void beginWindow();
+    void sendPendingChunks();
+    void checkNacks();
+    void finishPush();
+    void sendOffer();
+    bool sendChunk(uint16_t index);
+
+    // Slave
+    void updateSlave();
+    void handleSlaveFrame(const uint8_t* data, int len);
+    void handleOffer(const OtaOfferFrame& offer);
+    void handleWindowEnd(uint16_t window);
+    void handleCommit();
+    bool writeWindow(uint16_t window);
+    void saveProgress();
+    void sendStatus(uint32_t id, uint8_t status);
+    void sendNack(uint16_t window, uint32_t missingMask);
+
+    uint32_t windowMask(uint16_t window) const;
+    bool hashPartition(const esp_partition_t* part, uint32_t size, uint8_t* sha);
+};
+
+#endif // OTA_MANAGER_H
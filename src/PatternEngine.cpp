@@ -0,0 +1,154 @@
+#include "PatternEngine.h"
+
+PatternEngine::PatternEngine(uint16_t numLeds) {
+    this->numLeds = numLeds;
+    this->rgb = new uint8_t[numLeds * 3];
+    memset(rgb, 0, numLeds * 3);
+    this->len = 0;
+    this->pc = 0;
+    this->contextColor = 0;
+    this->resumeAt = 0;
+    memset(loops, 0, sizeof(loops));
+}
+
+// Byte occupati dall'istruzione (0 = opcode sconosciuto)
+uint8_t PatternEngine::instructionSize(uint8_t opcode) {
+    switch (opcode) {
+        case PAT_END:      return 1;
+        case PAT_FILL:     return 6;
+        case PAT_FILL_CTX: return 3;
+        case PAT_GRADIENT: return 7;
+        case PAT_FADE:     return 2;
+        case PAT_ROTATE:   return 2;
+        case PAT_WAIT:     return 2;
+        case PAT_LOOP:     return 4;
+        default:           return 0;
+    }
+}
+
+bool PatternEngine::validate(const uint8_t* code, uint8_t len) {
+    if (len == 0 || len > PATTERN_MAX_LEN) return false;
+
+    // Inizi di istruzione, per controllare che i salti non cadano su un argomento
+    bool boundary[PATTERN_MAX_LEN] = {};
+    uint8_t pc = 0;
+    while (pc < len) {
+        uint8_t size = instructionSize(code[pc]);
+        if (size == 0 || pc + size > len) return false;
+        boundary[pc] = true;
+
+        if (code[pc] == PAT_LOOP) {
+            uint8_t id = code[pc + 1];
+            uint8_t target = code[pc + 2];
+            if (id >= PATTERN_MAX_LOOPS || target >= pc || !boundary[target]) return false;
+        }
+        pc += size;
+    }
+    return true;
+}
+
+void PatternEngine::load(const uint8_t* code, uint8_t len, uint32_t contextColor) {
+    memcpy(this->code, code, len);
+    this->len = len;
+    this->contextColor = contextColor;
+    pc = 0;
+    memset(loops, 0, sizeof(loops));
+    memset(rgb, 0, numLeds * 3);
+    resumeAt = millis();
+}
+
+uint16_t PatternEngine::renderFrame(unsigned long now) {
+    if (len == 0) return 0;
+
+    resumeAt = now + PATTERN_FRAME_MS;
+    uint16_t executed = 0;
+    while (executed < PATTERN_BUDGET) {
+        if (pc >= len) {
+            pc = 0;
+            memset(loops, 0, sizeof(loops));
+        }
+        const uint8_t* op = code + pc;
+        pc += instructionSize(op[0]);
+        executed++;
+
+        switch (op[0]) {
+            case PAT_END:
+                pc = len;
+                break;
+            case PAT_FILL:
+                fill(op[1], op[2], op[3], op[4], op[5]);
+                break;
+            case PAT_FILL_CTX:
+                fill(op[1], op[2], (contextColor >> 16) & 0xFF, (contextColor >> 8) & 0xFF, contextColor & 0xFF);
+                break;
+            case PAT_GRADIENT:
+                gradient(op + 1, op + 4);
+                break;
+            case PAT_FADE:
+                fade(op[1]);
+                break;
+            case PAT_ROTATE:
+                rotate((int8_t)op[1]);
+                break;
+            case PAT_WAIT:
+                resumeAt = now + op[1] * 10UL;
+                return executed;
+            case PAT_LOOP:
+                // Contatore a zero quando il ciclo finisce: un ciclo esterno lo riesegue da capo
+                if (op[3] == 0 || ++loops[op[1]] < op[3]) {
+                    pc = op[2];
+                } else {
+                    loops[op[1]] = 0;
+                }
+                break;
+        }
+    }
+    return executed;
+}
+
+void PatternEngine::fill(uint8_t start, uint8_t count, uint8_t r, uint8_t g, uint8_t b) {
+    uint16_t end = (count == 0) ? numLeds : min((uint16_t)(start + count), numLeds);
+    for (uint16_t i = start; i < end; i++) {
+        rgb[i * 3] = r;
+        rgb[i * 3 + 1] = g;
+        rgb[i * 3 + 2] = b;
+    }
+}
+
+void PatternEngine::gradient(const uint8_t* from, const uint8_t* to) {
+    uint16_t last = numLeds > 1 ? numLeds - 1 : 1;
+    for (uint16_t i = 0; i < numLeds; i++) {
+        for (uint8_t c = 0; c < 3; c++) {
+            rgb[i * 3 + c] = from[c] + ((int16_t)to[c] - from[c]) * (int16_t)i / (int16_t)last;
+        }
+    }
+}
+
+void PatternEngine::fade(uint8_t scale) {
+    for (uint16_t i = 0; i < numLeds * 3; i++) {
+        rgb[i] = (rgb[i] * scale) >> 8;
+    }
+}
+
+// Rotazione in posto per inversioni (nessun buffer di appoggio)
+void PatternEngine::rotate(int8_t steps) {
+    if (numLeds < 2) return;
+    uint16_t shift = ((steps % (int16_t)numLeds) + numLeds) % numLeds;
+    if (shift == 0) return;
+
+    auto reverse = [this](uint16_t from, uint16_t to) {
+        while (from < to) {
+            for (uint8_t c = 0; c < 3; c++) {
+                uint8_t tmp = rgb[from * 3 + c];
+                rgb[from * 3 + c] = rgb[to * 3 + c];
+                rgb[to * 3 + c] = tmp;
+            }
+            from++;
+            to--;
+        }
+    };
+    // Destra di shift: inverti tutto, poi le due parti
+    reverse(0, numLeds - 1);
+    reverse(0, shift - 1);
+    reverse(shift, numLeds - 1);
+}
@@ -0,0 +1,62 @@
+#ifndef PATTERN_ENGINE_H
+#define PATTERN_ENGINE_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// Istruzioni del bytecode (opcode + argomenti, byte per byte)
+enum PatternOpcode {
+    PAT_END = 0x00,         // Fine: riparte dall'inizio (contatori azzerati)
+    PAT_FILL = 0x01,        // start count r g b: colore su count LED da start (count 0 = fino in fondo)
+    PAT_FILL_CTX = 0x02,    // start count: come FILL con il colore di contesto (es. vincitore)
+    PAT_GRADIENT = 0x03,    // r1 g1 b1 r2 g2 b2: sfumatura lineare dal primo all'ultimo LED
+    PAT_FADE = 0x04,        // scale: tutti i LED moltiplicati per scale/256
+    PAT_ROTATE = 0x05,      // steps (con segno): ruota il frame di steps posizioni
+    PAT_WAIT = 0x06,        // t: mostra il frame e attende t * 10ms
+    PAT_LOOP = 0x07         // id target count: torna a target (all'indietro) count volte, 0 = sempre
+};
+
+// Interprete dei pattern LED: programmi di pochi byte (un frame ESP-NOW) che disegnano in un
+// buffer RGB. Esecuzione limitata: salti solo all'indietro con contatore e al massimo
+// PATTERN_BUDGET istruzioni per frame, poi il frame viene mostrato comunque.
+class PatternEngine {
+public:
+    explicit PatternEngine(uint16_t numLeds);
+
+    // Controllo statico: opcode noti, argomenti completi, salti all'indietro su un'istruzione
+    static bool validate(const uint8_t* code, uint8_t len);
+
+    // Carica (copia) un programma già validato e riparte dall'inizio
+    void load(const uint8_t* code, uint8_t len, uint32_t contextColor);
+    bool isLoaded() const { return len > 0; }
+
+    // Frame pronto da calcolare (WAIT o PATTERN_FRAME_MS scaduti)
+    bool isDue(unsigned long now) const { return (long)(now - resumeAt) >= 0; }
+    unsigned long getResumeAt() const { return resumeAt; }
+
+    // Esegue fino al prossimo WAIT o al budget, ritorna le istruzioni eseguite
+    uint16_t renderFrame(unsigned long now);
+
+    // Frame corrente: numLeds terne R, G, B
+    const uint8_t* getFrame() const { return rgb; }
+    uint16_t getNumLeds() const { return numLeds; }
+
+private:
+    uint16_t numLeds;
+    uint8_t* rgb;
+
+    uint8_t code[PATTERN_MAX_LEN];
+    uint8_t len;
+    uint8_t pc;
+    uint8_t loops[PATTERN_MAX_LOOPS];
+    uint32_t contextColor;
+    unsigned long resumeAt;
+
+    static uint8_t instructionSize(uint8_t opcode);
+    void fill(uint8_t start, uint8_t count, uint8_t r, uint8_t g, uint8_t b);
+    void gradient(const uint8_t* from, const uint8_t* to);
+    void fade(uint8_t scale);
+    void rotate(int8_t steps);
+};
+
+#endif // PATTERN_ENGINE_H
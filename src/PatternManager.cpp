@@ -0,0 +1,191 @@
+#include "PatternManager.h"
+#include "PatternEngine.h"
+#include "GameManager.h"
+#include "PowerManager.h"
+#include "Logger.h"
+
+PatternManager::PatternManager(ESPNowManager& espNow, NvsStore& nvs, DeviceRole role)
+    : espNow(espNow), nvs(nvs), game(nullptr) {
+    isMaster = (role == ROLE_MASTER);
+    version = 0;
+    mux = portMUX_INITIALIZER_UNLOCKED;
+    pendingMask = 0;
+    lastResend = 0;
+    memset(programs, 0, sizeof(programs));
+}
+
+void PatternManager::begin() {
+    if (!isMaster) return;
+
+    for (uint8_t slot = 0; slot < PATTERN_SLOT_COUNT; slot++) {
+        uint8_t code[PATTERN_MAX_LEN];
+        uint8_t len = nvs.loadPattern(slot, code);
+        if (len > 0 && install(slot, code, len)) {
+            Log.info("Pattern '%s' loaded (%d bytes)", slotName(slot), len);
+        }
+    }
+}
+
+// Copia e versione sotto sezione critica: la ricezione arriva dal task WiFi
+bool PatternManager::install(uint8_t slot, const uint8_t* code, uint8_t len) {
+    if (slot >= PATTERN_SLOT_COUNT) return false;
+    if (len > 0 && !PatternEngine::validate(code, len)) return false;
+
+    portENTER_CRITICAL(&mux);
+    programs[slot].len = len;
+    memcpy(programs[slot].code, code, len);
+    version++;
+    portEXIT_CRITICAL(&mux);
+    return true;
+}
+
+bool PatternManager::copy(uint8_t slot, uint8_t* code, uint8_t& len) {
+    if (slot >= PATTERN_SLOT_COUNT) return false;
+
+    portENTER_CRITICAL(&mux);
+    len = programs[slot].len;
+    memcpy(code, programs[slot].code, len);
+    portEXIT_CRITICAL(&mux);
+    return len > 0;
+}
+
+void PatternManager::handleFrame(const uint8_t* data, int len, const uint8_t* macAddr) {
+    if (isMaster || len < 3) return;
+    // I pattern non sono relayati: il mittente è il master stesso, chiunque altro viene ignorato
+    if (game == nullptr || !game->isFromMaster(macAddr)) return;
+
+    const PatternFrame* frame = (const PatternFrame*)data;
+    if (frame->len > PATTERN_MAX_LEN || len != 3 + frame->len || frame->slot >= PATTERN_SLOT_COUNT) {
+        return;
+    }
+
+    // Le ritrasmissioni periodiche non cambiano nulla
+    if (programs[frame->slot].len == frame->len &&
+        memcmp(programs[frame->slot].code, frame->code, frame->len) == 0) {
+        return;
+    }
+    if (install(frame->slot, frame->code, frame->len)) {
+        Log.info("Pattern '%s' received (%d bytes)", slotName(frame->slot), frame->len);
+    } else {
+        Log.warn("Pattern '%s' rejected: invalid program", slotName(frame->slot));
+    }
+}
+
+void PatternManager::update() {
+    if (!isMaster) return;
+
+    unsigned long now = millis();
+    if (now - lastResend >= PATTERN_RESEND_MS) {
+        lastResend = now;
+        for (uint8_t slot = 0; slot < PATTERN_SLOT_COUNT; slot++) {
+            if (programs[slot].len > 0) pendingMask |= (1 << slot);
+        }
+    }
+
+    // Un frame alla volta, nella finestra di ascolto degli slave e senza intasare la coda
+    if (pendingMask == 0 || (POWER_SAVE && !PowerManager::inSendWindow(micros())) || !espNow.hasTxRoom(TX_PRIO_HOUSEKEEPING)) {
+        return;
+    }
+    for (uint8_t slot = 0; slot < PATTERN_SLOT_COUNT; slot++) {
+        if (pendingMask & (1 << slot)) {
+            pendingMask &= ~(1 << slot);
+            broadcast(slot);
+            return;
+        }
+    }
+}
+
+void PatternManager::broadcast(uint8_t slot) {
+    PatternFrame frame;
+    frame.type = MSG_PATTERN;
+    frame.slot = slot;
+    frame.len = programs[slot].len;
+    memcpy(frame.code, programs[slot].code, frame.len);
+    espNow.sendRaw((const uint8_t*)&frame, 3 + frame.len);
+}
+
+int8_t PatternManager::parseSlot(const char* name) {
+    for (uint8_t slot = 0; slot < PATTERN_SLOT_COUNT; slot++) {
+        if (strcmp(name, slotName(slot)) == 0) return slot;
+    }
+    return -1;
+}
+
+const char* PatternManager::slotName(uint8_t slot) {
+    switch (slot) {
+        case PATTERN_SLOT_START:       return "start";
+        case PATTERN_SLOT_WINNER:      return "winner";
+        case PATTERN_SLOT_FALSE_START: return "false";
+        default:                       return "?";
+    }
+}
+
+bool PatternManager::handleCommand(const char* line) {
+    if (strncmp(line, "pattern", 7) != 0 || (line[7] != ' ' && line[7] != '\0')) return false;
+    if (!isMaster) {
+        Log.warn("Patterns are set on the master");
+        return true;
+    }
+    const char* arg = line[7] == ' ' ? line + 8 : "";
+
+    if (arg[0] == '\0') {
+        for (uint8_t slot = 0; slot < PATTERN_SLOT_COUNT; slot++) {
+            Log.info("Pattern '%s': %d bytes", slotName(slot), programs[slot].len);
+        }
+        return true;
+    }
+
+    bool set = strncmp(arg, "set ", 4) == 0;
+    if (!set && strncmp(arg, "clear ", 6) != 0) {
+        Log.warn("Unknown pattern command: %s", arg);
+        return true;
+    }
+
+    // Nome dello slot fino allo spazio (set) o a fine riga (clear)
+    const char* name = arg + (set ? 4 : 6);
+    const char* hex = strchr(name, ' ');
+    char slotStr[8];
+    size_t nameLen = hex != nullptr ? (size_t)(hex - name) : strlen(name);
+    if (nameLen >= sizeof(slotStr)) nameLen = sizeof(slotStr) - 1;
+    memcpy(slotStr, name, nameLen);
+    slotStr[nameLen] = '\0';
+
+    int8_t slot = parseSlot(slotStr);
+    if (slot < 0) {
+        Log.warn("Unknown pattern slot: %s (start, winner, false)", slotStr);
+        return true;
+    }
+
+    uint8_t code[PATTERN_MAX_LEN];
+    uint8_t len = 0;
+    if (set) {
+        if (hex == nullptr) {
+            Log.warn("Usage: pattern set <slot> <hex>");
+            return true;
+        }
+        hex++;
+        size_t hexLen = strlen(hex);
+        if (hexLen == 0 || hexLen % 2 != 0 || hexLen / 2 > PATTERN_MAX_LEN) {
+            Log.error("Pattern: bad hex length");
+            return true;
+        }
+        for (size_t i = 0; i < hexLen; i += 2) {
+            char byteStr[3] = { hex[i], hex[i + 1], '\0' };
+            char* end;
+            code[len++] = (uint8_t)strtol(byteStr, &end, 16);
+            if (*end != '\0') {
+                Log.error("Pattern: bad hex");
+                return true;
+            }
+        }
+    }
+
+    if (!install(slot, code, len)) {
+        Log.error("Pattern '%s' rejected: invalid program", slotName(slot));
+        return true;
+    }
+    nvs.savePattern(slot, code, len);
+    pendingMask |= (1 << slot);
+    Log.info("Pattern '%s' %s (%d bytes), broadcasting", slotName(slot), set ? "set" : "cleared", len);
+    return true;
+}
@@ -0,0 +1,59 @@
+#ifndef PATTERN_MANAGER_H
+#define PATTERN_MANAGER_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "ESPNowManager.h"
+#include "NvsStore.h"
+
+class GameManager;
+
+// Pattern LED per gli eventi di gioco (start, vincitore, falsa partenza) cambiabili senza
+// riflashare. Il master li riceve da seriale, li salva in NVS e li trasmette in broadcast
+// (subito e ogni PATTERN_RESEND_MS per chi si aggancia dopo); slave e listener li tengono
+// in RAM. Uno slot vuoto lascia l'animazione del firmware.
+class PatternManager {
+public:
+    PatternManager(ESPNowManager& espNow, NvsStore& nvs, DeviceRole role);
+
+    void begin();
+    void update();                  // Master: trasmissioni
+    void handleFrame(const uint8_t* data, int len, const uint8_t* macAddr);     // Callback ESP-NOW (slave, listener)
+
+    // Slave e listener: accettano pattern solo dal master a cui sono agganciati
+    void setGame(GameManager* game) { this->game = game; }
+
+    bool has(uint8_t slot) const { return slot < PATTERN_SLOT_COUNT && programs[slot].len > 0; }
+    bool copy(uint8_t slot, uint8_t* code, uint8_t& len);
+    uint16_t getVersion() const { return version; }     // Cresce ad ogni programma cambiato
+
+    // Master: "pattern" (elenco), "pattern set <slot> <hex>", "pattern clear <slot>"
+    // con slot = start | winner | false
+    bool handleCommand(const char* line);
+
+private:
+    struct Program {
+        uint8_t len;
+        uint8_t code[PATTERN_MAX_LEN];
+    };
+
+    ESPNowManager& espNow;
+    NvsStore& nvs;
+    GameManager* game;
+    bool isMaster;
+
+    Program programs[PATTERN_SLOT_COUNT];
+    volatile uint16_t version;
+    portMUX_TYPE mux;
+
+    // Master
+    uint8_t pendingMask;            // Slot da trasmettere
+    unsigned long lastResend;
+
+    bool install(uint8_t slot, const uint8_t* code, uint8_t len);
+    void broadcast(uint8_t slot);
+    static int8_t parseSlot(const char* name);
+    static const char* slotName(uint8_t slot);
+};
+
+#endif // PATTERN_MANAGER_H
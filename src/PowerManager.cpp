@@ -0,0 +1,125 @@
+#include "PowerManager.h"
+#include "Logger.h"
+#include <esp_sleep.h>
+#include <esp_timer.h>
+#include <driver/gpio.h>
+
+static const char* POWER_STATE_NAMES[POWER_STATE_COUNT] = { "active", "idle", "sleep" };
+static const uint32_t POWER_STATE_UA[POWER_STATE_COUNT] = { POWER_ACTIVE_UA, POWER_ACTIVE_UA, POWER_SLEEP_UA };
+
+PowerManager::PowerManager() {
+    buttonPin = 0;
+    buttonIsr = nullptr;
+    lastUpdate = 0;
+    lastState = POWER_ACTIVE;
+    resetStats();
+}
+
+void PowerManager::begin(uint8_t buttonPin, void (*buttonIsr)()) {
+    this->buttonPin = buttonPin;
+    this->buttonIsr = buttonIsr;
+    lastUpdate = esp_timer_get_time();
+    Log.info("Power save: %s", POWER_SAVE ? "enabled" : "disabled");
+}
+
+bool PowerManager::update(bool idle, uint32_t sleepUs) {
+    int64_t now = esp_timer_get_time();
+    account(lastState, now - lastUpdate);
+    lastUpdate = now;
+    lastState = idle ? POWER_IDLE : POWER_ACTIVE;
+
+    if (!POWER_SAVE || !idle || sleepUs < POWER_MIN_SLEEP_US) {
+        return false;
+    }
+    // Pulsante tenuto: il risveglio a livello scatterebbe subito
+    if (digitalRead(buttonPin) == LOW) {
+        return false;
+    }
+    return lightSleep(sleepUs);
+}
+
+// Radio spenta durante il sonno: i frame fuori finestra vanno persi, per questo il
+// master trasmette solo nelle finestre di ascolto
+bool PowerManager::lightSleep(uint32_t us) {
+    // L'interrupt a fronte va staccato: il risveglio usa lo stesso pin a livello
+    detachInterrupt(digitalPinToInterrupt(buttonPin));
+    gpio_wakeup_enable((gpio_num_t)buttonPin, GPIO_INTR_LOW_LEVEL);
+    esp_sleep_enable_gpio_wakeup();
+    esp_sleep_enable_timer_wakeup(us);
+
+    int64_t start = esp_timer_get_time();
+    esp_light_sleep_start();
+    int64_t end = esp_timer_get_time();
+
+    bool byButton = esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_GPIO;
+    esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_TIMER);
+    gpio_wakeup_disable((gpio_num_t)buttonPin);
+    attachInterrupt(digitalPinToInterrupt(buttonPin), buttonIsr, FALLING);
+
+    account(POWER_SLEEP, end - start);
+    lastUpdate = end;
+    sleepCount++;
+    if (byButton) buttonWakes++;
+    return byButton;
+}
+
+void PowerManager::account(PowerState state, uint64_t us) {
+    timeUs[state] += us;
+}
+
+// Corrente media pesata sul tempo trascorso in ogni stato
+uint32_t PowerManager::averageCurrentUa() const {
+    uint64_t total = 0;
+    uint64_t charge = 0;
+    for (uint8_t i = 0; i < POWER_STATE_COUNT; i++) {
+        total += timeUs[i];
+        charge += timeUs[i] * POWER_STATE_UA[i];
+    }
+    return total > 0 ? (uint32_t)(charge / total) : 0;
+}
+
+void PowerManager::resetStats() {
+    for (uint8_t i = 0; i < POWER_STATE_COUNT; i++) {
+        timeUs[i] = 0;
+    }
+    sleepCount = 0;
+    buttonWakes = 0;
+}
+
+void PowerManager::printReport() {
+    uint64_t total = 0;
+    for (uint8_t i = 0; i < POWER_STATE_COUNT; i++) {
+        total += timeUs[i];
+    }
+    if (total == 0) {
+        Log.info("Power: no data");
+        return;
+    }
+
+    Log.info("=== Power report (%lu s) ===", (unsigned long)(total / 1000000));
+    for (uint8_t i = 0; i < POWER_STATE_COUNT; i++) {
+        Log.info("  %-6s %8lu ms  %3u%%", POWER_STATE_NAMES[i],
+                 (unsigned long)(timeUs[i] / 1000), (unsigned)(timeUs[i] * 100 / total));
+    }
+
+    uint32_t avgUa = averageCurrentUa();
+    uint32_t hours = avgUa > 0 ? (uint32_t)((uint64_t)BATTERY_CAPACITY_MAH * 1000 / avgUa) : 0;
+    uint32_t alwaysOnHours = BATTERY_CAPACITY_MAH * 1000 / POWER_ACTIVE_UA;
+    Log.info("  Sleeps: %lu (button wakes: %lu)", (unsigned long)sleepCount, (unsigned long)buttonWakes);
+    Log.info("  Avg current: %lu uA, runtime ~%lu h on %d mAh (always on: %lu h, LEDs excluded)",
+             (unsigned long)avgUa, (unsigned long)hours, BATTERY_CAPACITY_MAH,
+             (unsigned long)alwaysOnHours);
+}
+
+bool PowerManager::handleCommand(const char* line) {
+    if (strcmp(line, "power") == 0) {
+        printReport();
+        return true;
+    }
+    if (strcmp(line, "power reset") == 0) {
+        resetStats();
+        Log.info("Power: stats reset");
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,65 @@
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// Stati del modello energetico
+enum PowerState {
+    POWER_ACTIVE,       // Round in corso, connessione, master: sempre sveglio
+    POWER_IDLE,         // Inattivo ma sveglio (finestra di ascolto, attesa risposte)
+    POWER_SLEEP,        // Light sleep
+    POWER_STATE_COUNT
+};
+
+// Light sleep degli slave tra una finestra di ascolto e l'altra.
+// Le finestre sono allineate al clock del master (POWER_CYCLE_US/POWER_LISTEN_US):
+// il master trasmette heartbeat, start e offerte OTA solo dentro una finestra,
+// lo slave dorme fuori. Risveglio dal pulsante (GPIO) o da timer.
+// Il modello energetico somma il tempo in ogni stato e ne stima consumo e autonomia.
+class PowerManager {
+public:
+    PowerManager();
+
+    void begin(uint8_t buttonPin, void (*buttonIsr)());
+
+    // Dal loop. idle = slave inattivo con radio ferma, sleepUs = fino al prossimo evento.
+    // Ritorna true se a svegliare è stato il pulsante.
+    bool update(bool idle, uint32_t sleepUs);
+
+    // Finestra di ascolto comune (tempo in micros() del master)
+    static bool inListenWindow(uint32_t masterUs) {
+        return (masterUs & (POWER_CYCLE_US - 1)) < POWER_LISTEN_US;
+    }
+    static uint32_t untilListenWindow(uint32_t masterUs) {
+        return POWER_CYCLE_US - (masterUs & (POWER_CYCLE_US - 1));
+    }
+    // Master: prima metà della finestra, il frame arriva prima che gli slave tornino a dormire
+    static bool inSendWindow(uint32_t masterUs) {
+        return (masterUs & (POWER_CYCLE_US - 1)) < POWER_LISTEN_US / 2;
+    }
+
+    // Modello energetico (solo aritmetica, nessun accesso all'hardware)
+    void account(PowerState state, uint64_t us);
+    uint64_t getTimeUs(PowerState state) const { return timeUs[state]; }
+    uint32_t averageCurrentUa() const;
+    void resetStats();
+    void printReport();
+
+    // Comandi seriali ("power", "power reset")
+    bool handleCommand(const char* line);
+
+private:
+    uint8_t buttonPin;
+    void (*buttonIsr)();
+
+    int64_t lastUpdate;
+    PowerState lastState;
+    uint64_t timeUs[POWER_STATE_COUNT];
+    uint32_t sleepCount;
+    uint32_t buttonWakes;
+
+    bool lightSleep(uint32_t us);
+};
+
+#endif // POWER_MANAGER_H
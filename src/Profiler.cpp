@@ -0,0 +1,94 @@
+#include "Profiler.h"
+#include "Logger.h"
+
+Profiler::SectionStats Profiler::stats[PROF_SECTION_COUNT];
+uint32_t Profiler::since = 0;
+portMUX_TYPE Profiler::mux = portMUX_INITIALIZER_UNLOCKED;
+
+static const char* SECTION_NAMES[PROF_SECTION_COUNT] = {
+    "loop", "serial", "press", "game", "led_show", "log",
+    "espnow_rx", "button_isr", "charge_isr", "charge_eval"
+};
+
+// Chiamata anche dalle ISR e dai task radio/timer: sezione critica brevissima
+void IRAM_ATTR Profiler::record(ProfileSection section, uint32_t cycles) {
+    uint8_t bucket = 0;
+    if (cycles >= 256) {
+        bucket = 31 - __builtin_clz(cycles) - 7;
+        if (bucket >= PROF_HISTOGRAM_BUCKETS) bucket = PROF_HISTOGRAM_BUCKETS - 1;
+    }
+
+    portENTER_CRITICAL_SAFE(&mux);
+    SectionStats& s = stats[section];
+    if (s.count == 0 || cycles < s.minCycles) s.minCycles = cycles;
+    if (cycles > s.maxCycles) s.maxCycles = cycles;
+    s.count++;
+    s.totalCycles += cycles;
+    s.histogram[bucket]++;
+    portEXIT_CRITICAL_SAFE(&mux);
+}
+
+void Profiler::reset() {
+    portENTER_CRITICAL(&mux);
+    memset(stats, 0, sizeof(stats));
+    portEXIT_CRITICAL(&mux);
+    since = millis();
+}
+
+void Profiler::dump() {
+    if (!PROFILER_ENABLED) {
+        Log.warn("Profiler disabled (PROFILER_ENABLED false in config.h)");
+        return;
+    }
+
+    // Copia coerente: le ISR continuano ad aggiornare durante la stampa
+    SectionStats snapshot[PROF_SECTION_COUNT];
+    portENTER_CRITICAL(&mux);
+    memcpy(snapshot, stats, sizeof(stats));
+    portEXIT_CRITICAL(&mux);
+
+    uint32_t mhz = ESP.getCpuFreqMHz();
+    uint32_t elapsedMs = millis() - since;
+    uint64_t loopCycles = snapshot[PROF_LOOP].totalCycles;
+
+    Log.info("=== Profiler (%lu ms, %lu MHz) ===", (unsigned long)elapsedMs, (unsigned long)mhz);
+    // cpu% = quota del tempo trascorso, loop% = rispetto al tempo di lavoro di loop() (senza delay)
+    Log.info("  %-11s %8s %8s %8s %8s %6s %6s", "section", "count", "min us", "avg us", "max us",
+             "cpu%", "loop%");
+    for (uint8_t i = 0; i < PROF_SECTION_COUNT; i++) {
+        const SectionStats& s = snapshot[i];
+        if (s.count == 0) continue;
+
+        uint32_t avg = (uint32_t)(s.totalCycles / s.count);
+        uint32_t cpuPermille = elapsedMs > 0 ? (uint32_t)(s.totalCycles / ((uint64_t)mhz * elapsedMs)) : 0;
+        uint32_t loopPct = loopCycles > 0 ? (uint32_t)(s.totalCycles * 100 / loopCycles) : 0;
+        Log.info("  %-11s %8lu %8lu %8lu %8lu %5lu.%lu %6lu", SECTION_NAMES[i], (unsigned long)s.count,
+                 (unsigned long)(s.minCycles / mhz), (unsigned long)(avg / mhz),
+                 (unsigned long)(s.maxCycles / mhz), (unsigned long)(cpuPermille / 10),
+                 (unsigned long)(cpuPermille % 10), (unsigned long)loopPct);
+
+        // Istogramma delle durate: jitter della sezione
+        char row[160];
+        int pos = snprintf(row, sizeof(row), "    hist:");
+        for (uint8_t b = 0; b < PROF_HISTOGRAM_BUCKETS && pos < (int)sizeof(row); b++) {
+            if (s.histogram[b] == 0) continue;
+            uint32_t fromUs = b == 0 ? 0 : (256UL << (b - 1)) / mhz;
+            pos += snprintf(row + pos, sizeof(row) - pos, " >=%luus:%lu", (unsigned long)fromUs,
+                            (unsigned long)s.histogram[b]);
+        }
+        Log.info("%s", row);
+    }
+}
+
+bool Profiler::handleCommand(const char* line) {
+    if (strcmp(line, "prof") == 0) {
+        dump();
+        return true;
+    }
+    if (strcmp(line, "prof reset") == 0) {
+        reset();
+        Log.info("Profiler: stats reset");
+        return true;
+    }
+    return false;
+}
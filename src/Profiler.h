@@ -0,0 +1,76 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// Sezioni misurate
+enum ProfileSection {
+    PROF_LOOP,              // loop() completo
+    PROF_SERIAL_POLL,       // Comandi seriali
+    PROF_PRESS,             // Gestione pressione nel loop (handleButtonPress)
+    PROF_GAME_UPDATE,       // GameManager::update
+    PROF_LED_SHOW,          // LEDController::show (trasmissione WS2812B)
+    PROF_LOG,               // Logger: formattazione e scrittura di una riga
+    PROF_ESPNOW_RX,         // Callback di ricezione ESP-NOW
+    PROF_BUTTON_ISR,        // ISR del pulsante
+    PROF_CHARGE_ISR,        // ISR dei pin del caricatore
+    PROF_CHARGE_EVAL,       // Valutazione stato ricarica (timer)
+    PROF_SECTION_COUNT
+};
+
+#define PROF_HISTOGRAM_BUCKETS 16   // Durate in potenze di 2 a partire da 256 cicli (~1us)
+
+// Profiler a contatore di cicli: per sezione conteggio, min/media/max e istogramma delle
+// durate. Con PROFILER_ENABLED false le sezioni non generano codice.
+class Profiler {
+public:
+    static void IRAM_ATTR record(ProfileSection section, uint32_t cycles);
+    static void reset();
+    static void dump();
+
+    // Comandi seriali ("prof", "prof reset")
+    static bool handleCommand(const char* line);
+
+private:
+    struct SectionStats {
+        uint32_t count;
+        uint64_t totalCycles;
+        uint32_t minCycles;
+        uint32_t maxCycles;
+        uint32_t histogram[PROF_HISTOGRAM_BUCKETS];
+    };
+
+    static SectionStats stats[PROF_SECTION_COUNT];
+    static uint32_t since;      // millis() dell'ultimo reset
+    static portMUX_TYPE mux;
+};
+
+// Misura la durata dello scope in cui è dichiarata (anche con return anticipati).
+// stop() chiude la misura prima della fine dello scope (es. prima di un delay).
+class ProfileScope {
+public:
+    inline ProfileScope(ProfileSection section) : section(section), start(ESP.getCycleCount()), active(true) {}
+    inline ~ProfileScope() { stop(); }
+
+    inline void stop() {
+        if (!active) return;
+        active = false;
+        Profiler::record(section, ESP.getCycleCount() - start);
+    }
+
+private:
+    ProfileSection section;
+    uint32_t start;
+    bool active;
+};
+
+#if PROFILER_ENABLED
+#define PROFILE_SCOPE(section) ProfileScope _profileScope(section)
+#define PROFILE_STOP() _profileScope.stop()
+#else
+#define PROFILE_SCOPE(section) do {} while (0)
+#define PROFILE_STOP() do {} while (0)
+#endif
+
+#endif // PROFILER_H
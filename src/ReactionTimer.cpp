@@ -0,0 +1,99 @@
+#include "ReactionTimer.h"
+#include "Logger.h"
+
+ReactionTimer::ReactionTimer() {
+    isrLatencyUs = 0;
+    armed = false;
+    goMicros = 0;
+    roundOpen = false;
+    roundNumber = 0;
+    resultCount = 0;
+
+    for (uint8_t i = 0; i < MAX_SLAVES; i++) {
+        roundResult[i] = 0;
+        bestUs[i] = 0;
+        sumUs[i] = 0;
+        count[i] = 0;
+    }
+}
+
+void ReactionTimer::setCalibration(uint32_t isrLatencyUs) {
+    this->isrLatencyUs = isrLatencyUs;
+    Log.info("Latency calibration: ISR %lu us, latch %d us", (unsigned long)isrLatencyUs, LED_LATCH_US);
+}
+
+// ==================== SLAVE ====================
+
+void ReactionTimer::arm(uint32_t showEndMicros) {
+    goMicros = showEndMicros + LED_LATCH_US;
+    armed = true;
+}
+
+bool ReactionTimer::capture(uint32_t pressMicros, uint32_t& reactionUs) {
+    if (!armed) return false;
+    armed = false;
+
+    int32_t elapsed = (int32_t)(pressMicros - isrLatencyUs - goMicros);
+    if (elapsed <= 0 || elapsed > (int32_t)REACTION_TIMEOUT_MS * 1000) {
+        return false;
+    }
+
+    reactionUs = (uint32_t)elapsed;
+    return true;
+}
+
+// ==================== MASTER ====================
+
+void ReactionTimer::beginRound() {
+    roundOpen = true;
+    roundNumber++;
+    resultCount = 0;
+    for (uint8_t i = 0; i < MAX_SLAVES; i++) {
+        roundResult[i] = 0;
+    }
+}
+
+void ReactionTimer::addResult(uint8_t id, uint32_t reactionUs) {
+    if (!roundOpen || id >= MAX_SLAVES || roundResult[id] != 0) return;
+
+    roundResult[id] = reactionUs;
+    resultCount++;
+
+    sumUs[id] += reactionUs;
+    count[id]++;
+    if (bestUs[id] == 0 || reactionUs < bestUs[id]) {
+        bestUs[id] = reactionUs;
+    }
+
+    Log.info("Reaction Slave %d: %lu.%03lu ms", id,
+             (unsigned long)(reactionUs / 1000), (unsigned long)(reactionUs % 1000));
+}
+
+void ReactionTimer::closeRound() {
+    if (!roundOpen) return;
+    roundOpen = false;
+
+    Log.info("=== Reaction round %u ===", roundNumber);
+
+    // Classifica del round (selection sort su 4 elementi)
+    bool listed[MAX_SLAVES] = {};
+    for (uint8_t pos = 1; pos <= resultCount; pos++) {
+        uint8_t best = 0xFF;
+        for (uint8_t i = 0; i < MAX_SLAVES; i++) {
+            if (roundResult[i] == 0 || listed[i]) continue;
+            if (best == 0xFF || roundResult[i] < roundResult[best]) best = i;
+        }
+        listed[best] = true;
+        Log.info("%d. Slave %d  %lu.%03lu ms", pos, best,
+                 (unsigned long)(roundResult[best] / 1000), (unsigned long)(roundResult[best] % 1000));
+    }
+
+    // Medie tra i round
+    for (uint8_t i = 0; i < MAX_SLAVES; i++) {
+        if (count[i] == 0) continue;
+        uint32_t avg = (uint32_t)(sumUs[i] / count[i]);
+        Log.info("Slave %d: avg %lu.%03lu ms, best %lu.%03lu ms (%u rounds)", i,
+                 (unsigned long)(avg / 1000), (unsigned long)(avg % 1000),
+                 (unsigned long)(bestUs[i] / 1000), (unsigned long)(bestUs[i] % 1000), count[i]);
+    }
+}
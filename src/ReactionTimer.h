@@ -0,0 +1,52 @@
+#ifndef REACTION_TIMER_H
+#define REACTION_TIMER_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// Misura del tempo di reazione (slave) e classifica per round/media (master).
+// Riferimento: fine di show() del frame "via" + latch WS2812, fino al primo
+// fronte del pulsante meno la latenza ISR calibrata.
+class ReactionTimer {
+public:
+    ReactionTimer();
+
+    // Calibrazione per-scheda (misurata all'avvio). La durata di show() non serve:
+    // arm() riceve già l'istante di fine show()
+    void setCalibration(uint32_t isrLatencyUs);
+    uint32_t getIsrLatency() const { return isrLatencyUs; }
+
+    // Slave
+    void arm(uint32_t showEndMicros);
+    void disarm() { armed = false; }
+    bool isArmed() const { return armed; }
+    bool capture(uint32_t pressMicros, uint32_t& reactionUs);
+
+    // Master
+    void beginRound();
+    void addResult(uint8_t id, uint32_t reactionUs);
+    bool isRoundOpen() const { return roundOpen; }
+    uint8_t getResultCount() const { return resultCount; }
+    void closeRound();
+
+private:
+    // Calibrazione
+    uint32_t isrLatencyUs;
+
+    // Slave
+    bool armed;
+    uint32_t goMicros;  // Istante in cui i LED sono effettivamente accesi
+
+    // Master: round corrente
+    bool roundOpen;
+    uint16_t roundNumber;
+    uint8_t resultCount;
+    uint32_t roundResult[MAX_SLAVES];  // 0 = nessun risultato
+
+    // Master: statistiche tra i round
+    uint32_t bestUs[MAX_SLAVES];
+    uint64_t sumUs[MAX_SLAVES];
+    uint16_t count[MAX_SLAVES];
+};
+
+#endif // REACTION_TIMER_H
@@ -0,0 +1,85 @@
+#include "RtcCheckpoint.h"
+#include "Logger.h"
+
+#define CHECKPOINT_MAGIC 0x50524E31   // "PRN1": cambiare se cambia GameCheckpoint
+
+// Blocco in RTC slow memory, non inizializzato al boot
+struct RtcBlock {
+    uint32_t magic;
+    uint16_t recoveries;             // Ripartenze da checkpoint dall'ultimo avvio a freddo
+    GameCheckpoint data;
+    uint32_t crc;
+};
+
+RTC_NOINIT_ATTR static RtcBlock rtcBlock;
+
+bool RtcCheckpoint::begin() {
+    resetReason = esp_reset_reason();
+
+    bool crashReset = resetReason == ESP_RST_PANIC || resetReason == ESP_RST_INT_WDT ||
+                      resetReason == ESP_RST_TASK_WDT || resetReason == ESP_RST_WDT ||
+                      resetReason == ESP_RST_BROWNOUT;
+    bool valid = rtcBlock.magic == CHECKPOINT_MAGIC &&
+                 rtcBlock.crc == crc32((const uint8_t*)&rtcBlock, offsetof(RtcBlock, crc));
+
+    // Riavvii voluti (OTA, associazione) e accensioni ripartono da zero
+    warmBoot = crashReset && valid;
+    if (warmBoot) {
+        rtcBlock.recoveries++;
+        rtcBlock.crc = crc32((const uint8_t*)&rtcBlock, offsetof(RtcBlock, crc));
+    } else {
+        invalidate();
+    }
+    return warmBoot;
+}
+
+const char* RtcCheckpoint::getResetReasonName() const {
+    switch (resetReason) {
+        case ESP_RST_POWERON:   return "power-on";
+        case ESP_RST_EXT:       return "external";
+        case ESP_RST_SW:        return "software";
+        case ESP_RST_PANIC:     return "panic";
+        case ESP_RST_INT_WDT:   return "interrupt watchdog";
+        case ESP_RST_TASK_WDT:  return "task watchdog";
+        case ESP_RST_WDT:       return "watchdog";
+        case ESP_RST_DEEPSLEEP: return "deep sleep";
+        case ESP_RST_BROWNOUT:  return "brownout";
+        case ESP_RST_SDIO:      return "SDIO";
+        default:                return "unknown";
+    }
+}
+
+uint16_t RtcCheckpoint::getRecoveries() const {
+    return warmBoot ? rtcBlock.recoveries : 0;
+}
+
+const GameCheckpoint& RtcCheckpoint::get() const {
+    return rtcBlock.data;
+}
+
+// Scrive solo se qualcosa è cambiato
+void RtcCheckpoint::save(const GameCheckpoint& checkpoint) {
+    if (rtcBlock.magic == CHECKPOINT_MAGIC && memcmp(&rtcBlock.data, &checkpoint, sizeof(checkpoint)) == 0) {
+        return;
+    }
+
+    rtcBlock.magic = CHECKPOINT_MAGIC;
+    rtcBlock.data = checkpoint;
+    rtcBlock.crc = crc32((const uint8_t*)&rtcBlock, offsetof(RtcBlock, crc));
+}
+
+void RtcCheckpoint::invalidate() {
+    memset(&rtcBlock, 0, sizeof(rtcBlock));
+}
+
+// CRC-32 (IEEE 802.3), bit a bit: il blocco è di poche decine di byte
+uint32_t RtcCheckpoint::crc32(const uint8_t* data, size_t len) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
@@ -0,0 +1,47 @@
+#ifndef RTC_CHECKPOINT_H
+#define RTC_CHECKPOINT_H
+
+#include <Arduino.h>
+#include <esp_system.h>
+#include "config.h"
+
+// Stato di gioco minimo per ripartire dopo un reset anomalo
+struct GameCheckpoint {
+    uint8_t role;                    // DeviceRole: deve coincidere con l'identità al riavvio
+    uint8_t slaveId;
+    uint8_t state;                   // GameState
+    uint8_t winner;
+    uint16_t round;
+    uint16_t epoch;                  // Epoca di sessione (il master non la incrementa)
+    uint16_t version;                // Versione snapshot del master
+    uint8_t rosterCount;             // Master: slave connessi
+    uint8_t rosterIds[MAX_SLAVES];
+    uint8_t rosterMacs[MAX_SLAVES][6];
+    uint8_t masterMac[6];            // Slave: master agganciato
+    uint8_t connected;               // Slave: agganciato al master
+};
+
+// Checkpoint in RTC slow memory protetto da CRC: sopravvive a panic, watchdog e brownout
+// (non a uno spegnimento). All'avvio viene usato solo se il reset è stato anomalo.
+class RtcCheckpoint {
+public:
+    // Da chiamare una volta all'avvio, prima di tutto
+    bool begin();
+
+    bool isWarmBoot() const { return warmBoot; }
+    esp_reset_reason_t getResetReason() const { return resetReason; }
+    const char* getResetReasonName() const;
+    uint16_t getRecoveries() const;
+    const GameCheckpoint& get() const;
+
+    void save(const GameCheckpoint& checkpoint);
+    void invalidate();
+
+private:
+    esp_reset_reason_t resetReason;
+    bool warmBoot;
+
+    static uint32_t crc32(const uint8_t* data, size_t len);
+};
+
+#endif // RTC_CHECKPOINT_H
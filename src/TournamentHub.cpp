@@ -0,0 +1,370 @@
+#include "TournamentHub.h"
+#include "Logger.h"
+#include <esp_system.h>
+
+TournamentHub::TournamentHub(ESPNowManager& espNow) : espNow(espNow) {
+    mux = portMUX_INITIALIZER_UNLOCKED;
+    quiet = false;
+    reset();
+}
+
+void TournamentHub::begin() {
+    espNow.setNodeId(NODE_LISTENER);
+    lastReport = millis();
+    Log.info("Hub: up to %d arenas, report every %d ms", HUB_MAX_ARENAS, HUB_REPORT_MS);
+}
+
+void TournamentHub::reset() {
+    portENTER_CRITICAL(&mux);
+    memset(arenas, 0, sizeof(arenas));
+    eventHead = 0;
+    eventCount = 0;
+    eventsDropped = 0;
+    evictions = 0;
+    frames = 0;
+    callbackUs = 0;
+    callbackMaxUs = 0;
+    portEXIT_CRITICAL(&mux);
+
+    lastReport = millis();
+    lastReportFrames = 0;
+    lastReportCallbackUs = 0;
+}
+
+// Chiamata con mux preso. Tavolo nuovo a tabella piena: si sostituisce il meno recente.
+TournamentHub::ArenaStats* TournamentHub::findArena(const uint8_t* macAddr, unsigned long now) {
+    ArenaStats* slot = nullptr;
+    for (uint8_t i = 0; i < HUB_MAX_ARENAS; i++) {
+        ArenaStats& a = arenas[i];
+        if (!a.used) {
+            if (slot == nullptr || slot->used) slot = &a;
+            continue;
+        }
+        if (memcmp(a.mac, macAddr, 6) == 0) return &a;
+        if (slot == nullptr || (slot->used && now - a.lastHeard > now - slot->lastHeard)) slot = &a;
+    }
+
+    if (slot->used) evictions++;
+    memset(slot, 0, sizeof(ArenaStats));
+    memcpy(slot->mac, macAddr, 6);
+    slot->used = true;
+    slot->roundMinUs = UINT32_MAX;
+    return slot;
+}
+
+// Chiamata con mux preso. Coda piena: l'evento si perde (resta nei contatori del tavolo).
+void TournamentHub::pushEvent(uint8_t type, const ArenaStats& arena, uint8_t slaveId, uint32_t durationUs) {
+    if (eventCount >= HUB_EVENT_QUEUE) {
+        eventsDropped++;
+        return;
+    }
+    HubEvent& e = events[(eventHead + eventCount) % HUB_EVENT_QUEUE];
+    e.type = type;
+    e.arenaId = arena.arenaId;
+    e.slaveId = slaveId;
+    memcpy(e.mac, arena.mac, 6);
+    e.round = arena.round;
+    e.epoch = arena.epoch;
+    e.durationUs = durationUs;
+    eventCount++;
+}
+
+void TournamentHub::handleMessage(const Message& msg, const uint8_t* macAddr) {
+    // Solo i frame dei master: gli slave si vedono nel roster degli heartbeat
+    if (msg.origin != NODE_MASTER) return;
+
+    uint32_t nowUs = micros();
+    unsigned long now = millis();
+
+    portENTER_CRITICAL(&mux);
+    frames++;
+    ArenaStats& a = *findArena(macAddr, now);
+    a.frames++;
+    a.lastHeard = now;
+
+    // Epoca cambiata: il master è ripartito, il round in corso è perso
+    bool restarted = a.epoch != 0 && msg.epoch != a.epoch;
+    a.epoch = msg.epoch;
+    if (restarted) {
+        a.restarts++;
+        a.roundOpen = false;
+        a.startedRound = 0;
+        pushEvent(HUB_EV_RESTART, a, 0xFF, 0);
+    }
+
+    switch (msg.type) {
+        case MSG_MASTER_HEARTBEAT: {
+            a.arenaId = (uint8_t)(msg.timestamp >> 8);
+            a.state = msg.data;
+            a.round = msg.round;
+            if (a.lastHeartbeat != 0 && now - a.lastHeartbeat > a.heartbeatGapMaxMs) {
+                a.heartbeatGapMaxMs = now - a.lastHeartbeat;
+            }
+            a.lastHeartbeat = now;
+            a.rosterDrops += __builtin_popcount(a.roster & ~msg.roster);
+            a.roster = msg.roster;
+            break;
+        }
+
+        case MSG_START_GAME:
+            if (msg.round != a.startedRound) {
+                a.startedRound = msg.round;
+                a.round = msg.round;
+                a.roundOpen = true;
+                // Start programmato: il via è START_LEAD_US dopo l'invio
+                a.roundStartUs = nowUs + ((msg.data & START_FLAG_SCHEDULED) ? START_LEAD_US : 0);
+            }
+            break;
+
+        case MSG_WINNER_ANNOUNCE:
+            if (a.roundOpen && msg.slaveId < MAX_SLAVES) {
+                a.roundOpen = false;
+                int32_t elapsed = (int32_t)(nowUs - a.roundStartUs);
+                uint32_t durationUs = elapsed > 0 ? elapsed : 0;
+                a.rounds++;
+                a.wins[msg.slaveId]++;
+                a.roundSumUs += durationUs;
+                if (durationUs < a.roundMinUs) a.roundMinUs = durationUs;
+                if (durationUs > a.roundMaxUs) a.roundMaxUs = durationUs;
+                pushEvent(HUB_EV_ROUND, a, msg.slaveId, durationUs);
+            }
+            break;
+
+        case MSG_FALSE_START:
+            a.falseStarts++;
+            a.roundOpen = false;
+            pushEvent(HUB_EV_FALSE_START, a, msg.slaveId, 0);
+            break;
+
+        default:
+            break;
+    }
+
+    uint32_t cost = micros() - nowUs;
+    callbackUs += cost;
+    if (cost > callbackMaxUs) callbackMaxUs = cost;
+    portEXIT_CRITICAL(&mux);
+}
+
+void TournamentHub::update() {
+    drainEvents();
+
+    if (millis() - lastReport >= HUB_REPORT_MS) {
+        report();
+    }
+}
+
+void TournamentHub::drainEvents() {
+    while (true) {
+        HubEvent e;
+        portENTER_CRITICAL(&mux);
+        bool hasEvent = eventCount > 0;
+        if (hasEvent) {
+            e = events[eventHead];
+            eventHead = (eventHead + 1) % HUB_EVENT_QUEUE;
+            eventCount--;
+        }
+        portEXIT_CRITICAL(&mux);
+        if (!hasEvent) return;
+        if (quiet) continue;
+
+        char mac[18];
+        formatMac(e.mac, mac);
+        switch (e.type) {
+            case HUB_EV_ROUND:
+                Serial.printf("hub,round,%u,%s,%u,%u,%lu\n", e.arenaId, mac, e.round, e.slaveId,
+                              (unsigned long)e.durationUs);
+                break;
+            case HUB_EV_FALSE_START:
+                Serial.printf("hub,false_start,%u,%s,%u\n", e.arenaId, mac, e.round);
+                break;
+            case HUB_EV_RESTART:
+                Serial.printf("hub,restart,%u,%s,%u\n", e.arenaId, mac, e.epoch);
+                break;
+        }
+    }
+}
+
+void TournamentHub::report() {
+    unsigned long now = millis();
+    uint32_t elapsed = now - lastReport;
+    lastReport = now;
+
+    uint32_t totalFrames, totalCallbackUs, maxCallbackUs, dropped, evicted;
+    portENTER_CRITICAL(&mux);
+    memcpy(reportCopy, arenas, sizeof(reportCopy));
+    totalFrames = frames;
+    totalCallbackUs = callbackUs;
+    maxCallbackUs = callbackMaxUs;
+    callbackMaxUs = 0;
+    dropped = eventsDropped;
+    evicted = evictions;
+    portEXIT_CRITICAL(&mux);
+
+    uint8_t tracked = 0;
+    for (uint8_t i = 0; i < HUB_MAX_ARENAS; i++) {
+        const ArenaStats& a = reportCopy[i];
+        if (!a.used) continue;
+        tracked++;
+
+        char mac[18];
+        formatMac(a.mac, mac);
+        LinkSnapshot link;
+        if (!espNow.getLinkStats().getLink(a.mac, link)) {
+            link.rssi = 0;
+            link.lossPct = 0;
+        }
+        bool online = now - a.lastHeard < HUB_ARENA_TIMEOUT_MS;
+        uint32_t avgUs = a.rounds > 0 ? (uint32_t)(a.roundSumUs / a.rounds) : 0;
+
+        Serial.printf("hub,arena,%u,%s,%d,%u,%u,%02X,%u,%u,%u,%u,%lu,%lu,%lu,%lu,%d,%u\n",
+                      a.arenaId, mac, online ? 1 : 0, a.state, a.round, a.roster,
+                      a.rounds, a.falseStarts, a.restarts, a.rosterDrops,
+                      (unsigned long)(a.rounds > 0 ? a.roundMinUs : 0), (unsigned long)avgUs,
+                      (unsigned long)a.roundMaxUs, (unsigned long)a.heartbeatGapMaxMs,
+                      link.rssi, link.lossPct);
+    }
+
+    printLeaderboard(HUB_LEADERBOARD_SIZE);
+
+    uint32_t newFrames = totalFrames - lastReportFrames;
+    uint32_t newCallbackUs = totalCallbackUs - lastReportCallbackUs;
+    lastReportFrames = totalFrames;
+    lastReportCallbackUs = totalCallbackUs;
+    Serial.printf("hub,stats,%u,%lu,%lu,%lu,%lu,%lu,%lu\n", tracked, (unsigned long)totalFrames,
+                  (unsigned long)(elapsed > 0 ? (uint64_t)newFrames * 1000 / elapsed : 0),
+                  (unsigned long)(newFrames > 0 ? newCallbackUs / newFrames : 0),
+                  (unsigned long)maxCallbackUs, (unsigned long)dropped, (unsigned long)evicted);
+}
+
+// Migliori giocatori (tavolo, slave) per vittorie su tutti i tavoli: selezione parziale
+// sulla copia del report, al più HUB_MAX_ARENAS * MAX_SLAVES confronti per posizione
+void TournamentHub::printLeaderboard(uint8_t count) {
+    uint32_t taken[HUB_MAX_ARENAS] = {0};  // Bit = slave già in classifica
+
+    for (uint8_t rank = 1; rank <= count; rank++) {
+        int16_t bestArena = -1;
+        uint8_t bestSlave = 0;
+        uint16_t bestWins = 0;
+        for (uint8_t i = 0; i < HUB_MAX_ARENAS; i++) {
+            const ArenaStats& a = reportCopy[i];
+            if (!a.used) continue;
+            for (uint8_t s = 0; s < MAX_SLAVES; s++) {
+                if ((taken[i] & (1 << s)) || a.wins[s] <= bestWins) continue;
+                bestArena = i;
+                bestSlave = s;
+                bestWins = a.wins[s];
+            }
+        }
+        if (bestArena < 0) return;
+
+        taken[bestArena] |= (1 << bestSlave);
+        Serial.printf("hub,leader,%u,%u,%u,%u\n", rank, reportCopy[bestArena].arenaId, bestSlave, bestWins);
+    }
+}
+
+// Master simulati iniettati nel percorso di ricezione reale (ESPNowManager::injectFrame):
+// ogni tavolo gioca round completi (heartbeat, start, vincitore o falsa partenza) alla
+// massima velocità, per misurare il carico sostenibile. Le statistiche ripartono da zero.
+void TournamentHub::simulate(uint8_t arenaCount, uint32_t seconds) {
+    Log.info("Hub: simulating %d arenas for %lu s", arenaCount, (unsigned long)seconds);
+    reset();
+    quiet = true;
+
+    uint8_t raw[sizeof(Message)];
+    uint8_t mac[6] = {0x02, 0x48, 0x55, 0x42, 0x00, 0x00};  // Locali: non collidono con schede vere
+    uint8_t step[HUB_MAX_ARENAS] = {0};
+    uint16_t round[HUB_MAX_ARENAS] = {0};
+    uint8_t seq[HUB_MAX_ARENAS] = {0};
+    uint32_t injected = 0;
+
+    unsigned long start = millis();
+    unsigned long lastYield = start;
+    while (millis() - start < seconds * 1000) {
+        for (uint8_t i = 0; i < arenaCount; i++) {
+            Message msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.epoch = 1;
+            msg.origin = NODE_MASTER;
+            msg.dest = NODE_ALL;
+            msg.flags = FRAME_FLAG_BROADCAST;
+            msg.seq = seq[i]++;
+            msg.originSeq = msg.seq;
+            msg.originNonce = 0x48554200 | i;   // Un nodo per tavolo simulato
+
+            // Ciclo di 4 frame per round; un round su 8 finisce in falsa partenza
+            switch (step[i]) {
+                case 0:
+                    msg.type = MSG_MASTER_HEARTBEAT;
+                    msg.data = STATE_READY;
+                    msg.roster = 0x0F;
+                    msg.timestamp = (uint32_t)(i + 1) << 8;
+                    break;
+                case 1:
+                    round[i]++;
+                    msg.type = MSG_START_GAME;
+                    break;
+                case 2:
+                    msg.type = MSG_MASTER_HEARTBEAT;
+                    msg.data = STATE_GAME_RUNNING;
+                    msg.roster = 0x0F;
+                    msg.timestamp = (uint32_t)(i + 1) << 8;
+                    break;
+                default:
+                    msg.type = (round[i] % 8 == 0) ? MSG_FALSE_START : MSG_WINNER_ANNOUNCE;
+                    msg.slaveId = esp_random() % 4;
+                    break;
+            }
+            msg.round = round[i];
+            step[i] = (step[i] + 1) % 4;
+
+            mac[5] = i;
+            memcpy(raw, &msg, sizeof(msg));
+            ESPNowManager::injectFrame(mac, raw, sizeof(raw));
+            injected++;
+        }
+
+        drainEvents();
+
+        // Il task idle deve girare (watchdog), e i frame veri continuano ad arrivare
+        if (millis() - lastYield >= 100) {
+            lastYield = millis();
+            delay(1);
+        }
+    }
+
+    drainEvents();
+    quiet = false;
+    Log.info("Hub: injected %lu frames", (unsigned long)injected);
+    report();
+}
+
+void TournamentHub::formatMac(const uint8_t* mac, char* out) {
+    snprintf(out, 18, "%02X:%02X:%02X:%02X:%02X:%02X", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+}
+
+bool TournamentHub::handleCommand(const char* line) {
+    if (strncmp(line, "hub", 3) != 0 || (line[3] != ' ' && line[3] != '\0')) return false;
+
+    const char* arg = line + 3;
+    while (*arg == ' ') arg++;
+
+    if (*arg == '\0') {
+        report();
+    } else if (strcmp(arg, "clear") == 0) {
+        reset();
+        Log.info("Hub: statistics cleared");
+    } else if (strncmp(arg, "sim ", 4) == 0) {
+        int arenaCount = 0;
+        int seconds = 0;
+        if (sscanf(arg + 4, "%d %d", &arenaCount, &seconds) != 2 ||
+            arenaCount < 1 || arenaCount > HUB_MAX_ARENAS || seconds < 1) {
+            Log.warn("Usage: hub sim <1-%d arenas> <seconds>", HUB_MAX_ARENAS);
+            return true;
+        }
+        simulate(arenaCount, seconds);
+    } else {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,106 @@
+#ifndef TOURNAMENT_HUB_H
+#define TOURNAMENT_HUB_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "ESPNowManager.h"
+
+// Tabellone di torneo: l'hub ascolta i broadcast di più master (un master = un tavolo,
+// riconosciuto dal MAC; l'ID di arena arriva negli heartbeat) e riassume round, vincitori,
+// durate e salute dei roster. Non trasmette mai via radio.
+// L'aggregazione avviene nella callback ESP-NOW in una tabella fissa di HUB_MAX_ARENAS
+// tavoli (il meno recente lascia il posto a un nuovo master); gli eventi passano al loop
+// in un anello di HUB_EVENT_QUEUE voci e ne escono come righe CSV su USB:
+//   hub,round,<arena>,<mac>,<round>,<vincitore>,<durata_us>
+//   hub,false_start,<arena>,<mac>,<round>
+//   hub,restart,<arena>,<mac>,<epoca>
+// e ogni HUB_REPORT_MS:
+//   hub,arena,<arena>,<mac>,<online>,<stato>,<round>,<roster>,<round_giocati>,<false_start>,
+//       <riavvii>,<uscite_roster>,<min_us>,<media_us>,<max_us>,<buco_hb_ms>,<rssi>,<perdita_pct>
+//   hub,leader,<posizione>,<arena>,<slave>,<vittorie>
+//   hub,stats,<tavoli>,<frame>,<frame_s>,<callback_media_us>,<callback_max_us>,<eventi_persi>,<sostituiti>
+class TournamentHub {
+public:
+    explicit TournamentHub(ESPNowManager& espNow);
+
+    void begin();
+    void update();                  // Dal loop: eventi e report periodico
+    void handleMessage(const Message& msg, const uint8_t* macAddr);     // Callback ESP-NOW
+
+    // "hub" (report subito), "hub clear", "hub sim <tavoli> <secondi>" (master simulati)
+    bool handleCommand(const char* line);
+
+private:
+    struct ArenaStats {
+        uint8_t mac[6];
+        bool used;
+        uint8_t arenaId;            // Dall'heartbeat del master, 0 = non assegnato
+        uint16_t epoch;
+        uint8_t state;
+        uint8_t roster;
+        uint16_t round;
+        uint16_t startedRound;      // Ultimo START visto (i duplicati non riaprono il round)
+        bool roundOpen;
+        uint32_t roundStartUs;      // Istante del via in micros() dell'hub
+        unsigned long lastHeard;
+        unsigned long lastHeartbeat;
+        uint32_t heartbeatGapMaxMs;
+        uint32_t frames;
+        uint16_t rounds;
+        uint16_t falseStarts;
+        uint16_t restarts;
+        uint16_t rosterDrops;       // Slave spariti dal roster tra due heartbeat
+        uint16_t wins[MAX_SLAVES];
+        uint32_t roundMinUs;
+        uint32_t roundMaxUs;
+        uint64_t roundSumUs;
+    };
+
+    enum HubEventType : uint8_t {
+        HUB_EV_ROUND,
+        HUB_EV_FALSE_START,
+        HUB_EV_RESTART
+    };
+
+    struct HubEvent {
+        uint8_t type;
+        uint8_t arenaId;
+        uint8_t slaveId;
+        uint8_t mac[6];
+        uint16_t round;
+        uint16_t epoch;
+        uint32_t durationUs;
+    };
+
+    ESPNowManager& espNow;
+    portMUX_TYPE mux;
+
+    // Scritti dalla callback (task WiFi) sotto mux
+    ArenaStats arenas[HUB_MAX_ARENAS];
+    HubEvent events[HUB_EVENT_QUEUE];
+    uint8_t eventHead;
+    uint8_t eventCount;
+    uint32_t eventsDropped;
+    uint32_t evictions;
+    uint32_t frames;
+    uint32_t callbackUs;
+    uint32_t callbackMaxUs;
+
+    // Loop
+    ArenaStats reportCopy[HUB_MAX_ARENAS];
+    unsigned long lastReport;
+    uint32_t lastReportFrames;
+    uint32_t lastReportCallbackUs;
+    bool quiet;                     // Simulazione: eventi contati ma non stampati
+
+    ArenaStats* findArena(const uint8_t* macAddr, unsigned long now);
+    void pushEvent(uint8_t type, const ArenaStats& arena, uint8_t slaveId, uint32_t durationUs);
+    void drainEvents();
+    void report();
+    void printLeaderboard(uint8_t count);
+    void reset();
+    void simulate(uint8_t arenaCount, uint32_t seconds);
+    static void formatMac(const uint8_t* mac, char* out);
+};
+
+#endif // TOURNAMENT_HUB_H
@@ -0,0 +1,189 @@
+#include "TraceRecorder.h"
+#include "Logger.h"
+
+uint8_t* TraceRecorder::buffer = nullptr;
+uint32_t TraceRecorder::used = 0;
+uint32_t TraceRecorder::expected = 0;
+volatile bool TraceRecorder::recording = false;
+volatile bool TraceRecorder::overflow = false;
+TraceRecorder::StateObserver TraceRecorder::stateObserver = nullptr;
+portMUX_TYPE TraceRecorder::mux = portMUX_INITIALIZER_UNLOCKED;
+
+static const uint8_t TRACE_HEX_BYTES = 16;   // Byte per riga esportata
+
+bool TraceRecorder::allocate() {
+    if (buffer == nullptr) {
+        buffer = (uint8_t*)malloc(TRACE_BUFFER_SIZE);
+        if (buffer == nullptr) {
+            Log.error("Trace: cannot allocate %d bytes", TRACE_BUFFER_SIZE);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TraceRecorder::start(const GameCheckpoint& startState) {
+    if (!allocate()) return false;
+
+    TraceHeader header;
+    header.magic = TRACE_MAGIC;
+    header.start = startState;
+
+    portENTER_CRITICAL(&mux);
+    memcpy(buffer, &header, sizeof(header));
+    used = sizeof(header);
+    overflow = false;
+    recording = true;
+    portEXIT_CRITICAL(&mux);
+
+    Log.info("Trace: recording (%d bytes buffer)", TRACE_BUFFER_SIZE);
+    return true;
+}
+
+void TraceRecorder::stop() {
+    recording = false;
+    Log.info("Trace: stopped, %lu bytes%s", (unsigned long)used, overflow ? " (buffer full)" : "");
+}
+
+// Chiamata dal loop, dal task WiFi e dai timer: un record alla volta sotto sezione critica.
+// A buffer pieno la cattura si ferma (si tiene l'inizio dell'incidente).
+void TraceRecorder::append(const TraceRecordHeader& header, const uint8_t* a, uint8_t aLen,
+                           const uint8_t* b, uint8_t bLen) {
+    uint32_t size = sizeof(header) + aLen + bLen;
+
+    portENTER_CRITICAL(&mux);
+    if (recording) {
+        if (used + size > TRACE_BUFFER_SIZE) {
+            recording = false;
+            overflow = true;
+        } else {
+            memcpy(buffer + used, &header, sizeof(header));
+            if (aLen > 0) memcpy(buffer + used + sizeof(header), a, aLen);
+            if (bLen > 0) memcpy(buffer + used + sizeof(header) + aLen, b, bLen);
+            used += size;
+        }
+    }
+    portEXIT_CRITICAL(&mux);
+}
+
+void TraceRecorder::recordFrame(TraceEventType type, const uint8_t* macAddr, const uint8_t* data, uint8_t len) {
+    if (!recording) return;
+
+    TraceRecordHeader header = { (uint8_t)type, (uint32_t)micros() };
+    uint8_t prefix[7];
+    memcpy(prefix, macAddr, 6);
+    prefix[6] = len;
+    append(header, prefix, sizeof(prefix), data, len);
+}
+
+void TraceRecorder::recordButton(uint32_t pressMicros) {
+    if (!recording) return;
+
+    TraceRecordHeader header = { TRACE_BUTTON, pressMicros };
+    append(header, nullptr, 0, nullptr, 0);
+}
+
+void TraceRecorder::recordState(uint8_t from, uint8_t to, uint16_t round) {
+    if (stateObserver != nullptr) {
+        stateObserver(from, to, round);
+        return;
+    }
+    if (!recording) return;
+
+    TraceRecordHeader header = { TRACE_STATE, (uint32_t)micros() };
+    uint8_t payload[4] = { from, to, (uint8_t)(round & 0xFF), (uint8_t)(round >> 8) };
+    append(header, payload, sizeof(payload), nullptr, 0);
+}
+
+bool TraceRecorder::getHeader(TraceHeader& header) {
+    if (buffer == nullptr || used < sizeof(TraceHeader)) return false;
+    memcpy(&header, buffer, sizeof(header));
+    return header.magic == TRACE_MAGIC;
+}
+
+// Righe "trace <hex>" tra "trace begin <byte>" e "trace end": si ricaricano così come sono
+void TraceRecorder::dump() {
+    if (buffer == nullptr || used == 0) {
+        Log.info("Trace: empty");
+        return;
+    }
+
+    char line[8 + TRACE_HEX_BYTES * 2];
+    Serial.printf("trace begin %lu\n", (unsigned long)used);
+    for (uint32_t offset = 0; offset < used; offset += TRACE_HEX_BYTES) {
+        uint32_t n = min((uint32_t)TRACE_HEX_BYTES, used - offset);
+        int pos = snprintf(line, sizeof(line), "trace ");
+        for (uint32_t i = 0; i < n; i++) {
+            pos += snprintf(line + pos, sizeof(line) - pos, "%02x", buffer[offset + i]);
+        }
+        Serial.println(line);
+    }
+    Serial.println("trace end");
+}
+
+bool TraceRecorder::loadHexLine(const char* hex) {
+    size_t len = strlen(hex);
+    if (len == 0 || len % 2 != 0 || used + len / 2 > expected) return false;
+
+    for (size_t i = 0; i < len; i += 2) {
+        char byteStr[3] = { hex[i], hex[i + 1], '\0' };
+        char* end;
+        long value = strtol(byteStr, &end, 16);
+        if (*end != '\0') return false;
+        buffer[used++] = (uint8_t)value;
+    }
+    return true;
+}
+
+bool TraceRecorder::handleCommand(const char* line) {
+    if (strncmp(line, "trace", 5) != 0 || (line[5] != ' ' && line[5] != '\0')) return false;
+    const char* arg = line[5] == ' ' ? line + 6 : "";
+
+    if (strcmp(arg, "stop") == 0) {
+        stop();
+    } else if (strcmp(arg, "dump") == 0) {
+        dump();
+    } else if (strcmp(arg, "status") == 0 || arg[0] == '\0') {
+        Log.info("Trace: %s, %lu/%d bytes%s", recording ? "recording" : "stopped",
+                 (unsigned long)used, TRACE_BUFFER_SIZE, overflow ? " (buffer full)" : "");
+    } else if (strcmp(arg, "clear") == 0) {
+        // Un record in corso da un altro task non deve scrivere oltre il nuovo used
+        portENTER_CRITICAL(&mux);
+        recording = false;
+        used = 0;
+        overflow = false;
+        portEXIT_CRITICAL(&mux);
+        Log.info("Trace: cleared");
+    } else if (strncmp(arg, "begin ", 6) == 0) {
+        uint32_t size = strtoul(arg + 6, nullptr, 10);
+        if (size < sizeof(TraceHeader) || size > TRACE_BUFFER_SIZE || !allocate()) {
+            Log.error("Trace: invalid size %lu", (unsigned long)size);
+            return true;
+        }
+        portENTER_CRITICAL(&mux);
+        recording = false;
+        used = 0;
+        overflow = false;
+        portEXIT_CRITICAL(&mux);
+        expected = size;
+    } else if (strcmp(arg, "end") == 0) {
+        TraceHeader header;
+        if (used != expected || !getHeader(header)) {
+            Log.error("Trace: load incomplete (%lu/%lu bytes)", (unsigned long)used, (unsigned long)expected);
+            used = 0;
+        } else {
+            Log.info("Trace: loaded %lu bytes (role %d, slave %d)", (unsigned long)used,
+                     header.start.role, header.start.slaveId);
+        }
+        expected = 0;
+    } else if (expected > 0) {
+        if (!loadHexLine(arg)) {
+            Log.error("Trace: bad line at byte %lu, load aborted", (unsigned long)used);
+            used = 0;
+            expected = 0;
+        }
+    } else {
+        Log.warn("Unknown trace command: %s", arg);
+    }
+    return true;
+}
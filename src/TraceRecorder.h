@@ -0,0 +1,73 @@
+#ifndef TRACE_RECORDER_H
+#define TRACE_RECORDER_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "RtcCheckpoint.h"
+
+// Tipi di evento della traccia
+enum TraceEventType {
+    TRACE_RX = 1,       // Frame ricevuto: MAC, lunghezza, byte
+    TRACE_TX,           // Frame accodato per l'invio: MAC destinatario, lunghezza, byte
+    TRACE_BUTTON,       // Pressione (timestamp = fronte nella ISR)
+    TRACE_STATE         // Transizione: da, a, round
+};
+
+#define TRACE_MAGIC 0x32525450      // "PTR2" (Message con originNonce)
+
+// Intestazione: stato di partenza del GameManager, per ripartire da lì nel replay
+struct __attribute__((packed)) TraceHeader {
+    uint32_t magic;
+    GameCheckpoint start;
+};
+
+// Ogni evento: tipo (1 byte), micros() (4 byte), dati del tipo
+struct __attribute__((packed)) TraceRecordHeader {
+    uint8_t type;
+    uint32_t timestamp;
+};
+
+// Cattura di frame ricevuti e inviati, pressioni e transizioni di stato in un buffer RAM
+// (allocato solo all'avvio della cattura). Esportata sulla seriale in righe esadecimali
+// che si possono ricaricare su un'altra scheda per il replay (env bench).
+class TraceRecorder {
+public:
+    static bool start(const GameCheckpoint& startState);
+    static void stop();
+    static bool isRecording() { return recording; }
+
+    // Hook dei moduli (non fanno nulla se la cattura è ferma)
+    static void recordFrame(TraceEventType type, const uint8_t* macAddr, const uint8_t* data, uint8_t len);
+    static void recordButton(uint32_t pressMicros);
+    static void recordState(uint8_t from, uint8_t to, uint16_t round);
+
+    // Replay: le transizioni vanno all'osservatore invece che nella traccia
+    typedef void (*StateObserver)(uint8_t from, uint8_t to, uint16_t round);
+    static void setStateObserver(StateObserver observer) { stateObserver = observer; }
+
+    // Traccia in memoria (catturata o caricata)
+    static const uint8_t* getData() { return buffer; }
+    static uint32_t getSize() { return used; }
+    static bool getHeader(TraceHeader& header);
+
+    // Comandi seriali: "trace stop|dump|status|clear", "trace begin <byte>" + righe "trace <hex>"
+    // + "trace end" per caricare (lo stesso formato prodotto da dump)
+    static bool handleCommand(const char* line);
+
+private:
+    static uint8_t* buffer;
+    static uint32_t used;
+    static uint32_t expected;       // Caricamento: byte annunciati da "trace begin"
+    static volatile bool recording;
+    static volatile bool overflow;
+    static StateObserver stateObserver;
+    static portMUX_TYPE mux;
+
+    static bool allocate();
+    static void append(const TraceRecordHeader& header, const uint8_t* a, uint8_t aLen,
+                       const uint8_t* b, uint8_t bLen);
+    static void dump();
+    static bool loadHexLine(const char* hex);
+};
+
+#endif // TRACE_RECORDER_H
@@ -0,0 +1,160 @@
+#include "TraceReplay.h"
+#include "GameManager.h"
+#include "Logger.h"
+
+// Fronte della pressione (main.cpp): il replay lo riporta all'istante registrato
+extern volatile uint32_t buttonPressMicros;
+
+static GameManager* replayGame = nullptr;
+static TraceReplayResult* replayResult = nullptr;
+
+static void replayMessage(const Message& msg, const uint8_t* macAddr) {
+    if (replayGame != nullptr) {
+        replayGame->handleMessage(msg, macAddr);
+    }
+}
+
+static void replayState(uint8_t from, uint8_t to, uint16_t round) {
+    if (replayResult != nullptr && replayResult->replayedCount < TRACE_REPLAY_MAX_TRANSITIONS) {
+        replayResult->replayed[replayResult->replayedCount][0] = from;
+        replayResult->replayed[replayResult->replayedCount][1] = to;
+        replayResult->replayedCount++;
+    }
+}
+
+bool TraceReplayResult::transitionsMatch() const {
+    if (replayedCount != expectedCount) return false;
+    for (uint8_t i = 0; i < expectedCount; i++) {
+        if (replayed[i][0] != expected[i][0] || replayed[i][1] != expected[i][1]) return false;
+    }
+    return true;
+}
+
+bool TraceReplay::run(GameManager& game, ESPNowManager& espNow, const uint8_t* data, uint32_t size,
+                      TraceReplayResult& result) {
+    memset(&result, 0, sizeof(result));
+
+    TraceHeader header;
+    if (data == nullptr || size < sizeof(header)) {
+        Log.warn("Replay: no trace loaded");
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != TRACE_MAGIC) {
+        Log.warn("Replay: bad trace magic");
+        return false;
+    }
+    if (!game.applyCheckpoint(header.start)) return false;
+
+    espNow.setNodeId(header.start.role == ROLE_MASTER ? NODE_MASTER : header.start.slaveId);
+    replayGame = &game;
+    replayResult = &result;
+    espNow.setMessageCallback(replayMessage);
+    TraceRecorder::setStateObserver(replayState);
+
+    uint32_t txBefore = espNow.getTxStats().enqueued;
+    uint32_t offset = sizeof(TraceHeader);
+    uint32_t t0 = 0;
+    uint32_t replayStart = micros();
+    bool first = true;
+
+    while (offset + sizeof(TraceRecordHeader) <= size) {
+        TraceRecordHeader rec;
+        memcpy(&rec, data + offset, sizeof(rec));
+        const uint8_t* payload = data + offset + sizeof(rec);
+        uint32_t payloadLen = 0;
+        if (rec.type == TRACE_RX || rec.type == TRACE_TX) {
+            payloadLen = (offset + sizeof(rec) + 7 <= size) ? 7 + payload[6] : 0xFFFF;
+        } else if (rec.type == TRACE_STATE) {
+            payloadLen = 4;
+        } else if (rec.type != TRACE_BUTTON) {
+            result.truncated = true;
+            break;
+        }
+        if (offset + sizeof(rec) + payloadLen > size) {
+            result.truncated = true;
+            break;
+        }
+        offset += sizeof(rec) + payloadLen;
+
+        if (first) {
+            t0 = rec.timestamp;
+            first = false;
+        }
+        uint32_t target = replayStart + (rec.timestamp - t0);
+
+        if (rec.type == TRACE_TX) {
+            result.expectedTx++;
+            continue;
+        }
+        if (rec.type == TRACE_STATE) {
+            if (result.expectedCount < TRACE_REPLAY_MAX_TRANSITIONS) {
+                result.expected[result.expectedCount][0] = payload[0];
+                result.expected[result.expectedCount][1] = payload[1];
+                result.expectedCount++;
+            }
+            continue;
+        }
+
+        // Tra un ingresso e l'altro il gioco gira come nel loop (timeout, heartbeat, animazioni)
+        while ((int32_t)(micros() - target) < 0) {
+            game.update();
+            espNow.update();
+            delay(1);
+        }
+
+        uint32_t startUs = micros();
+        if (rec.type == TRACE_RX) {
+            ESPNowManager::injectFrame(payload, payload + 7, payload[6]);
+        } else {
+            buttonPressMicros = target;
+            game.handleButtonPress();
+        }
+        uint32_t elapsed = micros() - startUs;
+        result.handleTotalUs += elapsed;
+        if (elapsed > result.handleMaxUs) result.handleMaxUs = elapsed;
+        result.inputs++;
+    }
+    if (result.truncated) result.truncatedAt = offset;
+
+    unsigned long tailStart = millis();
+    while (millis() - tailStart < TRACE_REPLAY_TAIL_MS) {
+        game.update();
+        espNow.update();
+        delay(1);
+    }
+
+    TraceRecorder::setStateObserver(nullptr);
+    espNow.setMessageCallback(nullptr);
+    replayGame = nullptr;
+    replayResult = nullptr;
+    result.replayTx = espNow.getTxStats().enqueued - txBefore;
+    return true;
+}
+
+void TraceReplay::print(const TraceReplayResult& result) {
+    uint8_t rows = max(result.expectedCount, result.replayedCount);
+    for (uint8_t i = 0; i < rows; i++) {
+        char traced[12] = "--";
+        char replayed[12] = "--";
+        if (i < result.expectedCount) {
+            snprintf(traced, sizeof(traced), "%d->%d", result.expected[i][0], result.expected[i][1]);
+        }
+        if (i < result.replayedCount) {
+            snprintf(replayed, sizeof(replayed), "%d->%d", result.replayed[i][0], result.replayed[i][1]);
+        }
+        Serial.printf("  %2d: trace %-6s replay %s\n", i, traced, replayed);
+    }
+
+    if (result.truncated) {
+        Log.warn("Replay: trace truncated at byte %lu", (unsigned long)result.truncatedAt);
+    }
+    Log.info("Replay: %lu inputs, transitions %s (%d/%d), tx %lu/%lu",
+             (unsigned long)result.inputs, result.transitionsMatch() ? "PASS" : "FAIL",
+             result.replayedCount, result.expectedCount,
+             (unsigned long)result.replayTx, (unsigned long)result.expectedTx);
+    if (result.inputs > 0) {
+        Log.info("Replay: handling latency avg %lu us, max %lu us",
+                 (unsigned long)(result.handleTotalUs / result.inputs), (unsigned long)result.handleMaxUs);
+    }
+}
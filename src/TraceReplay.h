@@ -0,0 +1,43 @@
+#ifndef TRACE_REPLAY_H
+#define TRACE_REPLAY_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "ESPNowManager.h"
+#include "TraceRecorder.h"
+
+class GameManager;
+
+#define TRACE_REPLAY_MAX_TRANSITIONS 64
+
+// Esito di un replay: transizioni e frame inviati, registrati contro rieseguiti
+struct TraceReplayResult {
+    uint8_t expected[TRACE_REPLAY_MAX_TRANSITIONS][2];     // Da, a
+    uint8_t expectedCount;
+    uint8_t replayed[TRACE_REPLAY_MAX_TRANSITIONS][2];
+    uint8_t replayedCount;
+    uint32_t expectedTx;
+    uint32_t replayTx;
+    uint32_t inputs;                // Frame ricevuti e pressioni consegnati
+    uint32_t handleTotalUs;
+    uint32_t handleMaxUs;
+    bool truncated;
+    uint32_t truncatedAt;           // Byte del primo record illeggibile
+
+    bool transitionsMatch() const;
+};
+
+// Driver del replay, comune al firmware bench e ai test nativi: riparte dallo stato
+// dell'intestazione, consegna frame ricevuti e pressioni con la spaziatura originale facendo
+// girare update() tra un evento e l'altro (delay(1): sull'host fa avanzare il tempo simulato)
+// e raccoglie le transizioni. Il GameManager deve avere ruolo e ID della traccia.
+class TraceReplay {
+public:
+    static bool run(GameManager& game, ESPNowManager& espNow, const uint8_t* data, uint32_t size,
+                    TraceReplayResult& result);
+
+    // Tabella affiancata delle transizioni, PASS/FAIL, frame inviati e latenza di gestione
+    static void print(const TraceReplayResult& result);
+};
+
+#endif // TRACE_REPLAY_H
@@ -4,9 +4,19 @@
 #include <Arduino.h>
 
 // ==================== CONFIGURAZIONE DISPOSITIVO ====================
-// Cambia questo valore per configurare Master o Slave
+// Ruolo e ID letti dalla NVS: un'unica immagine per tutte le schede. Una scheda mai
+// associata parte in associazione (vedi PAIRING_*). Con false valgono i #define qui sotto.
+#define ROLE_FROM_NVS true
+
+// Cambia questo valore per configurare Master o Slave (solo con ROLE_FROM_NVS false)
 #define IS_MASTER false  // true = Master, false = Slave
 
+// Display passivo: segue il gioco senza entrare nel roster (ignora IS_MASTER e SLAVE_ID)
+#define IS_LISTENER false
+
+// Ripetitore: ritrasmette i frame del master e degli slave (richiede RELAY_MODE)
+#define IS_RELAY false
+
 // ID Slave (solo per slave, ignorato se IS_MASTER = true)
 // 0 = Giallo, 1 = Verde, 2 = Blu, 3 = Rosso
 #define SLAVE_ID 3
@@ -41,6 +51,7 @@
 #define COLOR_LIME      0x00FF00  // Verde Lime (Slave 1)
 #define COLOR_BLUE      0x0000FF  // Blu (Slave 2)
 #define COLOR_RED       0xFF2000  // Arancione rossastro (Slave 3)
+#define COLOR_WHITE     0xFFFFFF  // Bianco (associazione)
 
 // Array di colori per gli slave
 const uint32_t SLAVE_COLORS[] = {
@@ -54,6 +65,47 @@ const uint32_t SLAVE_COLORS[] = {
 #define MAX_SLAVES 4
 #define ESP_NOW_CHANNEL 1
 #define ESP_NOW_SEND_TIMEOUT 1000  // ms
+#define LINK_TABLE_SIZE 8          // Link monitorati (slave + master + broadcast)
+#define LINK_RSSI_PROMISCUOUS false // RSSI dai frame ESP-NOW via modalità promiscua (diagnostica)
+#define LINK_STATS_DUMP_MS 30000   // Master: stampa statistiche link ogni 30s
+#define TX_QUEUE_SIZE 8            // Coda di invio per livello di priorità
+#define TX_MAX_INFLIGHT 2          // Frame consegnati a esp_now_send in attesa di completamento
+#define TX_COMPLETE_TIMEOUT_US 100000  // Completamento mai arrivato: libera lo slot dopo 100ms
+
+// Ripetitori multi-hop (stessa impostazione su tutti i dispositivi)
+#define RELAY_MODE false           // true = tutti i frame in broadcast con TTL, inoltrati dai ripetitori
+#define RELAY_MAX_HOPS 2           // TTL iniziale
+#define RELAY_DUP_CACHE_SIZE 32    // Frame (nonce d'origine, sequenza) ricordati per scartare i duplicati
+#define RELAY_DUP_WINDOW_MS 1000   // Validità di una voce della cache duplicati
+#define RELAY_HOP_AIRTIME_US 400   // Latenza radio stimata per salto (compensazione arbitraggio)
+#define RELAY_ARBITRATION_US 4000  // Master: finestra in cui raccoglie pressioni ritrasmesse
+
+// ==================== PRESSIONI RIDONDANTI ====================
+// Ogni MSG_BUTTON_PRESSED parte in PRESS_COPIES copie con lo stesso ID di pressione: la prima
+// subito, le altre in punti casuali di PRESS_JITTER_US (una per fetta). Il master tiene la prima.
+#define PRESS_COPIES 3             // 1 = nessuna ridondanza
+#define PRESS_JITTER_US 1500       // Finestra delle copie dopo la prima (max 2550)
+#define PRESS_MAX_COPIES 4         // Massimo provato da "load press" e "press model"
+
+// Aggiornamento firmware via ESP-NOW (master -> slave)
+#define OTA_CHUNK_SIZE 200         // Byte di immagine per frame (max 250 - intestazione)
+#define OTA_WINDOW_CHUNKS 32       // Blocchi per finestra (bitmap NACK a 32 bit)
+#define OTA_OFFER_INTERVAL_MS 250  // Ripetizione offerta e commit
+#define OTA_OFFER_WINDOW_MS 3000   // Raccolta adesioni prima di iniziare
+#define OTA_NACK_TIMEOUT_MS 300    // Attesa dei NACK dopo la fine di una finestra
+#define OTA_MAX_SILENT_ROUNDS 10   // Slave che non risponde per 10 giri viene escluso
+#define OTA_COMMIT_REPEAT 8        // Commit ripetuti (broadcast senza ACK)
+#define OTA_IDLE_TIMEOUT_MS 15000  // Slave: nessun frame OTA, sospende (riprende alla prossima offerta)
+#define OTA_RESTART_DELAY_MS 1000  // Slave: attesa prima del riavvio sulla nuova immagine
+#define OTA_SERIAL_TIMEOUT_MS 5000 // Master: upload via USB interrotto
+
+// Pattern LED programmabili (bytecode distribuito dal master)
+#define PATTERN_MAX_LEN 200        // Byte di programma: sta in un frame ESP-NOW
+#define PATTERN_MAX_LOOPS 4        // Contatori di LOOP per programma
+#define PATTERN_BUDGET 64          // Istruzioni eseguite al massimo per frame
+#define PATTERN_FRAME_MS 20        // Frame successivo se il programma non ha chiesto WAIT
+#define PATTERN_RESEND_MS 10000    // Master: ritrasmette i pattern installati (nuovi arrivati)
+#define PATTERN_FALSE_START_MS 1200  // Durata del pattern di falsa partenza (come i 3 lampeggi)
 
 // Indirizzo broadcast per ESP-NOW (dichiarato extern, definito in main.cpp)
 extern uint8_t broadcastAddress[6];
@@ -67,15 +119,139 @@ enum MessageType {
     MSG_WINNER_ANNOUNCE = 0x05,   // Master -> All: annuncio vincitore
     MSG_HEARTBEAT = 0x06,         // Slave -> Master: keepalive
     MSG_FALSE_START = 0x07,       // Falsa partenza: qualcuno ha premuto troppo presto
-    MSG_MASTER_HEARTBEAT = 0x08   // Master -> All: keepalive durante il gioco
+    MSG_MASTER_HEARTBEAT = 0x08,  // Master -> All: keepalive + snapshot stato (data = stato, slaveId = vincitore)
+    MSG_MASTER_RESUME = 0x09,     // Master -> All: master riavviato, ri-agganciarsi in unicast
+    MSG_SYNC_REQUEST = 0x0A,      // Slave -> Master: richiesta sincronizzazione orologio
+    MSG_SYNC_REPLY = 0x0B,        // Master -> Slave: micros() del master (value)
+    MSG_START_SKEW = 0x0C,        // Slave -> Master: scarto misurato sullo start programmato
+    MSG_REACTION_RESULT = 0x0D,   // Slave -> Master: tempo di reazione in us (value)
+    MSG_STATE_QUERY = 0x0E,       // Slave -> Master: richiesta snapshot (risposta: MASTER_HEARTBEAT unicast)
+    // Aggiornamento firmware: frame a lunghezza variabile (Ota*), non struct Message
+    MSG_OTA_OFFER = 0x0F,         // Master -> All: immagine disponibile (dimensione, SHA-256)
+    MSG_OTA_STATUS = 0x10,        // Slave -> Master: adesione, finestra da cui riprendere, esito
+    MSG_OTA_CHUNK = 0x11,         // Master -> All: blocco di dati dell'immagine
+    MSG_OTA_WINDOW_END = 0x12,    // Master -> All: fine finestra, ogni slave risponde con un NACK
+    MSG_OTA_NACK = 0x13,          // Slave -> Master: bitmap dei blocchi mancanti della finestra
+    MSG_OTA_COMMIT = 0x14,        // Master -> All: verifica hash, cambio partizione e riavvio
+    MSG_PAIR_REQUEST = 0x15,      // Nuovo pulsante -> Master: richiesta ID (value = token casuale)
+    MSG_PAIR_ASSIGN = 0x16,       // Master -> All: ID assegnato (slaveId) al token in value
+    MSG_PATTERN = 0x17            // Master -> All: programma LED per un evento (PatternFrame)
 };
 
+// Flag di trasporto nel campo flags
+#define FRAME_FLAG_BROADCAST 0x01     // Inviato in broadcast (spazio di sequenza broadcast)
+#define FRAME_FLAG_RELAYED 0x02       // Ritrasmesso da un ripetitore
+
+// Flag nel campo data di MSG_START_GAME
+#define START_FLAG_SCHEDULED 0x01     // value = istante di start (micros() del master)
+
 // Struttura messaggio ESP-NOW
 struct Message {
     uint8_t type;           // Tipo di messaggio (MessageType)
     uint8_t slaveId;        // ID dello slave (0-3)
     uint8_t data;           // Dato aggiuntivo
-    uint32_t timestamp;     // Timestamp messaggio
+    uint8_t seq;            // Sequenza per-link (impostata da ESPNowManager)
+    uint16_t epoch;         // Epoca di sessione del master (cambia ad ogni riavvio)
+    uint8_t flags;          // Flag di trasporto (FRAME_FLAG_*)
+    uint8_t roster;         // Snapshot: bitmap slave connessi (bit = ID)
+    uint32_t timestamp;     // Timestamp messaggio (heartbeat master: seme animazione bit 0-7, arena bit 8-15)
+    uint32_t value;         // Valore a 32 bit dipendente dal tipo (es. tempi in micros, ID della pressione)
+    uint16_t round;         // Numero del round corrente sul master
+    uint16_t version;       // Snapshot: versione dello stato master (cresce ad ogni cambio)
+    // Instradamento (impostato da ESPNowManager, usato dai ripetitori)
+    uint16_t originSeq;     // Sequenza del nodo di origine (cache duplicati)
+    uint8_t origin;         // Nodo di origine (NODE_*)
+    uint8_t dest;           // Nodo destinatario (NODE_ALL = tutti)
+    uint8_t ttl;            // Salti residui
+    uint8_t hops;           // Salti effettuati
+    uint16_t relayDelayUs;  // Tempo accumulato nelle code dei ripetitori
+    uint32_t originNonce;   // Casuale ad ogni avvio del nodo di origine (cache duplicati)
+};
+
+// ==================== FRAME OTA ====================
+// Un solo salto, senza intestazione di instradamento. imageId = primi 4 byte dello SHA-256.
+struct __attribute__((packed)) OtaOfferFrame {
+    uint8_t type;
+    uint32_t imageId;
+    uint32_t size;          // Byte dell'immagine
+    uint16_t chunkCount;
+    uint8_t chunkSize;
+    uint8_t windowChunks;
+    uint8_t sha256[32];
+};
+
+// Esiti in OtaStatusFrame.status
+enum OtaStatusCode {
+    OTA_STATUS_ACCEPT,      // Partecipa, riprende da nextWindow
+    OTA_STATUS_UP_TO_DATE,  // Immagine già applicata
+    OTA_STATUS_BUSY,        // Gioco in corso
+    OTA_STATUS_DONE,        // Hash verificato, riavvio sulla nuova immagine
+    OTA_STATUS_FAILED       // Partizione assente/piccola o hash errato
+};
+
+struct __attribute__((packed)) OtaStatusFrame {
+    uint8_t type;
+    uint8_t slaveId;
+    uint32_t imageId;
+    uint16_t nextWindow;
+    uint8_t status;         // OtaStatusCode
+};
+
+struct __attribute__((packed)) OtaChunkFrame {
+    uint8_t type;
+    uint32_t imageId;
+    uint16_t index;
+    uint8_t len;
+    uint8_t data[OTA_CHUNK_SIZE];   // Inviati solo len byte
+};
+
+struct __attribute__((packed)) OtaWindowEndFrame {
+    uint8_t type;
+    uint32_t imageId;
+    uint16_t window;
+};
+
+struct __attribute__((packed)) OtaNackFrame {
+    uint8_t type;
+    uint8_t slaveId;
+    uint32_t imageId;
+    uint16_t window;
+    uint32_t missing;       // Bit i = blocco window * OTA_WINDOW_CHUNKS + i mancante
+};
+
+struct __attribute__((packed)) OtaCommitFrame {
+    uint8_t type;
+    uint32_t imageId;
+};
+
+// ==================== FRAME PATTERN ====================
+// Eventi con un pattern programmabile
+enum PatternSlot {
+    PATTERN_SLOT_START,         // Gioco in corso
+    PATTERN_SLOT_WINNER,        // Vincitore (colore di contesto = colore del vincitore)
+    PATTERN_SLOT_FALSE_START,   // Falsa partenza
+    PATTERN_SLOT_COUNT
+};
+
+// Un solo salto come i frame OTA. len = 0 cancella lo slot (torna l'animazione di firmware)
+struct __attribute__((packed)) PatternFrame {
+    uint8_t type;
+    uint8_t slot;           // PatternSlot
+    uint8_t len;
+    uint8_t code[PATTERN_MAX_LEN];  // Inviati solo len byte
+};
+
+// ID nodo per origin/dest (gli slave usano il proprio SLAVE_ID)
+#define NODE_MASTER 0xFE
+#define NODE_LISTENER 0xFD
+#define NODE_ALL 0xFF
+
+// ==================== RUOLI ====================
+enum DeviceRole {
+    ROLE_MASTER,        // Controller di gioco
+    ROLE_SLAVE,         // Pulsante giocatore
+    ROLE_LISTENER,      // Display passivo: solo ricezione, nessun invio
+    ROLE_HUB            // Tabellone di torneo: ascolta più master, riassunto su USB
 };
 
 // ==================== GAME STATES ====================
@@ -92,11 +268,100 @@ enum GameState {
 #define BUTTON_DEBOUNCE_MS 50         // Debounce pulsante
 #define CONNECTION_CYCLE_MS 500       // Ciclo animazione connessione
 #define GAME_START_DELAY_MS 3000      // Delay prima di start game
+#define SCHEDULED_START true          // Start programmato: tutti diventano verdi nello stesso istante
+#define START_LEAD_US 50000           // Anticipo dello start programmato (50ms)
+#define START_SPIN_US 300             // ...ultimo tratto atteso nel loop (margine sul risveglio dal timer)
+#define SYNC_INTERVAL_MS 1000         // Sync orologio slave -> master ogni 1s
+#define SYNC_FAST_INTERVAL_MS 100     // ...ogni 100ms finché non sincronizzato
+#define WIN_CONFIRM_TIMEOUT_MS 200    // Vincita locale non confermata: richiede lo stato al master
+#define WIN_QUERY_MAX 3               // ...al massimo 3 volte, poi rollback
+#define REACTION_MODE true            // Misura tempo di reazione di ogni giocatore
+#define REACTION_TIMEOUT_MS 3000      // Finestra per raccogliere i tempi di reazione del round
+#define LED_LATCH_US 300              // Reset/latch WS2812B dopo la fine di show()
+#define CALIBRATION_SAMPLES 16        // Campioni per la calibrazione latenze all'avvio
 #define CONNECT_RETRY_MS 2000         // Retry connessione slave ogni 2s
 #define HEARTBEAT_INTERVAL_MS 3000        // Heartbeat slave ogni 3s
 #define HEARTBEAT_TIMEOUT_MS 10000        // Slave disconnesso se nessun heartbeat per 10s
 #define MASTER_HEARTBEAT_INTERVAL_MS 2000 // Heartbeat master -> slave ogni 2s
-#define CHARGE_SAMPLE_INTERVAL_MS 100 // Campionamento pin ricarica ogni 100ms
-#define CHARGE_SAMPLE_COUNT 10        // Numero campioni per decidere stato (1s di finestra)
+#define RESUME_INTERVAL_MS 200        // Master riavviato: ripete il RESUME ogni 200ms
+#define RESUME_WINDOW_MS 6000         // ...finché il roster salvato non si è ri-agganciato (max 6s,
+                                      // > POWER_MASTER_SILENCE_MS + un ciclo: gli slave in sonno lo sentono)
+#define PAIRING_HOLD_MS 3000          // Pulsante tenuto all'avvio: associazione
+#define PAIRING_MASTER_HOLD_MS 8000   // ...tenuto più a lungo: la scheda diventa master
+#define PAIRING_TIMEOUT_MS 60000      // Associazione chiusa dopo 60s
+#define PAIRING_RETRY_MS 500          // Nuovo pulsante: ripete la richiesta di ID
+#define FAST_BOOT true                // Avvio rapido: niente attese seriali, splash LED non bloccante
+#define BOOT_SPLASH_MS 1000           // Durata del colore di avvio
+#define BOOT_BUDGET_MS 300            // Obiettivo accensione -> in gioco (report di avvio)
+#define BOOT_REPORT_TIMEOUT_MS 5000   // Report stampato comunque se non pronto entro 5s
+#define POWER_SAVE true               // Slave inattivi in light sleep tra le finestre di ascolto
+#define POWER_CYCLE_US 262144         // Periodo delle finestre di ascolto in micros() del master (2^18, ~262ms)
+#define POWER_LISTEN_US 32768         // ...di cui radio accesa (2^15, ~33ms). Potenze di 2: reggono il wrap
+#define POWER_REPLY_WAIT_MS 20        // Sveglio dopo ogni frame inviato/ricevuto (risposte del master)
+#define POWER_FRAME_MS 100            // Risveglio per le animazioni LED durante l'attesa
+#define POWER_MIN_SLEEP_US 2000       // Sotto questa durata non conviene dormire
+#define POWER_MASTER_SILENCE_MS 5000  // Master muto da 5s: resta sveglio finché non lo risente
+#define POWER_ACTIVE_UA 80000         // Modello energetico: CPU e radio accese (LED esclusi)
+#define POWER_SLEEP_UA 800            // ...light sleep
+#define BATTERY_CAPACITY_MAH 1000     // Per la stima di autonomia nel report
+#define CHARGE_CHECK_MS 50            // Valutazione stato ricarica (timer, fuori dal loop)
+#define CHARGE_BLINK_TIMEOUT_MS 1500  // Nessun lampeggio da 1.5s: LED fisso (finché il periodo non è misurato)
+#define CHARGE_BLINK_MARGIN_PCT 25    // Con il periodo misurato: fermo dopo un periodo + 25% senza fronti
+#define CHARGE_GLITCH_US 5000         // Fronti più ravvicinati sono disturbi
+
+// ==================== ANIMAZIONE CONDIVISA ====================
+#define AMBIENT_SYNC true             // In attesa tutti i nodi disegnano un'unica onda sul tempo del master
+#define AMBIENT_PERIOD_US 2097152     // Un giro dell'onda (2^21, ~2.1s): potenza di 2, regge il wrap
+
+// ==================== LIMITE DI CORRENTE LED ====================
+// Stima per frame: LED_IDLE_UA per LED + LED_CHANNEL_UA * valore/255 per canale (WS2812B a 5V)
+#define LED_CHANNEL_UA 19000          // Un canale a 255: bianco pieno su 14 LED ~ 810 mA
+#define LED_IDLE_UA 700               // Consumo del driver con LED spento
+#define LED_BUDGET_MA 900             // Con caricatore collegato
+#define LED_BATTERY_BUDGET_MA 600     // A batteria: giallo pieno (~540 mA su 14 LED) resta intatto
+#define LED_LIMIT_RELEASE 4           // Risalita del fattore di scala per frame (/256): niente scatti
+
+// ==================== PROFILER ====================
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED false        // Sezioni a contatore di cicli (comando seriale "prof"), anche da build_flags
+#endif
+
+// ==================== REGISTRATORE DI VOLO ====================
+#define FLIGHT_RECORDER_EVENTS 2048   // Eventi nell'anello (potenza di 2, 8 byte ciascuno)
+#define FLIGHT_BOOT_DUMP_EVENTS 48    // Eventi stampati all'avvio dopo un reset anomalo
+
+// ==================== TRACCE ====================
+#define TRACE_BUFFER_SIZE 16384       // Byte di RAM per la cattura (allocati al primo "trace start")
+#define TRACE_REPLAY_TAIL_MS 500      // Replay: attesa dopo l'ultimo evento prima del confronto
+
+// ==================== HUB DI TORNEO ====================
+#define HUB_MAX_ARENAS 16             // Tavoli seguiti: oltre, si sostituisce il meno recente
+#define HUB_EVENT_QUEUE 32            // Eventi (round, false start, riavvii) in attesa di stampa
+#define HUB_REPORT_MS 5000            // Periodo di tabellone, classifica e statistiche su USB
+#define HUB_ARENA_TIMEOUT_MS 10000    // Tavolo senza frame da così: segnalato offline
+#define HUB_LEADERBOARD_SIZE 8        // Giocatori (tavolo, slave) in classifica
+
+// ==================== BENCHMARK ====================
+// Solo env bench (-D BENCH_MODE)
+#define BENCH_MAX_RESULTS 24          // Benchmark confrontabili con la baseline
+#define BENCH_REPEATS 5               // Ripetizioni per benchmark: si tiene la più veloce
+#define BENCH_REGRESSION_PCT 5        // Scarto dalla baseline segnalato come regressione
+#define BENCH_PATTERN_FRAMES 16       // Frame stampati da "pattern render"
+#define PRESS_MODEL_TRIALS 4000       // "press model": pressioni simultanee simulate per punto
+#define PRESS_MODEL_SPREAD_US 200     // ...premute tutte entro questo intervallo
+#define PRESS_MODEL_LOSS_PCT 2        // ...perdita di ogni frame oltre alle collisioni
+#define PRESS_MODEL_SLOT_US 9         // ...slot di backoff (802.11n, 2.4 GHz)
+#define PRESS_MODEL_DIFS_US 28        // ...attesa dopo canale occupato
+#define PRESS_MODEL_CW 15             // ...finestra di contesa minima (slot)
+
+// ==================== GENERATORE DI CARICO ====================
+// Solo env loadgen (-D LOADGEN_MODE)
+#define LOADGEN_MAX_VIRTUAL 64        // Slave virtuali (oltre MAX_SLAVES il master deve rifiutarli)
+#define LOADGEN_PROBE_MS 20           // Sonda di latenza SYNC_REQUEST -> SYNC_REPLY
+#define LOADGEN_PROBE_TIMEOUT_MS 250  // Sonda senza risposta: persa
+#define LOADGEN_BASELINE_PROBES 16    // Sonde a riposo prima del carico
+#define LOADGEN_CONNECT_RETRY_MS 200  // Tempesta di connessioni: ritentativi degli slave non agganciati
+#define LOADGEN_PRESS_MARGIN_US 5000  // Pressioni dopo il via (oltre START_LEAD_US se programmato)
+#define LOADGEN_REPORT_MS 1000        // Avanzamento durante lo scenario
 
 #endif // CONFIG_H
@@ -2,10 +2,24 @@
 #include "config.h"
 #include "LEDController.h"
 #include "Logger.h"
+#include "ChargeMonitor.h"
+#include "Profiler.h"
+#include "FlightRecorder.h"
 
 #ifndef TEST_MODE
 #include "ESPNowManager.h"
 #include "GameManager.h"
+#include "NvsStore.h"
+#include "OtaManager.h"
+#include "PatternManager.h"
+#include "RtcCheckpoint.h"
+#include "BootReport.h"
+#include "PowerManager.h"
+#include "Bench.h"
+#include "TraceRecorder.h"
+#include "TournamentHub.h"
+#include "LoadGenerator.h"
+#include <esp_system.h>
 #endif
 
 // ==================== GLOBAL VARIABLES ====================
@@ -17,88 +31,37 @@ LEDController leds(LED_PIN, NUM_LEDS);
 
 #ifndef TEST_MODE
 ESPNowManager espNow;
+NvsStore nvsStore;
 GameManager* gameManager = nullptr;
+OtaManager* otaManager = nullptr;
+PatternManager* patternManager = nullptr;
+TournamentHub* hub = nullptr;
+RtcCheckpoint rtcCheckpoint;
+BootReport bootReport;
+PowerManager powerManager;
 #endif
 
 // ==================== BUTTON HANDLING ====================
 volatile bool buttonFlag = false;
+volatile uint32_t buttonPressMicros = 0;  // Primo fronte, per lo start programmato
 unsigned long lastButtonTime = 0;
 
 void IRAM_ATTR buttonISR() {
+    PROFILE_SCOPE(PROF_BUTTON_ISR);
+    if (!buttonFlag) {
+        buttonPressMicros = micros();
+        FlightRecorder::record(FR_BUTTON);
+    }
     buttonFlag = true;
 }
 
 // ==================== CHARGING STATE ====================
-enum ChargeState {
-    CHARGE_NONE,        // Non in ricarica (batteria)
-    CHARGE_CHARGING,    // In carica (verde lampeggia)
-    CHARGE_COMPLETE     // Carica completa (verde fisso)
-};
-
-ChargeState chargeState = CHARGE_NONE;
-unsigned long lastChargeSample = 0;
-uint8_t greenHighCount = 0;     // Quante volte il verde è HIGH negli ultimi campioni
-uint8_t chargeSampleIndex = 0;  // Indice campione corrente
-bool wasCharging = false;        // Per rilevare transizione carica → non carica
-
-// Aggiorna lo stato di ricarica (non bloccante, da chiamare nel loop)
-// Ritorna true se siamo in ricarica (il gioco non deve girare)
-bool updateChargeState() {
-    unsigned long now = millis();
-
-    if (now - lastChargeSample < CHARGE_SAMPLE_INTERVAL_MS) {
-        return chargeState != CHARGE_NONE;
-    }
-    lastChargeSample = now;
-
-    bool greenHigh = digitalRead(CHARGE_PIN_GREEN) == HIGH;
-    bool blueHigh = digitalRead(CHARGE_PIN_BLUE) == HIGH;
-
-    // Aggiorna contatore campioni verde
-    if (chargeSampleIndex < CHARGE_SAMPLE_COUNT) {
-        if (greenHigh) greenHighCount++;
-        chargeSampleIndex++;
-    } else {
-        // Finestra di campionamento completata, determina stato
-        ChargeState newState;
-
-        if (greenHighCount == 0) {
-            // Verde mai alto → non in ricarica
-            newState = CHARGE_NONE;
-        } else if (greenHighCount >= CHARGE_SAMPLE_COUNT) {
-            // Verde sempre alto → carica completa
-            newState = CHARGE_COMPLETE;
-        } else {
-            // Verde a volte alto → lampeggia → in carica
-            newState = CHARGE_CHARGING;
-        }
-
-        if (newState != chargeState) {
-            chargeState = newState;
-            switch (chargeState) {
-                case CHARGE_NONE:
-                    Log.info("Charge: disconnected");
-                    break;
-                case CHARGE_CHARGING:
-                    Log.info("Charge: charging...");
-                    break;
-                case CHARGE_COMPLETE:
-                    Log.info("Charge: complete!");
-                    break;
-            }
-        }
+// Stato del caricatore aggiornato da interrupt e timer: nel loop si legge soltanto
+ChargeMonitor chargeMonitor(CHARGE_PIN_GREEN, CHARGE_PIN_BLUE);
 
-        // Reset finestra
-        greenHighCount = 0;
-        chargeSampleIndex = 0;
-    }
-
-    return chargeState != CHARGE_NONE;
-}
-
-void initChargePins() {
-    pinMode(CHARGE_PIN_GREEN, INPUT);
-    pinMode(CHARGE_PIN_BLUE, INPUT);
+// A batteria il budget di corrente dei LED si stringe (brownout sui picchi)
+void updateLedBudget() {
+    leds.setCurrentBudget(chargeMonitor.isCharging() ? LED_BUDGET_MA : LED_BATTERY_BUDGET_MA);
 }
 
 #ifdef TEST_MODE
@@ -144,8 +107,8 @@ void setup() {
     pinMode(BUTTON_PIN, INPUT_PULLUP);
     attachInterrupt(digitalPinToInterrupt(BUTTON_PIN), buttonISR, FALLING);
 
-    // Inizializza pin ricarica
-    initChargePins();
+    // Inizializza monitor ricarica
+    chargeMonitor.begin();
 
     // 3 lampeggi verdi veloci
     for (int i = 0; i < 3; i++) {
@@ -159,11 +122,13 @@ void setup() {
 }
 
 void loop() {
+    updateLedBudget();
+
     // Controlla stato ricarica
-    if (updateChargeState()) {
-        if (chargeState == CHARGE_CHARGING) {
+    if (chargeMonitor.isCharging()) {
+        if (chargeMonitor.getState() == CHARGE_CHARGING) {
             leds.spinner(COLOR_GREEN, 80);
-        } else if (chargeState == CHARGE_COMPLETE) {
+        } else {
             leds.blink(COLOR_GREEN, 500);
         }
         delay(10);
@@ -199,33 +164,439 @@ void loop() {
     delay(10);
 }
 
+#elif defined(BENCH_MODE)
+// ==================== BENCH MODE ====================
+// Microbenchmark sul dispositivo: CSV sulla seriale, confronto con la baseline in NVS
+
+Bench* bench = nullptr;
+
+void setup() {
+    Serial.begin(115200);
+    delay(2000);  // Tempo per aprire il monitor seriale
+
+    Log.begin(Serial, LOG_INFO);
+    Log.info("\n====================================");
+    Log.info("       PRENOTOMETRO - BENCH MODE");
+    Log.info("====================================\n");
+
+    leds.begin();
+    leds.setColor(COLOR_OFF);
+
+    if (!espNow.begin()) {
+        Log.error("ESP-NOW initialization failed!");
+    }
+
+    bench = new Bench(leds, espNow, nvsStore);
+    bench->runAll();
+    Log.info("Commands: 'bench' (run again), 'bench save' (store as baseline)");
+}
+
+void loop() {
+    bench->poll(Serial);
+    delay(10);
+}
+
+#elif defined(LOADGEN_MODE)
+// ==================== LOADGEN MODE ====================
+// Generatore di carico: slave virtuali contro un master vero (o simulato sulla scheda)
+
+LoadGenerator* loadGen = nullptr;
+
+void setup() {
+    Serial.begin(115200);
+    delay(2000);  // Tempo per aprire il monitor seriale
+
+    Log.begin(Serial, LOG_INFO);
+    Log.info("\n====================================");
+    Log.info("       PRENOTOMETRO - LOADGEN MODE");
+    Log.info("====================================\n");
+
+    leds.begin();
+    leds.setColor(COLOR_OFF);
+
+    if (!espNow.begin()) {
+        Log.error("ESP-NOW initialization failed!");
+    }
+
+    loadGen = new LoadGenerator(leds, espNow);
+    loadGen->begin();
+    Log.info("Commands: 'load connect <n> <s>', 'load hb <n> <hz> <s> [burst]', "
+             "'load press <n> <spread_us> <rounds> [copies]', 'load local <n> <rounds>', 'load stop'");
+}
+
+void loop() {
+    loadGen->poll(Serial);
+    loadGen->update();
+    espNow.update();
+    delay(1);
+}
+
 #else
 // ==================== NORMAL MODE ====================
 
+// Ruolo e ID del dispositivo: dalla NVS (associazione) o dai #define di config.h
+DeviceRole deviceRole = ROLE_SLAVE;
+uint8_t deviceSlaveId = 0;
+bool provisioned = false;
+
+// Associazione di un nuovo pulsante: token casuale e ID ricevuto dal master
+volatile bool pairingActive = false;
+uint32_t pairingToken = 0;
+volatile int16_t pairingAssignedId = -1;
+
+const char* roleName(DeviceRole role) {
+    switch (role) {
+        case ROLE_MASTER:   return "MASTER";
+        case ROLE_LISTENER: return "LISTENER";
+        case ROLE_HUB:      return "HUB";
+        default:            return "SLAVE";
+    }
+}
+
 // ==================== ESP-NOW CALLBACK ====================
 void onMessageReceived(const Message& msg, const uint8_t* macAddr) {
-    if (gameManager != nullptr) {
+    // In associazione conta solo l'ID assegnato al proprio token
+    if (pairingActive) {
+        if (msg.type == MSG_PAIR_ASSIGN && msg.value == pairingToken && msg.slaveId < MAX_SLAVES) {
+            pairingAssignedId = msg.slaveId;
+        }
+        return;
+    }
+
+    if (hub != nullptr) {
+        hub->handleMessage(msg, macAddr);
+    } else if (gameManager != nullptr) {
         gameManager->handleMessage(msg, macAddr);
     }
 }
 
+void onRawFrameReceived(const uint8_t* data, int len, const uint8_t* macAddr) {
+    if (data[0] == MSG_PATTERN) {
+        if (patternManager != nullptr) {
+            patternManager->handleFrame(data, len, macAddr);
+        }
+    } else if (otaManager != nullptr) {
+        otaManager->handleFrame(data, len, macAddr);
+    }
+}
+
+// ==================== COMANDI SERIALI ====================
+char serialLine[16 + PATTERN_MAX_LEN * 2];  // "pattern set <slot> <hex>"
+uint16_t serialLineLen = 0;
+
+// "role": mostra l'identità; "role master|listener|hub|slave <id>|clear": la salva e riavvia
+bool handleRoleCommand(const char* line) {
+    if (strncmp(line, "role", 4) != 0 || (line[4] != ' ' && line[4] != '\0')) return false;
+
+    const char* arg = line + 4;
+    while (*arg == ' ') arg++;
+
+    if (*arg == '\0') {
+        if (provisioned) {
+            Log.info("Role: %s, Slave ID: %d", roleName(deviceRole), deviceSlaveId);
+        } else {
+            Log.info("Role: not provisioned");
+        }
+        return true;
+    }
+
+    if (strcmp(arg, "master") == 0) {
+        nvsStore.saveIdentity(ROLE_MASTER, 0);
+    } else if (strcmp(arg, "listener") == 0) {
+        nvsStore.saveIdentity(ROLE_LISTENER, 0);
+    } else if (strcmp(arg, "hub") == 0) {
+        nvsStore.saveIdentity(ROLE_HUB, 0);
+    } else if (strncmp(arg, "slave ", 6) == 0) {
+        int id = atoi(arg + 6);
+        if (id < 0 || id >= MAX_SLAVES) {
+            Log.warn("Invalid Slave ID: %d", id);
+            return true;
+        }
+        nvsStore.saveIdentity(ROLE_SLAVE, id);
+    } else if (strcmp(arg, "clear") == 0) {
+        nvsStore.clearIdentity();
+    } else {
+        return false;
+    }
+
+    Log.info("Identity saved, restarting...");
+    delay(100);
+    ESP.restart();
+    return true;
+}
+
+// "trace start": la traccia parte dallo stato corrente del gioco (gli altri comandi in TraceRecorder)
+bool handleTraceStart(const char* line) {
+    if (strcmp(line, "trace start") != 0) return false;
+
+    if (gameManager == nullptr) {
+        Log.warn("Trace: game not started");
+        return true;
+    }
+
+    GameCheckpoint startState;
+    gameManager->captureCheckpoint(startState);
+    TraceRecorder::start(startState);
+    return true;
+}
+
+// Master: "arena" mostra l'ID del tavolo, "arena <1-255>" lo salva (annunciato negli heartbeat)
+bool handleArenaCommand(const char* line) {
+    if (strncmp(line, "arena", 5) != 0 || (line[5] != ' ' && line[5] != '\0')) return false;
+
+    if (deviceRole != ROLE_MASTER || gameManager == nullptr) {
+        Log.warn("Arena: master only");
+        return true;
+    }
+
+    const char* arg = line + 5;
+    while (*arg == ' ') arg++;
+    if (*arg != '\0') {
+        int arenaId = atoi(arg);
+        if (arenaId < 1 || arenaId > 255) {
+            Log.warn("Invalid arena ID: %s", arg);
+            return true;
+        }
+        nvsStore.saveArenaId(arenaId);
+        gameManager->setArenaId(arenaId);
+    }
+    Log.info("Arena: %d", gameManager->getArenaId());
+    return true;
+}
+
+void pollSerialCommands() {
+    PROFILE_SCOPE(PROF_SERIAL_POLL);
+
+    // Upload firmware in corso: i byte sono l'immagine, non comandi
+    if (otaManager != nullptr && otaManager->isReceivingUpload()) {
+        otaManager->receiveUpload(Serial);
+        return;
+    }
+
+    while (Serial.available() > 0) {
+        int c = Serial.read();
+        if (c == '\r') continue;
+        if (c != '\n') {
+            if (serialLineLen < sizeof(serialLine) - 1) serialLine[serialLineLen++] = c;
+            continue;
+        }
+
+        serialLine[serialLineLen] = '\0';
+        serialLineLen = 0;
+        if (serialLine[0] == '\0') continue;
+
+        bool handled = handleRoleCommand(serialLine) ||
+                       handleArenaCommand(serialLine) ||
+                       (hub != nullptr && hub->handleCommand(serialLine)) ||
+                       powerManager.handleCommand(serialLine) ||
+                       chargeMonitor.handleCommand(serialLine) ||
+                       leds.handleCommand(serialLine) ||
+                       Profiler::handleCommand(serialLine) ||
+                       FlightRecorder::handleCommand(serialLine) ||
+                       handleTraceStart(serialLine) ||
+                       TraceRecorder::handleCommand(serialLine) ||
+                       (patternManager != nullptr && patternManager->handleCommand(serialLine)) ||
+                       (otaManager != nullptr && otaManager->handleCommand(serialLine));
+        if (!handled) {
+            Log.warn("Unknown command: %s", serialLine);
+        }
+        if (otaManager != nullptr && otaManager->isReceivingUpload()) return;
+    }
+}
+
+// ==================== CALIBRAZIONE LATENZE ====================
+// Latenza fissa fronte GPIO -> timestamp nella ISR. Il pin del pulsante viene
+// pilotato in open-drain (sicuro anche con pulsante premuto) per generare il fronte.
+uint32_t measureIsrLatency(uint8_t samples) {
+    uint32_t best = UINT32_MAX;
+
+    pinMode(BUTTON_PIN, OUTPUT_OPEN_DRAIN | PULLUP);
+    digitalWrite(BUTTON_PIN, HIGH);
+    attachInterrupt(digitalPinToInterrupt(BUTTON_PIN), buttonISR, FALLING);
+
+    for (uint8_t i = 0; i < samples; i++) {
+        digitalWrite(BUTTON_PIN, HIGH);
+        delayMicroseconds(100);
+        buttonFlag = false;
+
+        uint32_t start = micros();
+        digitalWrite(BUTTON_PIN, LOW);
+        while (!buttonFlag && micros() - start < 1000) {
+        }
+
+        if (buttonFlag) {
+            uint32_t latency = buttonPressMicros - start;
+            if (latency < best) best = latency;
+        }
+    }
+
+    // Ripristina il pulsante
+    digitalWrite(BUTTON_PIN, HIGH);
+    pinMode(BUTTON_PIN, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(BUTTON_PIN), buttonISR, FALLING);
+    delayMicroseconds(100);
+    buttonFlag = false;
+
+    return best == UINT32_MAX ? 0 : best;
+}
+
+// ==================== ASSOCIAZIONE ====================
+void loadIdentity() {
+    if (!ROLE_FROM_NVS) {
+        deviceRole = IS_LISTENER ? ROLE_LISTENER : (IS_MASTER ? ROLE_MASTER : ROLE_SLAVE);
+        deviceSlaveId = SLAVE_ID;
+        provisioned = true;
+        return;
+    }
+    provisioned = nvsStore.loadIdentity(deviceRole, deviceSlaveId);
+}
+
+// Durata della pressione del pulsante all'avvio, con feedback sulle soglie
+unsigned long measureBootHold() {
+    if (digitalRead(BUTTON_PIN) != LOW) return 0;
+
+    unsigned long start = millis();
+    unsigned long held = 0;
+    bool pairingShown = false;
+
+    while (digitalRead(BUTTON_PIN) == LOW && held < PAIRING_MASTER_HOLD_MS) {
+        held = millis() - start;
+        if (held >= PAIRING_HOLD_MS && !pairingShown) {
+            leds.setColor(COLOR_WHITE);
+            pairingShown = true;
+        }
+        delay(10);
+    }
+
+    if (held >= PAIRING_MASTER_HOLD_MS) {
+        leds.setColor(COLOR_BLUE);
+    }
+    return held;
+}
+
+// Nuovo pulsante: alla pressione chiede un ID al master (che assegna in ordine di pressione),
+// lo salva e riavvia. Ritorna solo se la scheda ha già un'identità e il tempo scade.
+void runPairing() {
+    pairingToken = esp_random();
+    pairingAssignedId = -1;
+    pairingActive = true;
+
+    Log.info("Pairing: press the button to get an ID from the master");
+
+    unsigned long start = millis();
+    unsigned long lastRequest = 0;
+    bool requested = false;
+    buttonFlag = false;
+
+    while (pairingAssignedId < 0) {
+        unsigned long now = millis();
+
+        if (buttonFlag) {
+            buttonFlag = false;
+            if (!requested) Log.info("Pairing: requesting ID...");
+            requested = true;
+        }
+
+        if (requested && now - lastRequest >= PAIRING_RETRY_MS) {
+            lastRequest = now;
+            Message msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.type = MSG_PAIR_REQUEST;
+            msg.slaveId = 0xFF;
+            msg.value = pairingToken;
+            msg.dest = NODE_MASTER;
+            espNow.sendMessage(msg);
+        }
+
+        if (requested) {
+            leds.blink(COLOR_WHITE, 150);
+        } else {
+            leds.pulse(COLOR_WHITE, 2000);
+        }
+
+        pollSerialCommands();
+        espNow.update();
+
+        if (provisioned && now - start > PAIRING_TIMEOUT_MS) {
+            Log.warn("Pairing timed out, keeping current identity");
+            pairingActive = false;
+            leds.setColor(COLOR_OFF);
+            return;
+        }
+        delay(10);
+    }
+
+    pairingActive = false;
+    deviceSlaveId = pairingAssignedId;
+    nvsStore.saveIdentity(ROLE_SLAVE, deviceSlaveId);
+    Log.info("Pairing: got Slave ID %d, restarting", deviceSlaveId);
+
+    leds.setColor(SLAVE_COLORS[deviceSlaveId]);
+    delay(1000);
+    ESP.restart();
+}
+
 // ==================== SETUP ====================
 void setup() {
     Serial.begin(115200);
-    delay(500);
+
+    // Reset anomalo con checkpoint valido: si salta tutto ciò che è solo estetico
+    bool warmBoot = rtcCheckpoint.begin();
+    bool crashed = FlightRecorder::begin();
+    if (!warmBoot && !FAST_BOOT) {
+        delay(500);
+    }
+    bootReport.mark("serial");
 
     // Inizializza Logger
     Log.begin(Serial, LOG_INFO);  // LOG_DEBUG per più dettagli
+    Log.info("Reset reason: %s%s", rtcCheckpoint.getResetReasonName(),
+             warmBoot ? " (fast recovery)" : "");
+    if (crashed) {
+        // Ultimi eventi prima del crash: il resto con "flight dump"
+        FlightRecorder::dump(FLIGHT_BOOT_DUMP_EVENTS);
+    }
+
+    // Inizializza LED
+    Log.info("Initializing LEDs...");
+    leds.begin();
+    leds.setColor(COLOR_OFF);
+
+    // Inizializza pulsante
+    Log.info("Initializing button...");
+    pinMode(BUTTON_PIN, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(BUTTON_PIN), buttonISR, FALLING);
+    bootReport.mark("leds+button");
+
+    // Identità dalla NVS; pulsante tenuto all'avvio: associazione (o diventa master)
+    loadIdentity();
+    unsigned long bootHold = warmBoot ? 0 : measureBootHold();
+    bool masterPairing = false;
+    if (bootHold >= PAIRING_MASTER_HOLD_MS) {
+        deviceRole = ROLE_MASTER;
+        deviceSlaveId = 0;
+        provisioned = true;
+        nvsStore.saveIdentity(deviceRole, deviceSlaveId);
+        masterPairing = true;
+    } else if (bootHold >= PAIRING_HOLD_MS && provisioned && deviceRole == ROLE_MASTER) {
+        masterPairing = true;
+    }
+    bool joinPairing = !provisioned || (bootHold >= PAIRING_HOLD_MS && !masterPairing);
+    bootReport.mark("identity");
 
     Log.info("\n====================================");
     Log.info("       PRENOTOMETRO v1.0");
     Log.info("====================================");
-    Log.info("Device Mode: %s", IS_MASTER ? "MASTER" : "SLAVE");
+    if (!provisioned) {
+        Log.info("Device Mode: NOT PROVISIONED");
+    } else {
+        Log.info("Device Mode: %s", roleName(deviceRole));
+    }
 
-    if (!IS_MASTER) {
-        Log.info("Slave ID: %d", SLAVE_ID);
+    if (provisioned && deviceRole == ROLE_SLAVE) {
+        Log.info("Slave ID: %d", deviceSlaveId);
         const char* colorName;
-        switch (SLAVE_ID) {
+        switch (deviceSlaveId) {
             case 0: colorName = "YELLOW"; break;
             case 1: colorName = "GREEN"; break;
             case 2: colorName = "BLUE"; break;
@@ -237,20 +608,6 @@ void setup() {
 
     Log.info("====================================\n");
 
-    // Inizializza LED
-    Log.info("Initializing LEDs...");
-    leds.begin();
-    leds.setColor(COLOR_OFF);
-
-    // Inizializza pulsante
-    Log.info("Initializing button...");
-    pinMode(BUTTON_PIN, INPUT_PULLUP);
-    attachInterrupt(digitalPinToInterrupt(BUTTON_PIN), buttonISR, FALLING);
-
-    // Inizializza pin ricarica
-    Log.info("Initializing charge pins...");
-    initChargePins();
-
     // Inizializza ESP-NOW
     Log.info("Initializing ESP-NOW...");
     if (!espNow.begin()) {
@@ -263,29 +620,120 @@ void setup() {
 
     // Registra callback ESP-NOW
     espNow.setMessageCallback(onMessageReceived);
+    espNow.setRelay(RELAY_MODE && IS_RELAY);
+    espNow.setRawCallback(onRawFrameReceived);
+    bootReport.mark("espnow");
 
-    // Crea GameManager
+    // Nuovo pulsante (o riassociazione): non torna se riceve un ID
+    if (joinPairing) {
+        runPairing();
+    }
+
+    // Hub di torneo: solo ascolto e report su USB, niente gioco, pattern né OTA
+    if (deviceRole == ROLE_HUB) {
+        hub = new TournamentHub(espNow);
+        hub->begin();
+        Log.info("\n=== SETUP COMPLETE ===\n");
+        bootReport.mark("setup");
+        return;
+    }
+
+    // Pattern LED: il master li ricarica da NVS, gli altri li ricevono via radio
+    patternManager = new PatternManager(espNow, nvsStore, deviceRole);
+    patternManager->begin();
+
+    // Crea GameManager: lo slave manda subito il primo CONNECT_REQUEST
     Log.info("Initializing GameManager...");
-    gameManager = new GameManager(leds, espNow, IS_MASTER, SLAVE_ID);
+    gameManager = new GameManager(leds, espNow, nvsStore, deviceRole, deviceSlaveId);
+    gameManager->setCheckpoint(&rtcCheckpoint);
+    gameManager->setPatterns(patternManager);
+    patternManager->setGame(gameManager);
+    if (deviceRole == ROLE_MASTER) {
+        gameManager->setArenaId(nvsStore.loadArenaId());
+    }
     gameManager->begin();
+    if (masterPairing) {
+        gameManager->openPairing();
+    }
+    bootReport.mark("game");
+
+    // Dopo la radio: l'ACK del master arriva mentre si completa il resto
+    Log.info("Initializing charge monitor...");
+    chargeMonitor.begin();
+
+    // Calibra la latenza ISR per il tempo di reazione
+    if (REACTION_MODE) {
+        Log.info("Calibrating latencies...");
+        gameManager->setLatencyCalibration(measureIsrLatency(CALIBRATION_SAMPLES));
+    }
+    bootReport.mark("calibration");
+
+    otaManager = new OtaManager(espNow, nvsStore, deviceRole, deviceSlaveId);
+    otaManager->setGame(gameManager);
+    powerManager.begin(BUTTON_PIN, buttonISR);
 
     Log.info("\n=== SETUP COMPLETE ===\n");
+    bootReport.mark("setup");
 
-    // Test LED iniziale
-    leds.setColor(IS_MASTER ? COLOR_BLUE : SLAVE_COLORS[SLAVE_ID]);
-    delay(1000);
-    leds.setColor(COLOR_OFF);
+    if (warmBoot) {
+        return;
+    }
+
+    // Test LED iniziale: con FAST_BOOT gira mentre il gioco è già attivo
+    uint32_t splashColor;
+    switch (deviceRole) {
+        case ROLE_MASTER:   splashColor = COLOR_BLUE; break;
+        case ROLE_LISTENER: splashColor = COLOR_PINK; break;
+        default:            splashColor = SLAVE_COLORS[deviceSlaveId]; break;
+    }
+    if (FAST_BOOT) {
+        leds.splash(splashColor, BOOT_SPLASH_MS);
+    } else {
+        leds.setColor(splashColor);
+        delay(BOOT_SPLASH_MS);
+        leds.setColor(COLOR_OFF);
+    }
 }
 
 // ==================== LOOP ====================
 void loop() {
+    PROFILE_SCOPE(PROF_LOOP);
+
+    if (hub != nullptr) {
+        pollSerialCommands();
+        hub->update();
+        espNow.update();
+        if (!bootReport.isPrinted()) {
+            bootReport.mark("ready");
+            bootReport.print(true);
+        }
+        leds.pulse(COLOR_PINK, 3000);
+        PROFILE_STOP();
+        delay(1);
+        return;
+    }
+
+    // Aggiornamento firmware: ha la precedenza su gioco e ricarica
+    pollSerialCommands();
+    otaManager->update(gameManager->getState() != STATE_GAME_RUNNING);
+    if (otaManager->isActive()) {
+        buttonFlag = false;
+        leds.spinner(COLOR_BLUE, 60);
+        espNow.update();
+        PROFILE_STOP();
+        delay(1);
+        return;
+    }
+
     // Controlla stato ricarica
-    if (updateChargeState()) {
-        if (chargeState == CHARGE_CHARGING) {
+    updateLedBudget();
+    if (chargeMonitor.isCharging()) {
+        if (chargeMonitor.getState() == CHARGE_CHARGING) {
             leds.spinner(COLOR_GREEN, 80);
-        } else if (chargeState == CHARGE_COMPLETE) {
+        } else {
             leds.blink(COLOR_GREEN, 500);
         }
+        PROFILE_STOP();
         delay(10);
         return;  // Non eseguire logica gioco durante la ricarica
     }
@@ -297,18 +745,53 @@ void loop() {
 
         // Debounce software aggiuntivo
         if (now - lastButtonTime > BUTTON_DEBOUNCE_MS) {
+            PROFILE_SCOPE(PROF_PRESS);
             lastButtonTime = now;
+            TraceRecorder::recordButton(buttonPressMicros);
             gameManager->handleButtonPress();
         }
     }
 
+    // Riprende la coda di invio ESP-NOW se bloccata
+    espNow.update();
+    patternManager->update();
+
     // Aggiorna game manager
     if (gameManager != nullptr) {
         gameManager->update();
     }
 
-    // Piccolo delay per non saturare la CPU
-    delay(10);
+    // Report di avvio: appena in gioco (slave agganciato), o comunque dopo il timeout
+    if (!bootReport.isPrinted()) {
+        if (gameManager->isReady()) {
+            bootReport.mark("ready");
+            bootReport.print(true);
+        } else if (millis() > BOOT_REPORT_TIMEOUT_MS) {
+            bootReport.mark("timeout");
+            bootReport.print(false);
+        }
+    }
+
+    // Slave inattivo: light sleep fino alla prossima finestra di ascolto o evento.
+    // Con la console USB collegata resta sveglio (il light sleep la interrompe), e anche
+    // mentre i LED del caricatore cambiano: in sonno le loro ISR non vedono i fronti.
+    uint32_t sleepUs = 0;
+    bool idle = !buttonFlag && !Serial && gameManager->canSleep(sleepUs) &&
+                espNow.isRadioIdle(POWER_REPLY_WAIT_MS) && !leds.isSplashing() &&
+                chargeMonitor.isSettled();
+    PROFILE_STOP();
+    if (powerManager.update(idle, sleepUs)) {
+        // Svegliato dal pulsante: l'interrupt a fronte era staccato
+        if (!buttonFlag) {
+            buttonPressMicros = micros();
+            buttonFlag = true;
+        }
+        return;
+    }
+
+    // Piccola attesa per non saturare la CPU (breve da inattivo: si torna subito a dormire).
+    // Come delay(), ma il timer dello start programmato la interrompe.
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(idle ? 1 : 10));
 }
 
 #endif // TEST_MODE
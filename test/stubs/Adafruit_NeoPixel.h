@@ -0,0 +1,53 @@
+#ifndef HOST_ADAFRUIT_NEOPIXEL_H
+#define HOST_ADAFRUIT_NEOPIXEL_H
+
+// Striscia finta per l'env native: i pixel restano in memoria, show() li conta soltanto
+
+#include <Arduino.h>
+#include <vector>
+
+#define NEO_GRB 0x52
+#define NEO_KHZ800 0x0000
+
+class Adafruit_NeoPixel {
+public:
+    uint32_t showCount = 0;
+
+    Adafruit_NeoPixel(uint16_t n, int16_t, uint16_t) : pixels(n * 3, 0), brightness(255) {}
+
+    void begin() {}
+    void show() { showCount++; }
+    void setBrightness(uint8_t b) { brightness = b; }
+    uint8_t getBrightness() const { return brightness; }
+    void clear() { std::fill(pixels.begin(), pixels.end(), 0); }
+    uint16_t numPixels() const { return (uint16_t)(pixels.size() / 3); }
+    uint8_t* getPixels() { return pixels.data(); }
+
+    void setPixelColor(uint16_t i, uint8_t r, uint8_t g, uint8_t b) {
+        if (i >= numPixels()) return;
+        pixels[i * 3] = g;
+        pixels[i * 3 + 1] = r;
+        pixels[i * 3 + 2] = b;
+    }
+    void setPixelColor(uint16_t i, uint32_t c) {
+        setPixelColor(i, (uint8_t)(c >> 16), (uint8_t)(c >> 8), (uint8_t)c);
+    }
+    uint32_t getPixelColor(uint16_t i) const {
+        if (i >= numPixels()) return 0;
+        return ((uint32_t)pixels[i * 3 + 1] << 16) | ((uint32_t)pixels[i * 3] << 8) | pixels[i * 3 + 2];
+    }
+
+    static uint32_t Color(uint8_t r, uint8_t g, uint8_t b) {
+        return ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
+    }
+    // Tinta grezza: ai test serve solo un colore diverso da zero
+    static uint32_t ColorHSV(uint16_t hue, uint8_t = 255, uint8_t = 255) {
+        return Color(hue >> 8, 255 - (hue >> 8), 128);
+    }
+
+private:
+    std::vector<uint8_t> pixels;
+    uint8_t brightness;
+};
+
+#endif // HOST_ADAFRUIT_NEOPIXEL_H
@@ -0,0 +1,143 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// Arduino minimo per l'env native: tempo simulato, Serial su stringa, sezioni critiche
+// vuote (un solo thread). Basta per compilare i moduli di sola logica e i loro test.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include <string>
+// Prima delle macro min/max, come fa il core vero
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+#define __NOINIT_ATTR
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define RISING 1
+#define FALLING 2
+#define CHANGE 3
+
+#define PI 3.1415926535897932384626433832795
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+
+// Sezioni critiche: i test girano su un solo thread
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(m) (void)(m)
+#define portEXIT_CRITICAL(m) (void)(m)
+#define portENTER_CRITICAL_ISR(m) (void)(m)
+#define portEXIT_CRITICAL_ISR(m) (void)(m)
+#define portENTER_CRITICAL_SAFE(m) (void)(m)
+#define portEXIT_CRITICAL_SAFE(m) (void)(m)
+
+// Tempo simulato: avanza solo quando il test lo chiede
+inline uint64_t hostMicros = 0;
+inline void hostAdvanceUs(uint64_t us) { hostMicros += us; }
+inline void hostAdvanceMs(uint64_t ms) { hostMicros += ms * 1000; }
+
+inline unsigned long micros() { return (unsigned long)(uint32_t)hostMicros; }
+inline unsigned long millis() { return (unsigned long)(uint32_t)(hostMicros / 1000); }
+inline void delay(unsigned long ms) { hostAdvanceMs(ms); }
+inline void delayMicroseconds(unsigned int us) { hostAdvanceUs(us); }
+
+// GPIO: livello fisso HIGH (pulsante rilasciato)
+inline void pinMode(uint8_t, uint8_t) {}
+inline int digitalRead(uint8_t) { return HIGH; }
+inline void digitalWrite(uint8_t, uint8_t) {}
+inline int digitalPinToInterrupt(int pin) { return pin; }
+inline void attachInterrupt(int, void (*)(), int) {}
+inline void detachInterrupt(int) {}
+
+// Task FreeRTOS: un solo task, le notifiche non hanno nessuno da svegliare
+typedef void* TaskHandle_t;
+#define pdTRUE 1
+#define pdMS_TO_TICKS(ms) (ms)
+inline TaskHandle_t xTaskGetCurrentTaskHandle() { return nullptr; }
+inline void xTaskNotifyGive(TaskHandle_t) {}
+inline uint32_t ulTaskNotifyTake(int, uint32_t ticks) {
+    hostAdvanceMs(ticks);
+    return 0;
+}
+
+class String {
+public:
+    String(const char* s = "") : value(s) {}
+    const char* c_str() const { return value.c_str(); }
+
+private:
+    std::string value;
+};
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* data, size_t len) {
+        for (size_t i = 0; i < len; i++) write(data[i]);
+        return len;
+    }
+    size_t print(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+    size_t println(const char* s = "") { return print(s) + print("\n"); }
+    size_t printf(const char* fmt, ...) {
+        char buf[512];
+        va_list args;
+        va_start(args, fmt);
+        vsnprintf(buf, sizeof(buf), fmt, args);
+        va_end(args);
+        return print(buf);
+    }
+};
+
+class Stream : public Print {
+public:
+    virtual int available() { return 0; }
+    virtual int read() { return -1; }
+};
+
+// Serial: l'uscita resta in output, i test la leggono e la svuotano
+class HostSerial : public Stream {
+public:
+    std::string output;
+
+    size_t write(uint8_t c) override {
+        output += (char)c;
+        return 1;
+    }
+    void begin(unsigned long) {}
+    explicit operator bool() const { return false; }
+};
+
+inline HostSerial Serial;
+
+class EspClass {
+public:
+    uint32_t getCycleCount() { return (uint32_t)(hostMicros * 240); }
+    uint32_t getCpuFreqMHz() { return 240; }
+    uint32_t getFreeHeap() { return 0; }
+    void restart() {}
+};
+
+inline EspClass ESP;
+
+#endif // HOST_ARDUINO_H
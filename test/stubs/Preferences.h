@@ -0,0 +1,70 @@
+#ifndef HOST_PREFERENCES_H
+#define HOST_PREFERENCES_H
+
+// NVS finta per l'env native: namespace e chiavi in una mappa, persa a fine processo
+
+#include <Arduino.h>
+#include <map>
+#include <vector>
+
+class Preferences {
+public:
+    bool begin(const char* name, bool readOnly = false) {
+        ns = name;
+        return true;
+    }
+    void end() {}
+    bool clear() {
+        store()[ns].clear();
+        return true;
+    }
+    bool remove(const char* key) { return store()[ns].erase(key) > 0; }
+    bool isKey(const char* key) { return store()[ns].count(key) > 0; }
+
+    size_t putBytes(const char* key, const void* value, size_t len) {
+        const uint8_t* bytes = (const uint8_t*)value;
+        store()[ns][key] = std::vector<uint8_t>(bytes, bytes + len);
+        return len;
+    }
+    size_t getBytes(const char* key, void* buf, size_t maxLen) {
+        auto& keys = store()[ns];
+        auto it = keys.find(key);
+        if (it == keys.end() || it->second.size() > maxLen) return 0;
+        memcpy(buf, it->second.data(), it->second.size());
+        return it->second.size();
+    }
+    size_t getBytesLength(const char* key) {
+        auto& keys = store()[ns];
+        auto it = keys.find(key);
+        return it == keys.end() ? 0 : it->second.size();
+    }
+
+    size_t putUChar(const char* key, uint8_t v) { return putBytes(key, &v, sizeof(v)); }
+    size_t putUShort(const char* key, uint16_t v) { return putBytes(key, &v, sizeof(v)); }
+    size_t putULong(const char* key, uint32_t v) { return putBytes(key, &v, sizeof(v)); }
+    size_t putBool(const char* key, bool v) { return putBytes(key, &v, sizeof(v)); }
+    uint8_t getUChar(const char* key, uint8_t def = 0) { return get(key, def); }
+    uint16_t getUShort(const char* key, uint16_t def = 0) { return get(key, def); }
+    uint32_t getULong(const char* key, uint32_t def = 0) { return get(key, def); }
+    bool getBool(const char* key, bool def = false) { return get(key, def); }
+
+    // Azzera tutti i namespace (tra un test e l'altro)
+    static void hostReset() { store().clear(); }
+
+private:
+    std::string ns;
+
+    typedef std::map<std::string, std::map<std::string, std::vector<uint8_t>>> Store;
+    static Store& store() {
+        static Store s;
+        return s;
+    }
+
+    template <typename T>
+    T get(const char* key, T def) {
+        T v;
+        return getBytes(key, &v, sizeof(v)) == sizeof(v) ? v : def;
+    }
+};
+
+#endif // HOST_PREFERENCES_H
@@ -0,0 +1,21 @@
+#ifndef HOST_WIFI_H
+#define HOST_WIFI_H
+
+#include <Arduino.h>
+
+#define WIFI_STA 1
+
+class WiFiClass {
+public:
+    bool mode(int) { return true; }
+    String macAddress() { return String("02:00:00:00:00:01"); }
+    uint8_t* macAddress(uint8_t* mac) {
+        static const uint8_t HOST_MAC[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+        memcpy(mac, HOST_MAC, 6);
+        return mac;
+    }
+};
+
+inline WiFiClass WiFi;
+
+#endif // HOST_WIFI_H
@@ -0,0 +1,41 @@
+#ifndef HOST_ESP_NOW_H
+#define HOST_ESP_NOW_H
+
+#include <Arduino.h>
+#include <esp_wifi.h>
+
+// Radio finta: gli invii riescono e non arrivano da nessuna parte
+#define ESP_NOW_MAX_DATA_LEN 250
+#define ESP_ERR_ESPNOW_BASE 0x3066
+#define ESP_ERR_ESPNOW_NO_MEM (ESP_ERR_ESPNOW_BASE + 3)
+#define ESP_ERR_ESPNOW_EXIST (ESP_ERR_ESPNOW_BASE + 7)
+
+typedef enum { ESP_NOW_SEND_SUCCESS = 0, ESP_NOW_SEND_FAIL } esp_now_send_status_t;
+
+typedef struct {
+    uint8_t peer_addr[6];
+    uint8_t channel;
+    bool encrypt;
+} esp_now_peer_info_t;
+
+typedef struct {
+    int total_num;
+    int encrypt_num;
+} esp_now_peer_num_t;
+
+typedef void (*esp_now_recv_cb_t)(const uint8_t* mac, const uint8_t* data, int len);
+typedef void (*esp_now_send_cb_t)(const uint8_t* mac, esp_now_send_status_t status);
+
+inline esp_err_t esp_now_init() { return ESP_OK; }
+inline esp_err_t esp_now_register_recv_cb(esp_now_recv_cb_t) { return ESP_OK; }
+inline esp_err_t esp_now_register_send_cb(esp_now_send_cb_t) { return ESP_OK; }
+inline esp_err_t esp_now_add_peer(const esp_now_peer_info_t*) { return ESP_OK; }
+inline esp_err_t esp_now_del_peer(const uint8_t*) { return ESP_OK; }
+inline esp_err_t esp_now_send(const uint8_t*, const uint8_t*, size_t) { return ESP_OK; }
+inline esp_err_t esp_now_get_peer_num(esp_now_peer_num_t* num) {
+    num->total_num = 0;
+    num->encrypt_num = 0;
+    return ESP_OK;
+}
+
+#endif // HOST_ESP_NOW_H
@@ -0,0 +1,31 @@
+#ifndef HOST_ESP_SYSTEM_H
+#define HOST_ESP_SYSTEM_H
+
+#include <stdint.h>
+
+typedef enum {
+    ESP_RST_UNKNOWN,
+    ESP_RST_POWERON,
+    ESP_RST_EXT,
+    ESP_RST_SW,
+    ESP_RST_PANIC,
+    ESP_RST_INT_WDT,
+    ESP_RST_TASK_WDT,
+    ESP_RST_WDT,
+    ESP_RST_DEEPSLEEP,
+    ESP_RST_BROWNOUT,
+    ESP_RST_SDIO
+} esp_reset_reason_t;
+
+// Sequenza fissa: test ripetibili
+inline uint32_t hostRandomState = 0x12345678;
+inline uint32_t esp_random() {
+    hostRandomState ^= hostRandomState << 13;
+    hostRandomState ^= hostRandomState >> 17;
+    hostRandomState ^= hostRandomState << 5;
+    return hostRandomState;
+}
+
+inline esp_reset_reason_t esp_reset_reason() { return ESP_RST_POWERON; }
+
+#endif // HOST_ESP_SYSTEM_H
@@ -0,0 +1,71 @@
+#include <unity.h>
+#include "ClockSync.h"
+#include "tests.h"
+
+static void test_reply_sets_offset() {
+    ClockSync sync;
+    TEST_ASSERT_FALSE(sync.isSynced());
+
+    // Master avanti di 1000000: risposta a metà di un RTT di 400us
+    uint8_t seq = sync.beginRequest(5000);
+    sync.onReply(seq, 1005200, 5400);
+
+    TEST_ASSERT_TRUE(sync.isSynced());
+    TEST_ASSERT_EQUAL_UINT32(400, sync.bestRtt());
+    TEST_ASSERT_EQUAL_UINT32(1007000, sync.toMaster(7000));
+    TEST_ASSERT_EQUAL_UINT32(7000, sync.toLocal(1007000));
+}
+
+static void test_stale_and_slow_replies_ignored() {
+    ClockSync sync;
+    uint8_t old = sync.beginRequest(0);
+    uint8_t seq = sync.beginRequest(100);
+    sync.onReply(old, 999, 200);
+    TEST_ASSERT_FALSE(sync.isSynced());
+
+    sync.onReply(seq, 999, 100 + 20001);
+    TEST_ASSERT_FALSE(sync.isSynced());
+
+    // Già consumata: una seconda risposta non conta
+    sync.onReply(seq, 999, 200);
+    TEST_ASSERT_FALSE(sync.isSynced());
+}
+
+static void test_minimum_rtt_sample_wins() {
+    ClockSync sync;
+    uint8_t seq = sync.beginRequest(0);
+    sync.onReply(seq, 10100, 200);          // RTT 200, offset 10000
+    seq = sync.beginRequest(1000);
+    sync.onReply(seq, 12000, 2000);         // RTT 1000, offset 10500
+
+    TEST_ASSERT_EQUAL_UINT32(200, sync.bestRtt());
+    TEST_ASSERT_EQUAL_UINT32(10000, sync.toMaster(0));
+}
+
+static void test_wraps_modulo_2_32() {
+    ClockSync sync;
+    uint32_t t0 = UINT32_MAX - 100;
+    uint8_t seq = sync.beginRequest(t0);
+    sync.onReply(seq, 50, t0 + 200);        // RTT 200 a cavallo del wrap
+
+    TEST_ASSERT_EQUAL_UINT32(200, sync.bestRtt());
+    TEST_ASSERT_EQUAL_UINT32(50, sync.toMaster(t0 + 100));
+}
+
+static void test_beacon_keeps_max_offset() {
+    ClockSync sync;
+    sync.onBeacon(10500, 0);                // Arrivato in ritardo: offset sottostimato
+    sync.onBeacon(20900, 10000);
+    sync.onBeacon(30700, 20000);
+
+    TEST_ASSERT_TRUE(sync.isSynced());
+    TEST_ASSERT_EQUAL_UINT32(10900, sync.toMaster(0));
+}
+
+void runClockSyncTests() {
+    RUN_TEST(test_reply_sets_offset);
+    RUN_TEST(test_stale_and_slow_replies_ignored);
+    RUN_TEST(test_minimum_rtt_sample_wins);
+    RUN_TEST(test_wraps_modulo_2_32);
+    RUN_TEST(test_beacon_keeps_max_offset);
+}
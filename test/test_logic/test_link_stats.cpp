@@ -0,0 +1,93 @@
+#include <unity.h>
+#include "LinkStats.h"
+#include "tests.h"
+
+static const uint8_t PEER_A[6] = {0x02, 0, 0, 0, 0, 0xA0};
+static const uint8_t PEER_B[6] = {0x02, 0, 0, 0, 0, 0xB0};
+
+static void test_tx_sequence_per_destination() {
+    LinkStats stats;
+    TEST_ASSERT_EQUAL_UINT8(0, stats.nextTxSeq(PEER_A));
+    TEST_ASSERT_EQUAL_UINT8(1, stats.nextTxSeq(PEER_A));
+    TEST_ASSERT_EQUAL_UINT8(0, stats.nextTxSeq(PEER_B));
+}
+
+static void test_tx_counts_and_failures() {
+    LinkStats stats;
+    for (uint8_t i = 0; i < 4; i++) {
+        stats.onTxAttempt(PEER_A);
+        stats.onTxComplete(PEER_A, i != 0);
+    }
+
+    LinkSnapshot link;
+    TEST_ASSERT_TRUE(stats.getLink(PEER_A, link));
+    TEST_ASSERT_EQUAL_UINT16(4, link.txCount);
+    TEST_ASSERT_GREATER_THAN_UINT8(0, link.txFailPct);
+}
+
+static void test_rx_gaps_count_as_loss() {
+    LinkStats stats;
+    stats.onRx(PEER_A, 10, true);
+    stats.onRx(PEER_A, 11, true);
+
+    LinkSnapshot link;
+    TEST_ASSERT_TRUE(stats.getLink(PEER_A, link));
+    TEST_ASSERT_EQUAL_UINT8(0, link.lossPct);
+
+    stats.onRx(PEER_A, 14, true);           // 12 e 13 persi
+    TEST_ASSERT_TRUE(stats.getLink(PEER_A, link));
+    TEST_ASSERT_EQUAL_UINT16(3, link.rxCount);
+    TEST_ASSERT_GREATER_THAN_UINT8(0, link.lossPct);
+}
+
+static void test_restart_gap_and_separate_spaces() {
+    LinkStats stats;
+    stats.onRx(PEER_A, 200, true);
+    stats.onRx(PEER_A, 100, true);          // Salto indietro (buco >= 128): riavvio del mittente
+    stats.onRx(PEER_A, 0, false);           // Unicast: spazio di sequenza separato
+    stats.onRx(PEER_A, 1, false);
+
+    LinkSnapshot link;
+    TEST_ASSERT_TRUE(stats.getLink(PEER_A, link));
+    TEST_ASSERT_EQUAL_UINT8(0, link.lossPct);
+}
+
+static void test_rssi_only_for_known_links() {
+    LinkStats stats;
+    stats.onRssi(PEER_A, -60);
+    LinkSnapshot link;
+    TEST_ASSERT_FALSE(stats.getLink(PEER_A, link));
+
+    stats.onRx(PEER_A, 0, true);
+    stats.onRssi(PEER_A, -60);
+    TEST_ASSERT_TRUE(stats.getLink(PEER_A, link));
+    TEST_ASSERT_EQUAL_INT8(-60, link.rssi);
+}
+
+static void test_table_evicts_oldest() {
+    LinkStats stats;
+    uint8_t mac[6] = {0x02, 0, 0, 0, 0, 0};
+    for (uint8_t i = 0; i < LINK_TABLE_SIZE + 1; i++) {
+        mac[5] = i;
+        stats.onRx(mac, 0, true);
+        hostAdvanceMs(10);
+    }
+
+    LinkSnapshot all[LINK_TABLE_SIZE + 1];
+    TEST_ASSERT_EQUAL_UINT8(LINK_TABLE_SIZE, stats.snapshot(all, LINK_TABLE_SIZE + 1));
+
+    LinkSnapshot link;
+    mac[5] = 0;
+    TEST_ASSERT_FALSE(stats.getLink(mac, link));
+    mac[5] = LINK_TABLE_SIZE;
+    TEST_ASSERT_TRUE(stats.getLink(mac, link));
+}
+
+void runLinkStatsTests() {
+    RUN_TEST(test_tx_sequence_per_destination);
+    RUN_TEST(test_tx_counts_and_failures);
+    RUN_TEST(test_rx_gaps_count_as_loss);
+    RUN_TEST(test_restart_gap_and_separate_spaces);
+    RUN_TEST(test_rssi_only_for_known_links);
+    RUN_TEST(test_table_evicts_oldest);
+}
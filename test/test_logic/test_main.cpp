@@ -0,0 +1,27 @@
+#include <unity.h>
+#include "config.h"
+#include "tests.h"
+
+// Definiti in main.cpp nel firmware, qui escluso dalla build
+uint8_t broadcastAddress[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+volatile bool buttonFlag = false;
+volatile uint32_t buttonPressMicros = 0;
+
+void setUp() {
+    hostMicros = 0;
+    Serial.output.clear();
+}
+
+void tearDown() {}
+
+int main() {
+    UNITY_BEGIN();
+    runPatternEngineTests();
+    runPowerManagerTests();
+    runClockSyncTests();
+    runReactionTimerTests();
+    runLinkStatsTests();
+    runTournamentHubTests();
+    runTraceReplayTests();
+    return UNITY_END();
+}
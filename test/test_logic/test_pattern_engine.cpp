@@ -0,0 +1,87 @@
+#include <unity.h>
+#include "PatternEngine.h"
+#include "tests.h"
+
+static void test_validate_accepts_well_formed_program() {
+    const uint8_t code[] = {
+        PAT_FILL, 0, 0, 255, 0, 0,      // 0
+        PAT_ROTATE, 1,                  // 6
+        PAT_WAIT, 5,                    // 8
+        PAT_LOOP, 0, 6, 3,              // 10: torna a ROTATE 3 volte
+        PAT_END                         // 14
+    };
+    TEST_ASSERT_TRUE(PatternEngine::validate(code, sizeof(code)));
+}
+
+static void test_validate_rejects_bad_programs() {
+    const uint8_t unknown[] = { 0x42 };
+    TEST_ASSERT_FALSE(PatternEngine::validate(unknown, sizeof(unknown)));
+
+    const uint8_t truncated[] = { PAT_FILL, 0, 0, 255 };
+    TEST_ASSERT_FALSE(PatternEngine::validate(truncated, sizeof(truncated)));
+
+    const uint8_t forward[] = { PAT_LOOP, 0, 4, 0, PAT_END };
+    TEST_ASSERT_FALSE(PatternEngine::validate(forward, sizeof(forward)));
+
+    // Salto su un argomento di FILL, non su un inizio di istruzione
+    const uint8_t midInstruction[] = { PAT_FILL, 0, 0, 1, 2, 3, PAT_LOOP, 0, 2, 0 };
+    TEST_ASSERT_FALSE(PatternEngine::validate(midInstruction, sizeof(midInstruction)));
+
+    const uint8_t badLoopId[] = { PAT_WAIT, 1, PAT_LOOP, PATTERN_MAX_LOOPS, 0, 0 };
+    TEST_ASSERT_FALSE(PatternEngine::validate(badLoopId, sizeof(badLoopId)));
+
+    TEST_ASSERT_FALSE(PatternEngine::validate(unknown, 0));
+}
+
+static void test_render_fill_and_wait() {
+    PatternEngine engine(4);
+    const uint8_t code[] = { PAT_FILL, 1, 2, 10, 20, 30, PAT_WAIT, 5 };
+    engine.load(code, sizeof(code), 0);
+
+    TEST_ASSERT_EQUAL_UINT16(2, engine.renderFrame(1000));
+    TEST_ASSERT_EQUAL_UINT32(1050, engine.getResumeAt());
+    TEST_ASSERT_FALSE(engine.isDue(1049));
+    TEST_ASSERT_TRUE(engine.isDue(1050));
+
+    const uint8_t expected[] = { 0, 0, 0, 10, 20, 30, 10, 20, 30, 0, 0, 0 };
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, engine.getFrame(), sizeof(expected));
+}
+
+static void test_render_context_color_and_rotate() {
+    PatternEngine engine(3);
+    const uint8_t code[] = { PAT_FILL_CTX, 0, 1, PAT_ROTATE, 1, PAT_WAIT, 1 };
+    engine.load(code, sizeof(code), 0x0A0B0C);
+    engine.renderFrame(0);
+
+    const uint8_t expected[] = { 0, 0, 0, 0x0A, 0x0B, 0x0C, 0, 0, 0 };
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, engine.getFrame(), sizeof(expected));
+}
+
+static void test_render_stops_at_budget() {
+    // Ciclo infinito senza WAIT: il frame esce comunque dopo PATTERN_BUDGET istruzioni
+    PatternEngine engine(2);
+    const uint8_t code[] = { PAT_FADE, 128, PAT_LOOP, 0, 0, 0 };
+    engine.load(code, sizeof(code), 0);
+
+    TEST_ASSERT_EQUAL_UINT16(PATTERN_BUDGET, engine.renderFrame(500));
+    TEST_ASSERT_EQUAL_UINT32(500 + PATTERN_FRAME_MS, engine.getResumeAt());
+}
+
+static void test_render_counted_loop() {
+    // FILL rosso, poi 3 passate di FADE 1/2: 256 -> 32 (255 -> 31 con gli arrotondamenti)
+    PatternEngine engine(1);
+    const uint8_t code[] = { PAT_FILL, 0, 0, 255, 0, 0, PAT_FADE, 128, PAT_LOOP, 0, 6, 3, PAT_WAIT, 1 };
+    engine.load(code, sizeof(code), 0);
+    engine.renderFrame(0);
+
+    TEST_ASSERT_EQUAL_UINT8(31, engine.getFrame()[0]);
+}
+
+void runPatternEngineTests() {
+    RUN_TEST(test_validate_accepts_well_formed_program);
+    RUN_TEST(test_validate_rejects_bad_programs);
+    RUN_TEST(test_render_fill_and_wait);
+    RUN_TEST(test_render_context_color_and_rotate);
+    RUN_TEST(test_render_stops_at_budget);
+    RUN_TEST(test_render_counted_loop);
+}
@@ -0,0 +1,45 @@
+#include <unity.h>
+#include "PowerManager.h"
+#include "tests.h"
+
+static void test_account_sums_per_state() {
+    PowerManager power;
+    power.account(POWER_ACTIVE, 1000);
+    power.account(POWER_SLEEP, 3000);
+    power.account(POWER_ACTIVE, 500);
+
+    TEST_ASSERT_EQUAL_UINT64(1500, power.getTimeUs(POWER_ACTIVE));
+    TEST_ASSERT_EQUAL_UINT64(0, power.getTimeUs(POWER_IDLE));
+    TEST_ASSERT_EQUAL_UINT64(3000, power.getTimeUs(POWER_SLEEP));
+}
+
+static void test_average_current_is_time_weighted() {
+    PowerManager power;
+    TEST_ASSERT_EQUAL_UINT32(0, power.averageCurrentUa());
+
+    power.account(POWER_IDLE, 1000);
+    TEST_ASSERT_EQUAL_UINT32(POWER_ACTIVE_UA, power.averageCurrentUa());
+
+    // 1/4 sveglio, 3/4 in light sleep
+    power.account(POWER_SLEEP, 3000);
+    TEST_ASSERT_EQUAL_UINT32((POWER_ACTIVE_UA + 3 * POWER_SLEEP_UA) / 4, power.averageCurrentUa());
+
+    power.resetStats();
+    TEST_ASSERT_EQUAL_UINT32(0, power.averageCurrentUa());
+}
+
+static void test_windows_follow_master_clock() {
+    TEST_ASSERT_TRUE(PowerManager::inListenWindow(0));
+    TEST_ASSERT_TRUE(PowerManager::inSendWindow(POWER_LISTEN_US / 2 - 1));
+    TEST_ASSERT_FALSE(PowerManager::inSendWindow(POWER_LISTEN_US / 2));
+    TEST_ASSERT_FALSE(PowerManager::inListenWindow(POWER_LISTEN_US));
+    TEST_ASSERT_EQUAL_UINT32(POWER_CYCLE_US - POWER_LISTEN_US, PowerManager::untilListenWindow(POWER_LISTEN_US));
+    // Il periodo divide 2^32: nessun salto al wrap di micros()
+    TEST_ASSERT_EQUAL_UINT32(1, PowerManager::untilListenWindow(UINT32_MAX));
+}
+
+void runPowerManagerTests() {
+    RUN_TEST(test_account_sums_per_state);
+    RUN_TEST(test_average_current_is_time_weighted);
+    RUN_TEST(test_windows_follow_master_clock);
+}
@@ -0,0 +1,61 @@
+#include <unity.h>
+#include "ReactionTimer.h"
+#include "tests.h"
+
+static void test_capture_subtracts_latch_and_isr_latency() {
+    ReactionTimer timer;
+    timer.setCalibration(20);
+    timer.arm(100000);
+
+    uint32_t reaction = 0;
+    TEST_ASSERT_TRUE(timer.capture(100000 + LED_LATCH_US + 20 + 180000, reaction));
+    TEST_ASSERT_EQUAL_UINT32(180000, reaction);
+    TEST_ASSERT_FALSE(timer.isArmed());
+}
+
+static void test_capture_rejects_out_of_window() {
+    ReactionTimer timer;
+    uint32_t reaction = 0;
+    TEST_ASSERT_FALSE(timer.capture(1000, reaction));      // Non armato
+
+    timer.arm(100000);
+    TEST_ASSERT_FALSE(timer.capture(100000, reaction));    // Prima che i LED si accendano
+
+    timer.arm(100000);
+    TEST_ASSERT_FALSE(timer.capture(100000 + LED_LATCH_US + REACTION_TIMEOUT_MS * 1000 + 1, reaction));
+}
+
+static void test_capture_across_micros_wrap() {
+    ReactionTimer timer;
+    timer.arm(UINT32_MAX - 1000);
+
+    uint32_t reaction = 0;
+    TEST_ASSERT_TRUE(timer.capture(UINT32_MAX - 1000 + LED_LATCH_US + 250000, reaction));
+    TEST_ASSERT_EQUAL_UINT32(250000, reaction);
+}
+
+static void test_round_collects_one_result_per_slave() {
+    ReactionTimer timer;
+    timer.addResult(0, 1000);                               // Round chiuso: ignorato
+    TEST_ASSERT_EQUAL_UINT8(0, timer.getResultCount());
+
+    timer.beginRound();
+    timer.addResult(0, 200000);
+    timer.addResult(0, 150000);                             // Duplicato
+    timer.addResult(2, 180000);
+    timer.addResult(MAX_SLAVES, 100000);                    // ID fuori range
+    TEST_ASSERT_EQUAL_UINT8(2, timer.getResultCount());
+
+    timer.closeRound();
+    TEST_ASSERT_FALSE(timer.isRoundOpen());
+
+    timer.beginRound();
+    TEST_ASSERT_EQUAL_UINT8(0, timer.getResultCount());
+}
+
+void runReactionTimerTests() {
+    RUN_TEST(test_capture_subtracts_latch_and_isr_latency);
+    RUN_TEST(test_capture_rejects_out_of_window);
+    RUN_TEST(test_capture_across_micros_wrap);
+    RUN_TEST(test_round_collects_one_result_per_slave);
+}
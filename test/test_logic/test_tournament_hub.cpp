@@ -0,0 +1,144 @@
+#include <unity.h>
+#include <string>
+#include "TournamentHub.h"
+#include "tests.h"
+
+static ESPNowManager espNow;
+
+static const uint8_t MASTER_A[6] = {0x02, 0, 0, 0, 0, 0x0A};
+static const uint8_t MASTER_B[6] = {0x02, 0, 0, 0, 0, 0x0B};
+
+static Message masterFrame(uint8_t type, uint16_t epoch, uint16_t round) {
+    Message msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type = type;
+    msg.epoch = epoch;
+    msg.round = round;
+    msg.origin = NODE_MASTER;
+    msg.dest = NODE_ALL;
+    return msg;
+}
+
+static void heartbeat(TournamentHub& hub, const uint8_t* mac, uint8_t arenaId, uint16_t epoch, uint8_t roster) {
+    Message msg = masterFrame(MSG_MASTER_HEARTBEAT, epoch, 0);
+    msg.data = STATE_READY;
+    msg.timestamp = (uint32_t)arenaId << 8;
+    msg.roster = roster;
+    hub.handleMessage(msg, mac);
+}
+
+// Round completo: START, vincitore dopo durationUs
+static void playRound(TournamentHub& hub, const uint8_t* mac, uint16_t epoch, uint16_t round,
+                      uint8_t winner, uint32_t durationUs) {
+    hub.handleMessage(masterFrame(MSG_START_GAME, epoch, round), mac);
+    hostAdvanceUs(durationUs);
+    Message msg = masterFrame(MSG_WINNER_ANNOUNCE, epoch, round);
+    msg.slaveId = winner;
+    hub.handleMessage(msg, mac);
+}
+
+static bool printed(const char* line) {
+    return Serial.output.find(line) != std::string::npos;
+}
+
+static void test_round_event_with_duration() {
+    TournamentHub hub(espNow);
+    heartbeat(hub, MASTER_A, 3, 1, 0x0F);
+    playRound(hub, MASTER_A, 1, 7, 2, 250000);
+    hub.update();
+
+    TEST_ASSERT_TRUE(printed("hub,round,3,02:00:00:00:00:0A,7,2,250000\n"));
+}
+
+static void test_duplicate_start_and_late_winner_ignored() {
+    TournamentHub hub(espNow);
+    heartbeat(hub, MASTER_A, 1, 1, 0x0F);
+    hub.handleMessage(masterFrame(MSG_START_GAME, 1, 1), MASTER_A);
+    hostAdvanceUs(1000);
+    hub.handleMessage(masterFrame(MSG_START_GAME, 1, 1), MASTER_A);    // Copia: non riapre il round
+    hostAdvanceUs(1000);
+    Message winner = masterFrame(MSG_WINNER_ANNOUNCE, 1, 1);
+    winner.slaveId = 0;
+    hub.handleMessage(winner, MASTER_A);
+    hub.handleMessage(winner, MASTER_A);                                // Round già chiuso
+    hub.update();
+
+    TEST_ASSERT_TRUE(printed("hub,round,1,02:00:00:00:00:0A,1,0,2000\n"));
+    TEST_ASSERT_EQUAL(Serial.output.find("hub,round"), Serial.output.rfind("hub,round"));
+}
+
+static void test_scheduled_start_counts_from_lead() {
+    TournamentHub hub(espNow);
+    Message start = masterFrame(MSG_START_GAME, 1, 1);
+    start.data = START_FLAG_SCHEDULED;
+    hub.handleMessage(start, MASTER_A);
+    hostAdvanceUs(START_LEAD_US + 300000);
+    Message winner = masterFrame(MSG_WINNER_ANNOUNCE, 1, 1);
+    winner.slaveId = 1;
+    hub.handleMessage(winner, MASTER_A);
+    hub.update();
+
+    TEST_ASSERT_TRUE(printed(",1,1,300000\n"));
+}
+
+static void test_epoch_change_is_restart_and_slaves_ignored() {
+    TournamentHub hub(espNow);
+    heartbeat(hub, MASTER_A, 5, 1, 0x0F);
+    hub.handleMessage(masterFrame(MSG_START_GAME, 1, 1), MASTER_A);
+    heartbeat(hub, MASTER_A, 5, 2, 0x0F);                              // Master riavviato
+
+    Message fromSlave = masterFrame(MSG_FALSE_START, 2, 1);
+    fromSlave.origin = 0;
+    hub.handleMessage(fromSlave, MASTER_A);
+    hub.update();
+
+    TEST_ASSERT_TRUE(printed("hub,restart,5,02:00:00:00:00:0A,2\n"));
+    TEST_ASSERT_FALSE(printed("hub,false_start"));
+}
+
+static void test_report_arena_and_leaderboard() {
+    TournamentHub hub(espNow);
+    heartbeat(hub, MASTER_A, 1, 1, 0x0F);
+    heartbeat(hub, MASTER_B, 2, 1, 0x03);
+    playRound(hub, MASTER_A, 1, 1, 0, 100000);
+    playRound(hub, MASTER_A, 1, 2, 0, 300000);
+    playRound(hub, MASTER_B, 1, 1, 1, 200000);
+    heartbeat(hub, MASTER_A, 1, 1, 0x07);                              // Slave 3 uscito
+    hub.update();
+    Serial.output.clear();
+
+    TEST_ASSERT_TRUE(hub.handleCommand("hub"));
+    TEST_ASSERT_TRUE(printed("hub,arena,1,02:00:00:00:00:0A,1,"));
+    TEST_ASSERT_TRUE(printed(",07,2,0,0,1,100000,200000,300000,"));
+    TEST_ASSERT_TRUE(printed("hub,leader,1,1,0,2\n"));
+    TEST_ASSERT_TRUE(printed("hub,leader,2,2,1,1\n"));
+    TEST_ASSERT_FALSE(printed("hub,leader,3"));
+    TEST_ASSERT_TRUE(printed("hub,stats,2,"));
+}
+
+static void test_full_table_evicts_least_recent() {
+    TournamentHub hub(espNow);
+    uint8_t mac[6] = {0x02, 0, 0, 0, 1, 0};
+    for (uint8_t i = 0; i < HUB_MAX_ARENAS + 1; i++) {
+        mac[5] = i;
+        heartbeat(hub, mac, i + 1, 1, 0x01);
+        hostAdvanceMs(10);
+    }
+    hub.handleCommand("hub");
+
+    TEST_ASSERT_FALSE(printed("hub,arena,1,"));                         // Il primo, il meno recente
+    TEST_ASSERT_TRUE(printed("hub,arena,17,"));
+    char stats[48];
+    snprintf(stats, sizeof(stats), "hub,stats,%d,%d,", HUB_MAX_ARENAS, HUB_MAX_ARENAS + 1);
+    TEST_ASSERT_TRUE(printed(stats));
+    TEST_ASSERT_TRUE(printed(",0,1\n"));                                // Nessun evento perso, 1 sostituito
+}
+
+void runTournamentHubTests() {
+    RUN_TEST(test_round_event_with_duration);
+    RUN_TEST(test_duplicate_start_and_late_winner_ignored);
+    RUN_TEST(test_scheduled_start_counts_from_lead);
+    RUN_TEST(test_epoch_change_is_restart_and_slaves_ignored);
+    RUN_TEST(test_report_arena_and_leaderboard);
+    RUN_TEST(test_full_table_evicts_least_recent);
+}
@@ -0,0 +1,144 @@
+#include <unity.h>
+#include <vector>
+#include "GameManager.h"
+#include "TraceRecorder.h"
+#include "TraceReplay.h"
+#include "tests.h"
+
+static const uint8_t SLAVE_MACS[MAX_SLAVES][6] = {
+    {0x02, 0x7E, 0x57, 0x00, 0x00, 0x00},
+    {0x02, 0x7E, 0x57, 0x00, 0x00, 0x01},
+    {0x02, 0x7E, 0x57, 0x00, 0x00, 0x02},
+    {0x02, 0x7E, 0x57, 0x00, 0x00, 0x03},
+};
+
+static LEDController leds(LED_PIN, NUM_LEDS);
+static ESPNowManager espNow;
+static GameManager* recorded = nullptr;
+
+static void deliverToRecorded(const Message& msg, const uint8_t* macAddr) {
+    recorded->handleMessage(msg, macAddr);
+}
+
+// Frame di uno slave come arriva al master (sequenze come le mette ESPNowManager)
+static void injectFromSlave(uint8_t type, uint8_t id, uint32_t value, uint16_t round) {
+    static uint16_t originSeq[MAX_SLAVES] = {0, 0, 0, 0};
+    Message msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type = type;
+    msg.slaveId = id;
+    msg.value = value;
+    msg.round = round;
+    msg.timestamp = millis();
+    msg.origin = id;
+    msg.dest = NODE_MASTER;
+    msg.ttl = RELAY_MAX_HOPS;
+    msg.originNonce = 0x51A0E000 | id;
+    msg.seq = (uint8_t)originSeq[id];
+    msg.originSeq = originSeq[id]++;
+    uint8_t raw[sizeof(Message)];
+    memcpy(raw, &msg, sizeof(msg));
+    ESPNowManager::injectFrame(SLAVE_MACS[id], raw, sizeof(raw));
+}
+
+static void runLoop(GameManager& game, uint32_t ms) {
+    for (uint32_t i = 0; i < ms; i++) {
+        game.update();
+        espNow.update();
+        delay(1);
+    }
+}
+
+// Incidente tipo: lo slave 1 preme 2ms prima dello slave 0. Registrato sul master e copiato
+// fuori dal buffer (il replay usa un GameManager nuovo, con NVS separata).
+static std::vector<uint8_t> recordRound() {
+    static NvsStore store("trace_rec");
+    delete recorded;
+    recorded = new GameManager(leds, espNow, store, ROLE_MASTER, 0);
+    recorded->begin();
+    espNow.setNodeId(NODE_MASTER);
+    espNow.setMessageCallback(deliverToRecorded);
+
+    GameCheckpoint start;
+    recorded->captureCheckpoint(start);
+    TEST_ASSERT_TRUE(TraceRecorder::start(start));
+
+    for (uint8_t id = 0; id < MAX_SLAVES; id++) {
+        injectFromSlave(MSG_CONNECT_REQUEST, id, 0, 0);
+        runLoop(*recorded, 20);
+    }
+    TEST_ASSERT_EQUAL(STATE_READY, recorded->getState());
+
+    // Start del master: con POWER_SAVE può slittare alla finestra successiva (< 300ms)
+    TraceRecorder::recordButton(micros());
+    recorded->handleButtonPress();
+    runLoop(*recorded, 300);
+    TEST_ASSERT_EQUAL(STATE_GAME_RUNNING, recorded->getState());
+
+    injectFromSlave(MSG_BUTTON_PRESSED, 1, 0x1001, 1);
+    hostAdvanceMs(2);
+    injectFromSlave(MSG_BUTTON_PRESSED, 0, 0x1000, 1);
+    runLoop(*recorded, 50);
+    TEST_ASSERT_EQUAL(STATE_WINNER_ANNOUNCED, recorded->getState());
+
+    TraceRecorder::stop();
+    espNow.setMessageCallback(nullptr);
+    const uint8_t* data = TraceRecorder::getData();
+    return std::vector<uint8_t>(data, data + TraceRecorder::getSize());
+}
+
+static void test_replay_reproduces_round_and_winner() {
+    std::vector<uint8_t> trace = recordRound();
+
+    static NvsStore store("trace_replay");
+    GameManager replay(leds, espNow, store, ROLE_MASTER, 0);
+    replay.begin();
+
+    static TraceReplayResult result;
+    TEST_ASSERT_TRUE(TraceReplay::run(replay, espNow, trace.data(), trace.size(), result));
+
+    TEST_ASSERT_FALSE(result.truncated);
+    TEST_ASSERT_EQUAL_UINT32(MAX_SLAVES + 3, result.inputs);
+    TEST_ASSERT_TRUE(result.expectedCount >= 3);
+    TEST_ASSERT_TRUE(result.transitionsMatch());
+    TEST_ASSERT_EQUAL(STATE_WINNER_ANNOUNCED, replay.getState());
+
+    GameCheckpoint end;
+    replay.captureCheckpoint(end);
+    TEST_ASSERT_EQUAL_UINT8(1, end.winner);
+    TEST_ASSERT_EQUAL_UINT16(1, end.round);
+    TEST_ASSERT_EQUAL_UINT8(MAX_SLAVES, end.rosterCount);
+}
+
+static void test_truncated_trace_reported() {
+    std::vector<uint8_t> trace = recordRound();
+    trace.resize(trace.size() - 3);
+
+    static NvsStore store("trace_cut");
+    GameManager replay(leds, espNow, store, ROLE_MASTER, 0);
+    replay.begin();
+
+    static TraceReplayResult result;
+    TEST_ASSERT_TRUE(TraceReplay::run(replay, espNow, trace.data(), trace.size(), result));
+    TEST_ASSERT_TRUE(result.truncated);
+    TEST_ASSERT_TRUE(result.truncatedAt < trace.size());
+}
+
+static void test_bad_magic_rejected() {
+    std::vector<uint8_t> trace(sizeof(TraceHeader) + 8, 0);
+
+    static NvsStore store("trace_bad");
+    GameManager replay(leds, espNow, store, ROLE_MASTER, 0);
+    replay.begin();
+
+    static TraceReplayResult result;
+    TEST_ASSERT_FALSE(TraceReplay::run(replay, espNow, trace.data(), trace.size(), result));
+}
+
+void runTraceReplayTests() {
+    leds.begin();
+    espNow.begin();
+    RUN_TEST(test_replay_reproduces_round_and_winner);
+    RUN_TEST(test_truncated_trace_reported);
+    RUN_TEST(test_bad_magic_rejected);
+}
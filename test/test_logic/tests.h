@@ -0,0 +1,15 @@
+#ifndef TESTS_H
+#define TESTS_H
+
+#include <Arduino.h>
+
+// Un gruppo per modulo, tutti nella stessa suite (un solo main)
+void runPatternEngineTests();
+void runPowerManagerTests();
+void runClockSyncTests();
+void runReactionTimerTests();
+void runLinkStatsTests();
+void runTournamentHubTests();
+void runTraceReplayTests();
+
+#endif // TESTS_H